@@ -21,6 +21,15 @@ typedef enum {
     EFFECT_TYPE_NOISE_REDUCTION = 1,
 } EffectType;
 
+/**
+ * How the HAL and effectd wake each other once a period is queued
+ */
+typedef enum {
+    EFFECT_WAKEUP_MODE_EVENTFD = 0,     // eventfd per direction (default)
+    EFFECT_WAKEUP_MODE_FUTEX = 1,       // Futex doorbell in shared memory
+    EFFECT_WAKEUP_MODE_SPIN_FUTEX = 2,  // Brief spin, then futex doorbell
+} EffectWakeupMode;
+
 /**
  * Audio configuration
  */
@@ -29,6 +38,12 @@ typedef struct {
     uint32_t channels;        // Number of channels (1, 2, etc.)
     uint32_t format;          // Audio format (16=PCM_16, 32=PCM_32, etc.)
     uint32_t framesPerBuffer; // Frames per processing callback
+    EffectWakeupMode wakeupMode; // Wakeup strategy (futex modes need shared memory)
+    uint32_t maxSpinUs;       // Cap on adaptive spinning per Process() call (0 = default)
+    uint32_t pipelineDepth;   // Periods of pipelining (0 = synchronous, see EffectClient_Process)
+    bool hugePages;           // Back rings with huge pages where available (shared memory only)
+    uint32_t timeoutPercent;  // Share of a period Process() waits for effectd, in percent (0 = 50)
+    uint32_t breakerMisses;   // Timeouts in a row before Process() bypasses effectd (0 = 3)
 } EffectConfig;
 
 /**
@@ -55,6 +70,11 @@ typedef struct {
     uint32_t maxLatencyUs;
     uint32_t timeoutCount;
     uint32_t xrunCount;
+    uint32_t p50LatencyUs;
+    uint32_t p99LatencyUs;
+    uint32_t p999LatencyUs;   // 99.9th percentile
+    uint32_t breakerTripCount;     // Times Process() switched to bypassing effectd
+    uint32_t breakerRecoveryCount; // Times it went back to effectd after probing
 } EffectStats;
 
 /**
@@ -87,34 +107,135 @@ EffectResult EffectClient_Start(EffectHandle handle);
  * It performs only lock-free ring buffer operations and eventfd signaling.
  * No HIDL calls, no dynamic memory allocation, no heavy locks.
  * 
- * If processing times out (>20ms), the function returns EFFECT_ERROR_TIMEOUT
- * and the HAL should fall back to passthrough mode.
+ * While waiting for effectd it first spins on the output ring for about
+ * the session's typical service time (learned from previous periods and
+ * capped by EffectConfig.maxSpinUs), then falls back to a kernel wait.
+ * 
+ * If the output is not ready within EffectConfig.timeoutPercent of a period,
+ * the function returns EFFECT_ERROR_TIMEOUT with the input passed through
+ * (for multi-period calls, only the periods effectd had not finished yet).
+ * Output that arrives after its call gave up is discarded, never returned
+ * for a later period.
+ * 
+ * After EffectConfig.breakerMisses timeouts in a row the session stops
+ * sending audio to effectd: calls return EFFECT_ERROR_TIMEOUT at once with
+ * the input passed through. About every 100ms one call probes effectd,
+ * waiting for its own period as a synchronous call would; once a run of
+ * probes meets the deadline, processing resumes (pipelined sessions
+ * refill their pipeline as after Start).
+ * 
+ * With EffectConfig.pipelineDepth = k > 0 each call submits period N and
+ * returns the processed output of period N-k, so the caller does not wait
+ * for effectd in steady state. The first k calls after Start return
+ * silence. Use EffectClient_GetLatency to compensate for the added delay.
+ * 
+ * If effectd dies, the session is reattached to its replacement in the
+ * background with its last parameters and bypass state; until then the
+ * input is passed through and EFFECT_ERROR_DEAD_OBJECT is returned. The
+ * pipeline restarts from empty afterwards.
  * 
  * @param handle Effect handle
  * @param input Input PCM buffer
  * @param output Output PCM buffer (can be same as input for in-place)
- * @param frames Number of frames to process
+ * @param frames Number of frames to process, a whole number of periods
+ *               (otherwise the input is passed through and
+ *               EFFECT_ERROR_INVALID_ARGUMENTS returned)
  * @return EFFECT_OK on success, EFFECT_ERROR_TIMEOUT on timeout, error code otherwise
  */
 EffectResult EffectClient_Process(EffectHandle handle, const void* input, void* output, uint32_t frames);
 
+/**
+ * Query the latency added by the session
+ * 
+ * Can be called from any thread.
+ * 
+ * @param handle Effect handle
+ * @param latencyFrames Output parameter for the added latency in frames
+ *                      (pipelineDepth * framesPerBuffer)
+ * @return EFFECT_OK on success, error code otherwise
+ */
+EffectResult EffectClient_GetLatency(EffectHandle handle, uint32_t* latencyFrames);
+
 /**
  * Set algorithm parameter
  * 
- * Must be called from a non-real-time thread.
+ * Must be called from a non-real-time thread. While the session is
+ * started, values of up to 40 bytes are queued in shared memory and take
+ * effect from the first period submitted after the call; the plugin's
+ * verdict on them is not reported. Larger values, and any value while
+ * stopped, are applied synchronously.
  * 
  * @param handle Effect handle
  * @param key Parameter key
  * @param value Parameter value buffer
- * @param valueSize Size of value buffer
+ * @param valueSize Size of value buffer (at most 1 KB)
  * @return EFFECT_OK on success, error code otherwise
  */
 EffectResult EffectClient_SetParam(EffectHandle handle, uint32_t key, const void* value, uint32_t valueSize);
 
+/**
+ * Set a large parameter (a model, a table) without copying it
+ * 
+ * fd must be a memfd sealed against writing, shrinking and growing, e.g.
+ * from effect_shared_memory_create_sealed(). effectd maps it read-only
+ * rather than receiving the bytes, and sessions given the same content
+ * share one mapping, so loading a model another session already uses is
+ * cheap. The caller keeps fd. Must be called from a non-real-time thread.
+ * 
+ * @param handle Effect handle
+ * @param key Parameter key
+ * @param fd Sealed memfd holding the value
+ * @return EFFECT_OK on success, error code otherwise
+ */
+EffectResult EffectClient_SetParamBlob(EffectHandle handle, uint32_t key, int fd);
+
+/**
+ * Set a large parameter from a file
+ * 
+ * Like EffectClient_SetParamBlob(). The file is opened with the caller's
+ * permissions and effectd takes a copy of its current content, shared by
+ * every session loading the same version of the file; later changes to the
+ * file do not affect sessions that already loaded it.
+ * 
+ * @param handle Effect handle
+ * @param key Parameter key
+ * @param path Absolute path of a regular file
+ * @return EFFECT_OK on success, error code otherwise
+ */
+EffectResult EffectClient_SetParamFile(EffectHandle handle, uint32_t key, const char* path);
+
+/**
+ * Reset the algorithm's internal state
+ * 
+ * Queued like a small EffectClient_SetParam(): it takes effect from the
+ * first period submitted after the call, or on the next start or stop
+ * if the session is not processing. Must be called from a non-real-time
+ * thread.
+ * 
+ * @param handle Effect handle
+ * @return EFFECT_OK on success, EFFECT_ERROR_TIMEOUT if the command queue
+ *         is full, error code otherwise
+ */
+EffectResult EffectClient_Reset(EffectHandle handle);
+
+/**
+ * Pass input through unprocessed, or resume processing
+ * 
+ * Takes effect like EffectClient_Reset(). Must be called from a
+ * non-real-time thread.
+ * 
+ * @param handle Effect handle
+ * @param bypass true to bypass the algorithm, false to resume it
+ * @return EFFECT_OK on success, EFFECT_ERROR_TIMEOUT if the command queue
+ *         is full, error code otherwise
+ */
+EffectResult EffectClient_SetBypass(EffectHandle handle, bool bypass);
+
 /**
  * Query statistics
  * 
- * Can be called from any thread.
+ * Can be called from any thread. Latency percentiles come from a
+ * log-bucketed histogram and are accurate to within 6.25%.
  * 
  * @param handle Effect handle
  * @param stats Output parameter for statistics
@@ -122,6 +243,19 @@ EffectResult EffectClient_SetParam(EffectHandle handle, uint32_t key, const void
  */
 EffectResult EffectClient_QueryStats(EffectHandle handle, EffectStats* stats);
 
+/**
+ * Query statistics for the interval since the previous call
+ * 
+ * Counters and latency figures only cover periods processed since the
+ * previous EffectClient_QueryIntervalStats() (or since open for the first
+ * call). Can be called from any thread.
+ * 
+ * @param handle Effect handle
+ * @param stats Output parameter for statistics
+ * @return EFFECT_OK on success, error code otherwise
+ */
+EffectResult EffectClient_QueryIntervalStats(EffectHandle handle, EffectStats* stats);
+
 /**
  * Stop processing
  * 
@@ -2,14 +2,35 @@
 #include "effect_fmq.h"
 #include "effect_shared_memory.h"
 #include "effect_ringbuffer.h"
+#include "effect_wakeup.h"
+#include "effect_seqlock.h"
+#include "effect_histogram.h"
+#include "effect_arena.h"
+#include "effect_shm_pool.h"
+#include "effect_control.h"
+#include "effect_command.h"
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <pthread.h>
 #include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
 
-#define MAX_BUFFER_SIZE (1024 * 1024)  // 1MB for ring buffers
-#define TIMEOUT_MS 20
+#define MAX_BUFFER_SIZE (1024 * 1024)  // Upper bound on one ring's capacity
+#define RING_SLACK_PERIODS 3          // Room beyond the pipeline for late output
+#define SHM_POOL_SIZE (4 * 1024 * 1024)  // Process-wide slab pool
+#define DEFAULT_TIMEOUT_PERCENT 50   // Share of a period Process() waits for effectd
+#define DEFAULT_MAX_SPIN_US 200
+#define DEFAULT_BREAKER_MISSES 3      // Timeouts in a row that trip the breaker
+#define BREAKER_PROBE_INTERVAL_US 100000  // Between probes while bypassing effectd
+#define BREAKER_CLOSE_PROBES 8        // Probes in a row on time that close it
+#define SERVICE_TIME_EWMA_SHIFT 3     // Service time EWMA weight 1/8
+#define REATTACH_MIN_DELAY_US 1000    // First retry after effectd died
+#define REATTACH_MAX_DELAY_US 100000  // Retry backoff cap, and idle poll without effectd
+#define DETACH_POLL_US 100
+#define MONITOR_RESCAN_MS 100         // Longest a new connection goes unwatched
+#define NUM_EFFECT_TYPES (EFFECT_TYPE_NOISE_REDUCTION + 1)
 
 // Use FMQ by default on Android, fallback to shared memory on other platforms
 #ifndef USE_SHARED_MEMORY
@@ -18,33 +39,109 @@
 #define USE_FMQ 0
 #endif
 
-typedef struct {
+#if !USE_FMQ
+/**
+ * Last value set for a key, replayed into effectd after it restarted
+ */
+typedef struct ParamRecord {
+    struct ParamRecord* next;
+    uint32_t key;
+    int blobFd;               // Sealed memfd (SetParamBlob) or file (SetParamFile), or -1
+    bool blobIsFile;
+    uint32_t valueSize;       // Otherwise an inline value
+    uint8_t value[];
+} ParamRecord;
+#endif
+
+typedef struct EffectSession {
     uint32_t sessionId;
     EffectType effectType;
     EffectConfig config;
+    uint32_t periodBytes;     // bytesPerFrame * framesPerBuffer
+    uint32_t ringCapacity;    // Bytes per ring, sized from config
+    
+    // Prefaulted, mlocked arena this session lives in
+    effect_arena_t arena;
     
 #if USE_FMQ
     // FMQ-based communication
     EffectFmqHandle inputFmq;
     EffectFmqHandle outputFmq;
 #else
-    // Shared memory (legacy)
+    // Shared memory (legacy): a slab of the process-wide pool, or a
+    // private memfd when the pool is exhausted. shmFd, shmAddr and shmSize
+    // describe the pool itself for pooled sessions and are not owned.
     int shmFd;
     void* shmAddr;
     size_t shmSize;
+    EffectSharedMemoryLayout shmLayout;   // Offsets relative to shmAddr
+    EffectShmPool* shmPool;               // NULL for a private memfd
+    uint64_t slabOffset;
+    size_t slabSize;
+    
+    // Connection to effectd, NULL when running without one
+    EffectControlChannel* control;
     
-    // Ring buffers
+    // Ring buffers (headers live in the shared mapping)
     effect_ringbuffer_t inputRb;
     effect_ringbuffer_t outputRb;
+    
+    // In-band commands to effectd; control threads share the producer side
+    effect_ringbuffer_t commandRb;
+    pthread_mutex_t commandLock;
+    
+    // Reattach after effectd dies (see monitor_thread_func). controlLock
+    // serializes control calls with the reattach; while detached, Process()
+    // passes audio through without touching the rings.
+    struct EffectSession* nextAttached;   // g_sessions list
+    pthread_mutex_t controlLock;
+    ParamRecord* params;                  // In the order they were last set
+    bool bypassed;
+    atomic_bool detached;
+    atomic_bool inProcess;
 #endif
     
-    // Event FDs (still used for timeout control)
+    // Event FDs (EFFECT_WAKEUP_MODE_EVENTFD only, -1 otherwise)
     int eventFdIn;   // HAL -> effectd
     int eventFdOut;  // effectd -> HAL
     
-    // Statistics
+    // Wakeup endpoints: we signal the input ring and wait on the output ring
+    effect_wakeup_t inputWakeup;
+    effect_wakeup_t outputWakeup;
+    
+    // Periods are numbered in submission order. effectd turns every input
+    // period into exactly one output period, in order, so output period n
+    // is the processed input period n. Output numbered below what a call
+    // wants belongs to a call that gave up on it, or predates Start.
+    uint64_t submitSeq;       // Number the next input period gets
+    uint64_t readSeq;         // Number of the oldest output period not consumed
+    uint64_t startSeq;        // First period submitted since Start
+    int64_t timeoutUs;        // Longest Process() waits for its output
+    
+    // Circuit breaker: after breakerMisses timeouts in a row, Process()
+    // passes audio through without submitting it, so a struggling library
+    // costs one timeout rather than one per period. Every probe interval
+    // one call is sent to effectd again, synchronously; once enough probes
+    // in a row meet the deadline, the breaker closes.
+    bool breakerOpen;
+    uint32_t breakerMisses;
+    uint32_t missStreak;      // Timeouts in a row while closed
+    uint32_t probeStreak;     // Probes in a row on time while open
+    int64_t nextProbeUs;      // When the next probe is due while open
+    
+    // Adaptive wait: spin for about the usual service time, then block
+    uint32_t serviceTimeUs;   // EWMA of signal-to-output time
+    uint32_t maxSpinUs;       // 0 disables spinning
+    
+    // Statistics; latency fields are derived from latencyHist when read
     EffectStats stats;
-    pthread_mutex_t statsMutex;
+    effect_histogram_t latencyHist;
+    effect_seqlock_t statsLock;    // Process() is the only writer
+    
+    // Snapshot taken by the previous EffectClient_QueryIntervalStats()
+    pthread_mutex_t intervalMutex; // Readers only, never taken by Process()
+    EffectStats intervalStats;
+    effect_histogram_t intervalHist;
     
     // State
     bool isStarted;
@@ -63,38 +160,808 @@ static int64_t get_time_us() {
     return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000LL;
 }
 
+static uint32_t output_available(EffectSession* session) {
+#if USE_FMQ
+    return (uint32_t)effect_fmq_available_to_read(session->outputFmq);
+#else
+    return effect_ringbuffer_get_read_available(&session->outputRb);
+#endif
+}
+
+static bool output_ready(EffectSession* session, uint32_t bytes) {
+    return output_available(session) >= bytes;
+}
+
+static bool write_input(EffectSession* session, const void* input, uint32_t bytes) {
+#if USE_FMQ
+    return effect_fmq_write(session->inputFmq, input, bytes) == bytes;
+#else
+    return effect_ringbuffer_write(&session->inputRb, input, bytes) == bytes;
+#endif
+}
+
+static bool read_output(EffectSession* session, void* output, uint32_t periods) {
+    uint32_t bytes = periods * session->periodBytes;
+#if USE_FMQ
+    if (effect_fmq_read(session->outputFmq, output, bytes) != bytes) {
+        return false;
+    }
+#else
+    if (effect_ringbuffer_read(&session->outputRb, output, bytes) != bytes) {
+        return false;
+    }
+#endif
+    session->readSeq += periods;
+    return true;
+}
+
+/**
+ * Discard the output periods numbered below seq that have arrived, so
+ * every call reads its own periods however late effectd delivered earlier
+ * ones
+ */
+static void drop_late_output(EffectSession* session, uint64_t seq) {
+    while (session->readSeq < seq) {
+#if USE_FMQ
+        EffectFmqRegion region;
+        if (effect_fmq_acquire_read(session->outputFmq, session->periodBytes, &region) < 0) {
+            return;
+        }
+        effect_fmq_release_read(session->outputFmq, session->periodBytes);
+#else
+        effect_ringbuffer_region_t region;
+        if (effect_ringbuffer_acquire_read(&session->outputRb, session->periodBytes, &region) == 0) {
+            return;
+        }
+        effect_ringbuffer_release_read(&session->outputRb, session->periodBytes);
+#endif
+        session->readSeq++;
+    }
+}
+
+/**
+ * Wait until effectd has produced bytes of output or timeoutUs elapses
+ * 
+ * Spins on the output ring for a little longer than the learned service
+ * time, so the common case never sleeps; sessions whose service time
+ * exceeds the spin cap skip spinning and block right away.
+ * 
+ * Output that is already queued (the steady state of pipelined sessions)
+ * says nothing about the service time and is not learned from.
+ * 
+ * @return 0 when the output is ready, -1 on timeout
+ */
+static int wait_for_output(EffectSession* session, uint32_t bytes, int64_t submitTime,
+                           int64_t timeoutUs) {
+    if (output_ready(session, bytes)) {
+        return 0;
+    }
+    
+    int64_t deadline = submitTime + timeoutUs;
+    int64_t now = submitTime;
+    
+    uint32_t spinUs = session->serviceTimeUs + (session->serviceTimeUs >> 2);
+    if (spinUs <= session->maxSpinUs) {
+        int64_t spinEnd = submitTime + spinUs;
+        while (!output_ready(session, bytes)) {
+            effect_cpu_relax();
+            now = get_time_us();
+            if (now >= spinEnd) {
+                break;
+            }
+        }
+    }
+    
+    while (!output_ready(session, bytes)) {
+        now = get_time_us();
+        if (now >= deadline) {
+            return -1;
+        }
+        effect_wakeup_wait(&session->outputWakeup, deadline - now);
+    }
+    
+    // Learn the service time (EWMA); the first sample seeds it
+    uint32_t sample = (uint32_t)(get_time_us() - submitTime);
+    if (session->serviceTimeUs == 0) {
+        session->serviceTimeUs = sample;
+    } else {
+        int32_t delta = (int32_t)sample - (int32_t)session->serviceTimeUs;
+        session->serviceTimeUs = (uint32_t)((int32_t)session->serviceTimeUs +
+                                            delta / (1 << SERVICE_TIME_EWMA_SHIFT));
+    }
+    return 0;
+}
+
+/**
+ * Process-unique, non-zero session ID
+ *
+ * Stands in for the generation-tagged ID IEffectService::open() returns
+ * from effectd's session registry, which replaces it once the call is made
+ * (and for good when running without effectd).
+ */
+static uint32_t next_session_id(void) {
+    static atomic_uint lastId = 0;
+    uint32_t id;
+    do {
+        id = atomic_fetch_add(&lastId, 1) + 1;
+    } while (id == 0);
+    return id;
+}
+
+#if !USE_FMQ
+static pthread_mutex_t g_shm_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static EffectShmPool* g_shm_pools[2] = { NULL, NULL };  // [hugePages], live as long as the process
+
+static EffectShmPool* get_shm_pool(bool hugePages) {
+    pthread_mutex_lock(&g_shm_pool_lock);
+    if (!g_shm_pools[hugePages]) {
+        g_shm_pools[hugePages] = effect_shm_pool_create(
+            hugePages ? "effect_shm_pool_huge" : "effect_shm_pool", SHM_POOL_SIZE,
+            hugePages ? EFFECT_SHM_FLAG_HUGE_PAGES : 0);
+    }
+    EffectShmPool* pool = g_shm_pools[hugePages];
+    pthread_mutex_unlock(&g_shm_pool_lock);
+    return pool;
+}
+
+/**
+ * Give the session size bytes of shared memory for its rings: a pool slab
+ * if one is free, otherwise a private memfd
+ * 
+ * Huge page sessions use their own pool; a private huge page region is
+ * rounded up to whole huge pages.
+ * 
+ * Sets shmFd/shmAddr/shmSize and shmLayout.size/inputRingBufferOffset.
+ */
+static int map_session_memory(EffectSession* session, size_t size) {
+    bool hugePages = session->config.hugePages;
+    EffectShmPool* pool = get_shm_pool(hugePages);
+    uint64_t offset = 0;
+    
+    if (pool && effect_shm_pool_alloc(pool, size, &offset)) {
+        session->shmPool = pool;
+        session->slabOffset = offset;
+        session->slabSize = size;
+        session->shmFd = effect_shm_pool_get_fd(pool);
+        session->shmAddr = effect_shm_pool_get_base(pool);
+        session->shmSize = (size_t)effect_shm_pool_get_size(pool);
+        session->shmLayout.size = session->shmSize;
+        session->shmLayout.inputRingBufferOffset = (uint32_t)offset;
+        return 0;
+    }
+    
+    uint32_t flags = 0;
+    if (hugePages) {
+        size_t hugePage = effect_shared_memory_huge_page_size();
+        size = (size + hugePage - 1) / hugePage * hugePage;
+        flags = EFFECT_SHM_FLAG_HUGE_PAGES;
+    }
+    
+    session->shmPool = NULL;
+    session->shmFd = effect_shared_memory_create("effect_shm", size, flags);
+    if (session->shmFd < 0) {
+        return -1;
+    }
+    session->shmAddr = effect_shared_memory_map(session->shmFd, size, flags);
+    if (!session->shmAddr) {
+        close(session->shmFd);
+        session->shmFd = -1;
+        return -1;
+    }
+    session->shmSize = size;
+    session->shmLayout.size = size;
+    session->shmLayout.inputRingBufferOffset = 0;
+    return 0;
+}
+
+static void unmap_session_memory(EffectSession* session) {
+    if (session->shmPool) {
+        effect_shm_pool_free(session->shmPool, session->slabOffset, session->slabSize);
+        session->shmPool = NULL;
+    } else {
+        if (session->shmAddr) {
+            effect_shared_memory_unmap(session->shmAddr, session->shmSize);
+        }
+        if (session->shmFd >= 0) {
+            close(session->shmFd);
+        }
+    }
+    session->shmAddr = NULL;
+    session->shmFd = -1;
+}
+
+/**
+ * Process-wide connection to effectd or to one of its library hosts
+ */
+typedef struct {
+    EffectControlChannel* channel;    // NULL until first used
+    uint32_t pools;                   // Bit per g_shm_pools entry registered on channel
+} ControlConnection;
+
+static pthread_mutex_t g_control_lock = PTHREAD_MUTEX_INITIALIZER;
+static ControlConnection g_control;                             // effectd
+static ControlConnection g_library_control[NUM_EFFECT_TYPES];   // Library hosts
+static bool g_control_isolated = false;  // Whether effectd on g_control hands out hosts
+
+static void init_request(EffectControlMessage* msg, uint16_t op, uint32_t id) {
+    memset(&msg->header, 0, sizeof(msg->header));
+    msg->header.op = op;
+    msg->header.id = id;
+    msg->fds[0] = -1;
+    msg->fds[1] = -1;
+    msg->fds[2] = -1;
+}
+
+/**
+ * Drop a broken connection so that the next use reconnects (g_control_lock
+ * held)
+ */
+static void forget_if_broken(ControlConnection* connection) {
+    if (connection->channel && effect_control_is_broken(connection->channel)) {
+        effect_control_release(connection->channel);
+        connection->channel = NULL;
+    }
+}
+
+/**
+ * Connect to the host of an effect type's library (g_control_lock held)
+ *
+ * @return EFFECT_OK, EFFECT_ERROR_NOT_SUPPORTED if effectd runs the library
+ *         itself, or the error that left the library without a host
+ */
+static EffectResult connect_library(EffectType type) {
+    EffectControlMessage msg;
+    init_request(&msg, EFFECT_CONTROL_OP_CONNECT, (uint32_t)type);
+    EffectResult result = (EffectResult)effect_control_call(g_control.channel, &msg,
+                                                            EFFECT_CONTROL_CALL_TIMEOUT_MS);
+    if (result != EFFECT_OK) {
+        return result;
+    }
+    if (!(msg.header.fdMask & EFFECT_CONTROL_FD_CONNECTION) || msg.fds[0] < 0) {
+        effect_control_close_fds(&msg);
+        return EFFECT_ERROR_DEAD_OBJECT;
+    }
+    
+    ControlConnection* library = &g_library_control[type];
+    library->channel = effect_control_adopt(msg.fds[0]);
+    library->pools = 0;
+    if (!library->channel) {
+        effect_control_close_fds(&msg);
+        return EFFECT_ERROR_NO_MEMORY;
+    }
+    return EFFECT_OK;
+}
+
+/**
+ * Reference to the connection sessions of an effect type are opened on,
+ * reconnecting if the previous one broke: the library's host when effectd
+ * isolates libraries (effectd -i), otherwise effectd itself
+ * 
+ * @param channel Output: channel, or NULL if effectd is not listening
+ * @param connection Output: where the channel's pool registrations are kept
+ * @return EFFECT_OK, or the error that left the library without a host
+ */
+static EffectResult get_control(EffectType type, EffectControlChannel** channel,
+                                ControlConnection** connection) {
+    EffectResult result = EFFECT_OK;
+    *channel = NULL;
+    
+    pthread_mutex_lock(&g_control_lock);
+    forget_if_broken(&g_control);
+    if (!g_control.channel) {
+        g_control.channel = effect_control_connect(NULL);
+        g_control.pools = 0;
+        g_control_isolated = true;    // Until effectd says otherwise
+    }
+    
+    *connection = &g_control;
+    if (g_control.channel && g_control_isolated && (unsigned)type < NUM_EFFECT_TYPES) {
+        ControlConnection* library = &g_library_control[type];
+        forget_if_broken(library);
+        if (!library->channel) {
+            result = connect_library(type);
+            if (result == EFFECT_ERROR_NOT_SUPPORTED) {
+                g_control_isolated = false;
+                result = EFFECT_OK;
+            }
+        }
+        if (library->channel) {
+            *connection = library;
+        }
+    }
+    
+    if (result == EFFECT_OK) {
+        *channel = (*connection)->channel;
+        effect_control_acquire(*channel);
+    }
+    pthread_mutex_unlock(&g_control_lock);
+    return result;
+}
+
+/**
+ * Open the session's counterpart in effectd, handing over the rings and
+ * eventfds; the pool is registered in the same round trip the first time
+ * 
+ * Without effectd the session stays local and nothing processes its rings
+ * (Process() times out to passthrough).
+ */
+static EffectResult open_in_effectd(EffectSession* session) {
+    EffectControlChannel* control;
+    ControlConnection* connection;
+    EffectResult connected = get_control(session->effectType, &control, &connection);
+    if (!control) {
+        return connected;
+    }
+    
+    bool hugePages = session->config.hugePages;
+    uint32_t poolId = session->shmPool ? (uint32_t)hugePages + 1 : 0;
+    uint32_t poolBit = 1u << hugePages;
+    
+    EffectControlMessage msgs[2];
+    EffectControlMessage* reg = &msgs[0];
+    init_request(reg, EFFECT_CONTROL_OP_REGISTER_POOL, poolId);
+    reg->header.fdMask = EFFECT_CONTROL_FD_SHM;
+    reg->fds[0] = session->shmFd;
+    reg->header.payloadSize = sizeof(reg->body.pool);
+    reg->body.pool.size = session->shmSize;
+    
+    EffectControlMessage* open = &msgs[1];
+    init_request(open, EFFECT_CONTROL_OP_OPEN, 0);
+    memset(&open->body.open, 0, sizeof(open->body.open));
+    open->header.payloadSize = sizeof(open->body.open);
+    open->body.open.effectType = session->effectType;
+    open->body.open.sampleRate = session->config.sampleRate;
+    open->body.open.channels = session->config.channels;
+    open->body.open.format = session->config.format;
+    open->body.open.framesPerBuffer = session->config.framesPerBuffer;
+    open->body.open.wakeupType = session->config.wakeupMode;
+    open->body.open.poolId = poolId;
+    open->body.open.layout = session->shmLayout;
+    if (poolId == 0) {
+        open->header.fdMask |= EFFECT_CONTROL_FD_SHM;
+        open->fds[0] = session->shmFd;
+    }
+    if (session->eventFdIn >= 0 && session->eventFdOut >= 0) {
+        open->header.fdMask |= EFFECT_CONTROL_FD_EVENT_IN | EFFECT_CONTROL_FD_EVENT_OUT;
+        open->fds[1] = session->eventFdIn;
+        open->fds[2] = session->eventFdOut;
+    }
+    
+    // The first open on a connection registers the pool in the same packet.
+    // Deciding and sending under the lock keeps a concurrent open from
+    // overtaking the registration.
+    pthread_mutex_lock(&g_control_lock);
+    bool registering = poolId != 0 && control == connection->channel &&
+                       !(connection->pools & poolBit);
+    int submitted = registering ? effect_control_submit(control, msgs, 2) :
+                                  effect_control_submit(control, open, 1);
+    if (registering && submitted == 0) {
+        connection->pools |= poolBit;
+    }
+    pthread_mutex_unlock(&g_control_lock);
+    
+    // The replies arrive together, in order
+    int32_t result = EFFECT_CONTROL_ERROR_DEAD_OBJECT;
+    EffectControlMessage reply;
+    if (submitted == 0) {
+        if (registering &&
+            (effect_control_wait(control, reg->header.requestId, &reply,
+                                 EFFECT_CONTROL_CALL_TIMEOUT_MS) < 0 ||
+             reply.header.result != EFFECT_CONTROL_OK)) {
+            pthread_mutex_lock(&g_control_lock);
+            if (control == connection->channel) {
+                connection->pools &= ~poolBit;
+            }
+            pthread_mutex_unlock(&g_control_lock);
+        }
+        if (effect_control_wait(control, open->header.requestId, &reply,
+                                EFFECT_CONTROL_CALL_TIMEOUT_MS) == 0) {
+            result = reply.header.result;
+        }
+    }
+    
+    if (result != EFFECT_CONTROL_OK) {
+        effect_control_release(control);
+        return (EffectResult)result;
+    }
+    
+    session->sessionId = reply.header.id;
+    session->control = control;
+    return EFFECT_OK;
+}
+
+/**
+ * Make a call on the session's counterpart in effectd (no-op without one)
+ */
+static EffectResult call_effectd(EffectSession* session, EffectControlMessage* msg) {
+    if (!session->control) {
+        return EFFECT_OK;
+    }
+    
+    // A reply that does not come in time breaks the connection, and the
+    // session is reattached as if effectd had died
+    int32_t result = effect_control_call(session->control, msg, EFFECT_CONTROL_CALL_TIMEOUT_MS);
+    if (result == EFFECT_CONTROL_ERROR_DEAD_OBJECT || result == EFFECT_CONTROL_ERROR_TIMEOUT) {
+        session->isConnected = false;
+    }
+    return (EffectResult)result;
+}
+
+/**
+ * Queue a command for effectd's processing context
+ * 
+ * It applies from the first period submitted after this call, or at the
+ * next start or stop if the session is not processing.
+ */
+static EffectResult queue_command(EffectSession* session, EffectCommandType type,
+                                  uint32_t key, const void* value, uint32_t valueSize) {
+    EffectCommand command;
+    memset(&command, 0, sizeof(command));
+    command.type = (uint32_t)type;
+    command.key = key;
+    command.valueSize = valueSize;
+    if (valueSize > 0) {
+        memcpy(command.value, value, valueSize);
+    }
+    
+    pthread_mutex_lock(&session->commandLock);
+    command.position = effect_ringbuffer_get_write_position(&session->inputRb);
+    size_t written = effect_ringbuffer_write(&session->commandRb, &command, sizeof(command));
+    pthread_mutex_unlock(&session->commandLock);
+    
+    // Full: effectd has fallen a whole ring of commands behind
+    return written == sizeof(command) ? EFFECT_OK : EFFECT_ERROR_TIMEOUT;
+}
+
+/**
+ * Build a SET_PARAM call for the control plane
+ */
+static void init_param_request(EffectSession* session, EffectControlMessage* msg, uint32_t key,
+                               const void* value, uint32_t valueSize) {
+    init_request(msg, EFFECT_CONTROL_OP_SET_PARAM, session->sessionId);
+    msg->header.payloadSize = (uint32_t)offsetof(EffectControlParamArgs, value) + valueSize;
+    msg->body.param.key = key;
+    msg->body.param.valueSize = valueSize;
+    memcpy(msg->body.param.value, value, valueSize);
+}
+
+/**
+ * Build a SET_PARAM_BLOB call passing either a sealed memfd or an open file
+ */
+static void init_blob_request(EffectSession* session, EffectControlMessage* msg, uint32_t key,
+                              int fd, bool isFile) {
+    init_request(msg, EFFECT_CONTROL_OP_SET_PARAM_BLOB, session->sessionId);
+    msg->body.blob.key = key;
+    msg->body.blob.flags = isFile ? EFFECT_CONTROL_BLOB_FILE : 0;
+    msg->header.payloadSize = sizeof(EffectControlBlobArgs);
+    msg->header.fdMask = EFFECT_CONTROL_FD_BLOB;
+    msg->fds[0] = fd;
+}
+
+static void free_param(ParamRecord* record) {
+    if (record->blobFd >= 0) {
+        close(record->blobFd);
+    }
+    free(record);
+}
+
+/**
+ * Remember the value effectd accepted for key, replacing the previous one
+ *
+ * Best effort: a value that cannot be recorded is simply not replayed.
+ */
+static void record_param(EffectSession* session, uint32_t key, const void* value,
+                         uint32_t valueSize, int fd, bool isFile) {
+    ParamRecord* record = (ParamRecord*)calloc(1, sizeof(ParamRecord) + valueSize);
+    if (!record) {
+        return;
+    }
+    record->key = key;
+    record->blobFd = fd >= 0 ? fcntl(fd, F_DUPFD_CLOEXEC, 0) : -1;
+    record->blobIsFile = isFile;
+    record->valueSize = valueSize;
+    if (valueSize > 0) {
+        memcpy(record->value, value, valueSize);
+    }
+    if (fd >= 0 && record->blobFd < 0) {
+        free_param(record);
+        return;
+    }
+    
+    // Replay in the order values were last set; a plugin may expect a model
+    // before the parameters that refer to it
+    ParamRecord** link = &session->params;
+    while (*link) {
+        if ((*link)->key == key) {
+            ParamRecord* old = *link;
+            *link = old->next;
+            free_param(old);
+        } else {
+            link = &(*link)->next;
+        }
+    }
+    *link = record;
+}
+
+static void free_params(EffectSession* session) {
+    while (session->params) {
+        ParamRecord* record = session->params;
+        session->params = record->next;
+        free_param(record);
+    }
+}
+
+// Sessions open in effectd, for the monitor thread
+static pthread_mutex_t g_sessions_lock = PTHREAD_MUTEX_INITIALIZER;
+static EffectSession* g_sessions = NULL;
+static pthread_once_t g_monitor_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Move a session whose effectd connection broke onto a new one: reopen it
+ * on the same rings, replay its parameters and restart it if it was running
+ *
+ * Called with g_sessions_lock held.
+ *
+ * @return EFFECT_OK, or the error that leaves the session detached
+ */
+static EffectResult reattach_session(EffectSession* session) {
+    pthread_mutex_lock(&session->controlLock);
+    
+    // Once Process() has seen this, it passes audio through and leaves the
+    // rings alone until we are done
+    atomic_store(&session->detached, true);
+    while (atomic_load(&session->inProcess)) {
+        usleep(DETACH_POLL_US);
+    }
+    
+    // Whatever the dead effectd left half done would come out late, so the
+    // new one starts from empty rings
+    effect_ringbuffer_reset(&session->inputRb);
+    effect_ringbuffer_reset(&session->outputRb);
+    effect_ringbuffer_reset(&session->commandRb);
+    session->submitSeq = 0;
+    session->readSeq = 0;
+    session->startSeq = 0;
+    session->serviceTimeUs = 0;
+    session->breakerOpen = false;
+    session->missStreak = 0;
+    
+    EffectControlChannel* old = session->control;
+    session->control = NULL;
+    EffectResult result = open_in_effectd(session);
+    if (result == EFFECT_OK && !session->control) {
+        // Not listening yet
+        result = EFFECT_ERROR_DEAD_OBJECT;
+    }
+    if (result != EFFECT_OK) {
+        session->control = old;
+        pthread_mutex_unlock(&session->controlLock);
+        return result;
+    }
+    effect_control_release(old);
+    
+    // A value the new effectd rejects is dropped, as it would have been then
+    EffectControlMessage msg;
+    for (ParamRecord* record = session->params; record; record = record->next) {
+        if (record->blobFd >= 0) {
+            init_blob_request(session, &msg, record->key, record->blobFd, record->blobIsFile);
+        } else {
+            init_param_request(session, &msg, record->key, record->value, record->valueSize);
+        }
+        call_effectd(session, &msg);
+    }
+    if (session->bypassed) {
+        queue_command(session, EFFECT_COMMAND_BYPASS, 1, NULL, 0);
+    }
+    if (session->isStarted) {
+        init_request(&msg, EFFECT_CONTROL_OP_START, session->sessionId);
+        result = call_effectd(session, &msg);
+    }
+    
+    if (result == EFFECT_OK) {
+        session->isConnected = true;
+        atomic_store(&session->detached, false);
+    } else {
+        // Try again from scratch on the next pass
+        init_request(&msg, EFFECT_CONTROL_OP_CLOSE, session->sessionId);
+        call_effectd(session, &msg);
+    }
+    pthread_mutex_unlock(&session->controlLock);
+    return result;
+}
+
+/**
+ * Reattach every session whose connection broke
+ *
+ * @return Number of sessions still detached
+ */
+static uint32_t reattach_sessions(void) {
+    uint32_t detached = 0;
+    pthread_mutex_lock(&g_sessions_lock);
+    for (EffectSession* session = g_sessions; session; session = session->nextAttached) {
+        if (atomic_load(&session->detached) || effect_control_is_broken(session->control)) {
+            if (reattach_session(session) != EFFECT_OK) {
+                detached++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_sessions_lock);
+    return detached;
+}
+
+/**
+ * Watch the connections to effectd and its library hosts, and reattach
+ * sessions as soon as one breaks instead of leaving them in passthrough
+ * until they are reopened
+ *
+ * Under the supervisor (effectd -S) a standby is already serving the socket
+ * when the reconnect arrives, and a crashed library host is replaced at the
+ * reconnect; a plain restart is waited for with backoff.
+ */
+static void* monitor_thread_func(void* arg) {
+    (void)arg;
+    
+    while (true) {
+        EffectControlChannel* channels[1 + NUM_EFFECT_TYPES];
+        uint32_t count = 0;
+        pthread_mutex_lock(&g_control_lock);
+        if (g_control.channel) {
+            channels[count++] = g_control.channel;
+        }
+        for (int type = 0; type < NUM_EFFECT_TYPES; type++) {
+            if (g_library_control[type].channel) {
+                channels[count++] = g_library_control[type].channel;
+            }
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            effect_control_acquire(channels[i]);
+        }
+        pthread_mutex_unlock(&g_control_lock);
+        
+        if (count > 0) {
+            // Times out to pick up connections made in the meantime
+            if (effect_control_wait_broken(channels, count, MONITOR_RESCAN_MS) >= 0) {
+                // Reconnect on next use, so an idle process does not spin here
+                pthread_mutex_lock(&g_control_lock);
+                forget_if_broken(&g_control);
+                for (int type = 0; type < NUM_EFFECT_TYPES; type++) {
+                    forget_if_broken(&g_library_control[type]);
+                }
+                pthread_mutex_unlock(&g_control_lock);
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                effect_control_release(channels[i]);
+            }
+        } else {
+            usleep(REATTACH_MAX_DELAY_US);
+        }
+        
+        uint32_t delayUs = REATTACH_MIN_DELAY_US;
+        while (reattach_sessions() > 0) {
+            usleep(delayUs);
+            delayUs = delayUs * 2 < REATTACH_MAX_DELAY_US ? delayUs * 2 : REATTACH_MAX_DELAY_US;
+        }
+    }
+    return NULL;
+}
+
+static void start_monitor(void) {
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_create(&thread, &attr, monitor_thread_func, NULL);
+    pthread_attr_destroy(&attr);
+}
+
+static void add_session(EffectSession* session) {
+    pthread_once(&g_monitor_once, start_monitor);
+    
+    pthread_mutex_lock(&g_sessions_lock);
+    session->nextAttached = g_sessions;
+    g_sessions = session;
+    pthread_mutex_unlock(&g_sessions_lock);
+}
+
+static void remove_session(EffectSession* session) {
+    pthread_mutex_lock(&g_sessions_lock);
+    for (EffectSession** link = &g_sessions; *link; link = &(*link)->nextAttached) {
+        if (*link == session) {
+            *link = session->nextAttached;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_sessions_lock);
+}
+#endif
+
+static void lock_control(EffectSession* session) {
+#if USE_FMQ
+    (void)session;
+#else
+    pthread_mutex_lock(&session->controlLock);
+#endif
+}
+
+static void unlock_control(EffectSession* session) {
+#if USE_FMQ
+    (void)session;
+#else
+    pthread_mutex_unlock(&session->controlLock);
+#endif
+}
+
 EffectResult EffectClient_Open(EffectType effectType, const EffectConfig* config, EffectHandle* handle) {
-    if (!config || !handle) {
+    if (!config || !handle || config->framesPerBuffer == 0 || config->channels == 0) {
+        return EFFECT_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    // Rings hold the pipeline, the next submission and some slack for output
+    // that arrives after a timeout; the capacity must be a power of two
+    uint32_t periodBytes = calculate_bytes_per_frame(config) * config->framesPerBuffer;
+    uint64_t ringBytes = (uint64_t)(config->pipelineDepth + 1 + RING_SLACK_PERIODS) * periodBytes;
+    if (ringBytes > MAX_BUFFER_SIZE) {
         return EFFECT_ERROR_INVALID_ARGUMENTS;
     }
+    uint32_t ringCapacity = 1;
+    while (ringCapacity < ringBytes) {
+        ringCapacity <<= 1;
+    }
     
-    // Allocate session
-    EffectSession* session = (EffectSession*)calloc(1, sizeof(EffectSession));
-    if (!session) {
+    // Allocate session in its own locked arena so Process() never faults
+    effect_arena_t arena;
+    if (effect_arena_create(&arena, effect_arena_footprint(sizeof(EffectSession))) < 0) {
         return EFFECT_ERROR_NO_MEMORY;
     }
+    EffectSession* session = (EffectSession*)effect_arena_alloc(&arena, sizeof(EffectSession));
+    session->arena = arena;
     
     session->effectType = effectType;
     session->config = *config;
-    session->sessionId = (uint32_t)getpid(); // Simple session ID
+    session->sessionId = next_session_id();
+    session->periodBytes = periodBytes;
+    session->ringCapacity = ringCapacity;
+    
+    // Output that misses its share of the period is of no use to the caller
+    uint32_t periodUs = (uint32_t)((uint64_t)config->framesPerBuffer * 1000000ULL /
+                                   (config->sampleRate ? config->sampleRate : 48000));
+    uint32_t timeoutPercent = config->timeoutPercent ? config->timeoutPercent :
+                              DEFAULT_TIMEOUT_PERCENT;
+    session->timeoutUs = (int64_t)periodUs * timeoutPercent / 100;
+    
+    session->breakerMisses = config->breakerMisses ? config->breakerMisses :
+                             DEFAULT_BREAKER_MISSES;
+    
+    // Spinning is capped to a quarter period, and pointless on one CPU
+    session->maxSpinUs = config->maxSpinUs ? config->maxSpinUs : DEFAULT_MAX_SPIN_US;
+    if (session->maxSpinUs > periodUs / 4) {
+        session->maxSpinUs = periodUs / 4;
+    }
+    if (sysconf(_SC_NPROCESSORS_ONLN) <= 1) {
+        session->maxSpinUs = 0;
+    }
     
-    pthread_mutex_init(&session->statsMutex, NULL);
+    effect_seqlock_init(&session->statsLock);
+    pthread_mutex_init(&session->intervalMutex, NULL);
+#if !USE_FMQ
+    pthread_mutex_init(&session->commandLock, NULL);
+    pthread_mutex_init(&session->controlLock, NULL);
+#endif
     
 #if USE_FMQ
     // Create FMQ for audio data transfer
-    uint32_t bytesPerFrame = calculate_bytes_per_frame(config);
-    size_t queueCapacity = MAX_BUFFER_SIZE; // Capacity in bytes
+    size_t queueCapacity = session->ringCapacity; // Capacity in bytes
     
     session->inputFmq = effect_fmq_create(EFFECT_FMQ_SYNCHRONIZED, queueCapacity, 1);
     if (!session->inputFmq) {
-        free(session);
+        effect_arena_destroy(&session->arena);
         return EFFECT_ERROR_NO_MEMORY;
     }
     
     session->outputFmq = effect_fmq_create(EFFECT_FMQ_SYNCHRONIZED, queueCapacity, 1);
     if (!session->outputFmq) {
         effect_fmq_destroy(session->inputFmq);
-        free(session);
+        effect_arena_destroy(&session->arena);
         return EFFECT_ERROR_NO_MEMORY;
     }
     
@@ -103,52 +970,92 @@ EffectResult EffectClient_Open(EffectType effectType, const EffectConfig* config
     // for the other process to access the same FMQ.
     
 #else
-    // Legacy: Create shared memory for ring buffers
-    size_t ringBufferSize = MAX_BUFFER_SIZE;
-    session->shmSize = ringBufferSize * 2; // Input + output
-    
-    session->shmFd = effect_shared_memory_create("effect_shm", session->shmSize);
-    if (session->shmFd < 0) {
-        free(session);
+    // Legacy: Shared memory for ring buffers, carved from the pool so the
+    // session costs no new fd or mapping
+    // Layout: [input header | input data][output header | output data][commands]
+    size_t ringRegionSize = effect_ringbuffer_shared_size(session->ringCapacity);
+    size_t commandRegionSize = effect_ringbuffer_shared_size(EFFECT_COMMAND_RING_SLOTS * EFFECT_COMMAND_SIZE);
+    if (map_session_memory(session, ringRegionSize * 2 + commandRegionSize) < 0) {
+        effect_arena_destroy(&session->arena);
         return EFFECT_ERROR_NO_MEMORY;
     }
-    
-    session->shmAddr = effect_shared_memory_map(session->shmFd, session->shmSize);
-    if (!session->shmAddr) {
-        close(session->shmFd);
-        free(session);
-        return EFFECT_ERROR_NO_MEMORY;
+    session->shmLayout.inputRingBufferSize = (uint32_t)ringRegionSize;
+    session->shmLayout.outputRingBufferOffset = session->shmLayout.inputRingBufferOffset +
+                                                (uint32_t)ringRegionSize;
+    session->shmLayout.outputRingBufferSize = (uint32_t)ringRegionSize;
+    session->shmLayout.commandRingBufferOffset = session->shmLayout.outputRingBufferOffset +
+                                                 (uint32_t)ringRegionSize;
+    session->shmLayout.commandRingBufferSize = (uint32_t)commandRegionSize;
+    
+    // Initialize ring buffers in place so effectd can attach to them.
+    // Both audio rings move whole periods only, the command ring whole commands.
+    if (effect_ringbuffer_create_shared(&session->inputRb,
+                                        (uint8_t*)session->shmAddr + session->shmLayout.inputRingBufferOffset,
+                                        session->ringCapacity, session->periodBytes) < 0 ||
+        effect_ringbuffer_create_shared(&session->outputRb,
+                                        (uint8_t*)session->shmAddr + session->shmLayout.outputRingBufferOffset,
+                                        session->ringCapacity, session->periodBytes) < 0 ||
+        effect_ringbuffer_create_shared(&session->commandRb,
+                                        (uint8_t*)session->shmAddr + session->shmLayout.commandRingBufferOffset,
+                                        EFFECT_COMMAND_RING_SLOTS * EFFECT_COMMAND_SIZE,
+                                        EFFECT_COMMAND_SIZE) < 0) {
+        unmap_session_memory(session);
+        effect_arena_destroy(&session->arena);
+        return EFFECT_ERROR_INVALID_ARGUMENTS;
     }
+#endif
     
-    // Initialize ring buffers
-    effect_ringbuffer_init(&session->inputRb, session->shmAddr, ringBufferSize);
-    effect_ringbuffer_init(&session->outputRb, 
-                          (uint8_t*)session->shmAddr + ringBufferSize, 
-                          ringBufferSize);
+#if USE_FMQ
+    // FMQ has no doorbell in our ring header, so always use eventfds
+    EffectWakeupType wakeupType = EFFECT_WAKEUP_EVENTFD;
+    effect_ringbuffer_t* inputRb = NULL;
+    effect_ringbuffer_t* outputRb = NULL;
+#else
+    EffectWakeupType wakeupType = (EffectWakeupType)config->wakeupMode;
+    effect_ringbuffer_t* inputRb = &session->inputRb;
+    effect_ringbuffer_t* outputRb = &session->outputRb;
 #endif
     
-    // Create event FDs (still used for timeout control even with FMQ)
-    session->eventFdIn = effect_eventfd_create(0);
-    session->eventFdOut = effect_eventfd_create(0);
+    // Create event FDs only when the strategy needs them
+    session->eventFdIn = -1;
+    session->eventFdOut = -1;
+    if (wakeupType == EFFECT_WAKEUP_EVENTFD) {
+        session->eventFdIn = effect_eventfd_create(0);
+        session->eventFdOut = effect_eventfd_create(0);
+    }
     
-    if (session->eventFdIn < 0 || session->eventFdOut < 0) {
+    if (effect_wakeup_init(&session->inputWakeup, wakeupType, session->eventFdIn, inputRb, 0) < 0 ||
+        effect_wakeup_init(&session->outputWakeup, wakeupType, session->eventFdOut, outputRb, 0) < 0) {
         if (session->eventFdIn >= 0) close(session->eventFdIn);
         if (session->eventFdOut >= 0) close(session->eventFdOut);
 #if USE_FMQ
         effect_fmq_destroy(session->inputFmq);
         effect_fmq_destroy(session->outputFmq);
 #else
-        effect_shared_memory_unmap(session->shmAddr, session->shmSize);
-        close(session->shmFd);
+        unmap_session_memory(session);
 #endif
-        free(session);
+        effect_arena_destroy(&session->arena);
         return EFFECT_ERROR_NO_MEMORY;
     }
     
-    session->isConnected = true;
-    
+#if USE_FMQ
     // TODO: In real implementation, connect to effectd via HIDL here
-    // and pass the FMQ descriptors or FDs to the service
+    // and pass the FMQ descriptors to the service
+#else
+    EffectResult result = open_in_effectd(session);
+    if (result != EFFECT_OK) {
+        if (session->eventFdIn >= 0) close(session->eventFdIn);
+        if (session->eventFdOut >= 0) close(session->eventFdOut);
+        unmap_session_memory(session);
+        effect_arena_destroy(&session->arena);
+        return result;
+    }
+    if (session->control) {
+        add_session(session);
+    }
+#endif
+    
+    session->isConnected = true;
     
     *handle = (EffectHandle)session;
     return EFFECT_OK;
@@ -165,20 +1072,75 @@ EffectResult EffectClient_Start(EffectHandle handle) {
         return EFFECT_ERROR_DEAD_OBJECT;
     }
     
-    session->isStarted = true;
-    
+    lock_control(session);
+#if USE_FMQ
     // TODO: Call HIDL start() method
+#else
+    EffectControlMessage msg;
+    init_request(&msg, EFFECT_CONTROL_OP_START, session->sessionId);
+    EffectResult result = call_effectd(session, &msg);
+    if (result != EFFECT_OK) {
+        unlock_control(session);
+        return result;
+    }
+#endif
+    
+    // Restart the pipeline from empty; output still owed for periods
+    // submitted before the last Stop is dropped as it arrives
+    session->startSeq = session->submitSeq;
+    session->breakerOpen = false;
+    session->missStreak = 0;
+    session->isStarted = true;
+    unlock_control(session);
     
     return EFFECT_OK;
 }
 
-EffectResult EffectClient_Process(EffectHandle handle, const void* input, void* output, uint32_t frames) {
-    if (!handle || !input || !output || frames == 0) {
-        return EFFECT_ERROR_INVALID_ARGUMENTS;
+/**
+ * Feed the circuit breaker the outcome of a call that waited for effectd
+ * 
+ * @param onTime Whether the output was ready within the timeout
+ */
+static void update_breaker(EffectSession* session, bool onTime, int64_t now) {
+    if (!session->breakerOpen) {
+        if (onTime) {
+            session->missStreak = 0;
+        } else if (++session->missStreak >= session->breakerMisses) {
+            session->breakerOpen = true;
+            session->probeStreak = 0;
+            session->nextProbeUs = now + BREAKER_PROBE_INTERVAL_US;
+            
+            effect_seqlock_write_begin(&session->statsLock);
+            session->stats.breakerTripCount++;
+            effect_seqlock_write_end(&session->statsLock);
+        }
+        return;
     }
     
-    EffectSession* session = (EffectSession*)handle;
+    if (!onTime) {
+        session->probeStreak = 0;
+        session->nextProbeUs = now + BREAKER_PROBE_INTERVAL_US;
+        return;
+    }
+    
+    // Probe again on the next call until the streak is long enough
+    if (++session->probeStreak < BREAKER_CLOSE_PROBES) {
+        session->nextProbeUs = now;
+        return;
+    }
     
+    // Pipelined sessions refill the pipeline, as after Start
+    session->breakerOpen = false;
+    session->missStreak = 0;
+    session->startSeq = session->submitSeq;
+    
+    effect_seqlock_write_begin(&session->statsLock);
+    session->stats.breakerRecoveryCount++;
+    effect_seqlock_write_end(&session->statsLock);
+}
+
+static EffectResult process_periods(EffectSession* session, const void* input, void* output,
+                                    uint32_t frames) {
     if (!session->isStarted) {
         return EFFECT_ERROR_INVALID_STATE;
     }
@@ -188,119 +1150,164 @@ EffectResult EffectClient_Process(EffectHandle handle, const void* input, void*
     uint32_t bytesPerFrame = calculate_bytes_per_frame(&session->config);
     uint32_t totalBytes = frames * bytesPerFrame;
     
-#if USE_FMQ
-    // Write input to FMQ
-    size_t written = effect_fmq_write(session->inputFmq, input, totalBytes);
-    if (written < totalBytes) {
-        // Queue full - this is an xrun
-        pthread_mutex_lock(&session->statsMutex);
-        session->stats.xrunCount++;
-        pthread_mutex_unlock(&session->statsMutex);
-        
-        // Fallback to passthrough
+    // effectd only processes whole periods; the HAL still gets audio
+    if (totalBytes % session->periodBytes != 0) {
         memcpy(output, input, totalBytes);
-        return EFFECT_ERROR_TIMEOUT;
-    }
-    
-    // Signal effectd that data is available
-    effect_eventfd_signal(session->eventFdIn);
-    
-    // Wait for output data with timeout
-    int wait_result = effect_eventfd_wait(session->eventFdOut, TIMEOUT_MS);
-    if (wait_result < 0) {
-        pthread_mutex_lock(&session->statsMutex);
-        session->stats.timeoutCount++;
-        pthread_mutex_unlock(&session->statsMutex);
-        
-        // Timeout - fall back to passthrough
-        memcpy(output, input, totalBytes);
-        return EFFECT_ERROR_TIMEOUT;
+        return EFFECT_ERROR_INVALID_ARGUMENTS;
     }
     
-    // Read output from FMQ
-    size_t read = effect_fmq_read(session->outputFmq, output, totalBytes);
-    if (read < totalBytes) {
-        // Not enough data - passthrough
+    // Breaker open: bypass effectd until the next probe is due
+    if (session->breakerOpen && start_time < session->nextProbeUs) {
         memcpy(output, input, totalBytes);
         
-        pthread_mutex_lock(&session->statsMutex);
+        effect_seqlock_write_begin(&session->statsLock);
         session->stats.droppedFrames += frames;
-        pthread_mutex_unlock(&session->statsMutex);
+        effect_seqlock_write_end(&session->statsLock);
         
         return EFFECT_ERROR_TIMEOUT;
     }
-#else
-    // Legacy: Write input to ring buffer
-    uint32_t written = effect_ringbuffer_write(&session->inputRb, input, totalBytes);
-    if (written < totalBytes) {
-        // Buffer full - this is an underrun
-        pthread_mutex_lock(&session->statsMutex);
+    
+    // Output owed to calls that already returned goes first, so effectd
+    // has room for this call's periods. Probes wait for their own output.
+    uint32_t periods = totalBytes / session->periodBytes;
+    uint32_t depth = session->breakerOpen ? 0 : session->config.pipelineDepth;
+    if (session->submitSeq >= session->startSeq + depth) {
+        drop_late_output(session, session->submitSeq - depth);
+    }
+    
+    // Write input (all periods or nothing)
+    if (!write_input(session, input, totalBytes)) {
+        // Queue full - this is an xrun. Make sure effectd knows about what
+        // is queued: input left over from before a Stop was never signaled.
+        effect_wakeup_signal(&session->inputWakeup);
+        
+        effect_seqlock_write_begin(&session->statsLock);
         session->stats.xrunCount++;
-        pthread_mutex_unlock(&session->statsMutex);
+        effect_seqlock_write_end(&session->statsLock);
+        
+        // Fallback to passthrough
+        memcpy(output, input, totalBytes);
         return EFFECT_ERROR_TIMEOUT;
     }
     
     // Signal effectd that data is available
-    effect_eventfd_signal(session->eventFdIn);
+    int64_t submit_time = get_time_us();
+    effect_wakeup_signal(&session->inputWakeup);
+    session->submitSeq += periods;
+    
+    if (session->submitSeq < session->startSeq + depth + periods) {
+        // Pipelined mode still filling: the first processed period is
+        // returned pipelineDepth periods from now
+        drop_late_output(session, session->startSeq);
+        memset(output, 0, totalBytes);
+        return EFFECT_OK;
+    }
+    
+    // This call returns the periods submitted pipelineDepth periods ago;
+    // in pipelined mode their output is normally already queued
+    uint64_t wantSeq = session->submitSeq - depth - periods;
+    drop_late_output(session, wantSeq);
+    
+    uint32_t owedBytes = (uint32_t)(wantSeq + periods - session->readSeq) * session->periodBytes;
+    int wait_result = wait_for_output(session, owedBytes, submit_time, session->timeoutUs);
+    drop_late_output(session, wantSeq);
+    update_breaker(session, wait_result == 0, get_time_us());
     
-    // Wait for output data with timeout
-    int wait_result = effect_eventfd_wait(session->eventFdOut, TIMEOUT_MS);
     if (wait_result < 0) {
-        pthread_mutex_lock(&session->statsMutex);
+        // Salvage the periods effectd finished in time and pass the rest
+        // through; their output is dropped when it shows up
+        uint32_t ready = 0;
+        if (session->readSeq == wantSeq) {
+            ready = output_available(session) / session->periodBytes;
+            if (ready > periods) {
+                ready = periods;
+            }
+            if (ready > 0 && !read_output(session, output, ready)) {
+                ready = 0;
+            }
+        }
+        uint32_t readyBytes = ready * session->periodBytes;
+        memcpy((uint8_t*)output + readyBytes, (const uint8_t*)input + readyBytes,
+               totalBytes - readyBytes);
+        
+        effect_seqlock_write_begin(&session->statsLock);
         session->stats.timeoutCount++;
-        pthread_mutex_unlock(&session->statsMutex);
+        session->stats.processedFrames += ready * session->config.framesPerBuffer;
+        effect_seqlock_write_end(&session->statsLock);
         
-        // Timeout - fall back to passthrough
-        memcpy(output, input, totalBytes);
         return EFFECT_ERROR_TIMEOUT;
     }
     
-    // Read output from ring buffer
-    uint32_t read = effect_ringbuffer_read(&session->outputRb, output, totalBytes);
-    if (read < totalBytes) {
+    // Read output (all periods or nothing)
+    if (!read_output(session, output, periods)) {
         // Not enough data - passthrough
         memcpy(output, input, totalBytes);
         
-        pthread_mutex_lock(&session->statsMutex);
+        effect_seqlock_write_begin(&session->statsLock);
         session->stats.droppedFrames += frames;
-        pthread_mutex_unlock(&session->statsMutex);
+        effect_seqlock_write_end(&session->statsLock);
         
         return EFFECT_ERROR_TIMEOUT;
     }
-#endif
     
     // Update statistics
     int64_t end_time = get_time_us();
     uint32_t latency = (uint32_t)(end_time - start_time);
     
-    pthread_mutex_lock(&session->statsMutex);
+    effect_seqlock_write_begin(&session->statsLock);
     session->stats.processedFrames += frames;
+    effect_histogram_record(&session->latencyHist, latency);
+    effect_seqlock_write_end(&session->statsLock);
     
-    // Simple rolling average for latency
-    if (session->stats.avgLatencyUs == 0) {
-        session->stats.avgLatencyUs = latency;
-    } else {
-        session->stats.avgLatencyUs = (session->stats.avgLatencyUs * 9 + latency) / 10;
+    return EFFECT_OK;
+}
+
+EffectResult EffectClient_Process(EffectHandle handle, const void* input, void* output, uint32_t frames) {
+    if (!handle || !input || !output || frames == 0) {
+        return EFFECT_ERROR_INVALID_ARGUMENTS;
     }
     
-    if (latency > session->stats.maxLatencyUs) {
-        session->stats.maxLatencyUs = latency;
+    EffectSession* session = (EffectSession*)handle;
+    
+#if USE_FMQ
+    return process_periods(session, input, output, frames);
+#else
+    // Either we see the reattach start, or it waits for us to leave
+    atomic_store(&session->inProcess, true);
+    if (atomic_load(&session->detached)) {
+        atomic_store(&session->inProcess, false);
+        
+        // effectd died; passthrough until the session is reattached
+        memcpy(output, input, frames * calculate_bytes_per_frame(&session->config));
+        
+        effect_seqlock_write_begin(&session->statsLock);
+        session->stats.droppedFrames += frames;
+        effect_seqlock_write_end(&session->statsLock);
+        
+        return EFFECT_ERROR_DEAD_OBJECT;
     }
     
-    // Approximate P95 (simplified)
-    if (latency > session->stats.p95LatencyUs) {
-        session->stats.p95LatencyUs = latency;
+    EffectResult result = process_periods(session, input, output, frames);
+    atomic_store_explicit(&session->inProcess, false, memory_order_release);
+    return result;
+#endif
+}
+
+EffectResult EffectClient_GetLatency(EffectHandle handle, uint32_t* latencyFrames) {
+    if (!handle || !latencyFrames) {
+        return EFFECT_ERROR_INVALID_ARGUMENTS;
     }
     
-    pthread_mutex_unlock(&session->statsMutex);
+    EffectSession* session = (EffectSession*)handle;
+    
+    *latencyFrames = session->config.pipelineDepth * session->config.framesPerBuffer;
     
     return EFFECT_OK;
 }
 
-EffectResult EffectClient_SetParam(EffectHandle handle, 
-                                   uint32_t key __attribute__((unused)), 
+EffectResult EffectClient_SetParam(EffectHandle handle, uint32_t key,
                                    const void* value, uint32_t valueSize) {
-    if (!handle || !value || valueSize == 0) {
+    if (!handle || !value || valueSize == 0 || valueSize > EFFECT_CONTROL_MAX_PARAM_SIZE) {
         return EFFECT_ERROR_INVALID_ARGUMENTS;
     }
     
@@ -310,9 +1317,165 @@ EffectResult EffectClient_SetParam(EffectHandle handle,
         return EFFECT_ERROR_DEAD_OBJECT;
     }
     
+#if USE_FMQ
     // TODO: Call HIDL setParam() method
+    (void)key;
+    return EFFECT_OK;
+#else
+    lock_control(session);
+    EffectResult result;
     
+    // Small values ride the command ring and land on a period boundary
+    if (session->control && session->isStarted && valueSize <= EFFECT_COMMAND_MAX_VALUE_SIZE) {
+        result = queue_command(session, EFFECT_COMMAND_SET_PARAM, key, value, valueSize);
+    } else {
+        EffectControlMessage msg;
+        init_param_request(session, &msg, key, value, valueSize);
+        result = call_effectd(session, &msg);
+    }
+    if (result == EFFECT_OK && session->control) {
+        record_param(session, key, value, valueSize, -1, false);
+    }
+    
+    unlock_control(session);
+    return result;
+#endif
+}
+
+EffectResult EffectClient_SetParamBlob(EffectHandle handle, uint32_t key, int fd) {
+    if (!handle || fd < 0) {
+        return EFFECT_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    EffectSession* session = (EffectSession*)handle;
+    
+    if (!session->isConnected) {
+        return EFFECT_ERROR_DEAD_OBJECT;
+    }
+    
+#if USE_FMQ
+    // TODO: Call HIDL setParamBlob() method
+    (void)key;
+    return EFFECT_OK;
+#else
+    lock_control(session);
+    EffectControlMessage msg;
+    init_blob_request(session, &msg, key, fd, false);
+    EffectResult result = call_effectd(session, &msg);
+    if (result == EFFECT_OK && session->control) {
+        record_param(session, key, NULL, 0, fd, false);
+    }
+    unlock_control(session);
+    return result;
+#endif
+}
+
+EffectResult EffectClient_SetParamFile(EffectHandle handle, uint32_t key, const char* path) {
+    if (!handle || !path || path[0] != '/') {
+        return EFFECT_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    EffectSession* session = (EffectSession*)handle;
+    
+    if (!session->isConnected) {
+        return EFFECT_ERROR_DEAD_OBJECT;
+    }
+    
+#if USE_FMQ
+    // TODO: Call HIDL setParamBlob() method
+    (void)key;
+    return EFFECT_OK;
+#else
+    // Opened with our permissions, not effectd's
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return EFFECT_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    lock_control(session);
+    EffectControlMessage msg;
+    init_blob_request(session, &msg, key, fd, true);
+    EffectResult result = call_effectd(session, &msg);
+    if (result == EFFECT_OK && session->control) {
+        record_param(session, key, NULL, 0, fd, true);
+    }
+    unlock_control(session);
+    close(fd);
+    return result;
+#endif
+}
+
+EffectResult EffectClient_Reset(EffectHandle handle) {
+    if (!handle) {
+        return EFFECT_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    EffectSession* session = (EffectSession*)handle;
+    
+    if (!session->isConnected) {
+        return EFFECT_ERROR_DEAD_OBJECT;
+    }
+    
+#if USE_FMQ
+    // TODO: Call HIDL reset() method
+    return EFFECT_OK;
+#else
+    lock_control(session);
+    EffectResult result = EFFECT_OK;
+    if (session->control) {
+        result = queue_command(session, EFFECT_COMMAND_RESET, 0, NULL, 0);
+    }
+    unlock_control(session);
+    return result;
+#endif
+}
+
+EffectResult EffectClient_SetBypass(EffectHandle handle, bool bypass) {
+    if (!handle) {
+        return EFFECT_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    EffectSession* session = (EffectSession*)handle;
+    
+    if (!session->isConnected) {
+        return EFFECT_ERROR_DEAD_OBJECT;
+    }
+    
+#if USE_FMQ
+    // TODO: Call HIDL setBypass() method
+    (void)bypass;
     return EFFECT_OK;
+#else
+    lock_control(session);
+    EffectResult result = EFFECT_OK;
+    if (session->control) {
+        result = queue_command(session, EFFECT_COMMAND_BYPASS, bypass ? 1 : 0, NULL, 0);
+    }
+    if (result == EFFECT_OK) {
+        session->bypassed = bypass;
+    }
+    unlock_control(session);
+    return result;
+#endif
+}
+
+static void snapshot_stats(EffectSession* session, EffectStats* stats, effect_histogram_t* hist) {
+    // Never blocks the processing thread; retries if it published mid-copy
+    unsigned int seq;
+    do {
+        seq = effect_seqlock_read_begin(&session->statsLock);
+        *stats = session->stats;
+        *hist = session->latencyHist;
+    } while (effect_seqlock_read_retry(&session->statsLock, seq));
+}
+
+static void fill_latency(EffectStats* stats, const effect_histogram_t* hist) {
+    stats->avgLatencyUs = effect_histogram_mean(hist);
+    stats->p50LatencyUs = effect_histogram_percentile(hist, 50.0);
+    stats->p95LatencyUs = effect_histogram_percentile(hist, 95.0);
+    stats->p99LatencyUs = effect_histogram_percentile(hist, 99.0);
+    stats->p999LatencyUs = effect_histogram_percentile(hist, 99.9);
+    stats->maxLatencyUs = hist->max;
 }
 
 EffectResult EffectClient_QueryStats(EffectHandle handle, EffectStats* stats) {
@@ -321,10 +1484,40 @@ EffectResult EffectClient_QueryStats(EffectHandle handle, EffectStats* stats) {
     }
     
     EffectSession* session = (EffectSession*)handle;
+    effect_histogram_t hist;
+    
+    snapshot_stats(session, stats, &hist);
+    fill_latency(stats, &hist);
+    
+    return EFFECT_OK;
+}
+
+EffectResult EffectClient_QueryIntervalStats(EffectHandle handle, EffectStats* stats) {
+    if (!handle || !stats) {
+        return EFFECT_ERROR_INVALID_ARGUMENTS;
+    }
     
-    pthread_mutex_lock(&session->statsMutex);
-    *stats = session->stats;
-    pthread_mutex_unlock(&session->statsMutex);
+    EffectSession* session = (EffectSession*)handle;
+    EffectStats now;
+    effect_histogram_t nowHist;
+    effect_histogram_t delta;
+    
+    snapshot_stats(session, &now, &nowHist);
+    
+    pthread_mutex_lock(&session->intervalMutex);
+    effect_histogram_subtract(&delta, &nowHist, &session->intervalHist);
+    *stats = now;
+    stats->processedFrames -= session->intervalStats.processedFrames;
+    stats->droppedFrames -= session->intervalStats.droppedFrames;
+    stats->timeoutCount -= session->intervalStats.timeoutCount;
+    stats->xrunCount -= session->intervalStats.xrunCount;
+    stats->breakerTripCount -= session->intervalStats.breakerTripCount;
+    stats->breakerRecoveryCount -= session->intervalStats.breakerRecoveryCount;
+    session->intervalStats = now;
+    session->intervalHist = nowHist;
+    pthread_mutex_unlock(&session->intervalMutex);
+    
+    fill_latency(stats, &delta);
     
     return EFFECT_OK;
 }
@@ -336,11 +1529,20 @@ EffectResult EffectClient_Stop(EffectHandle handle) {
     
     EffectSession* session = (EffectSession*)handle;
     
+    lock_control(session);
     session->isStarted = false;
     
+#if USE_FMQ
     // TODO: Call HIDL stop() method
-    
+    unlock_control(session);
     return EFFECT_OK;
+#else
+    EffectControlMessage msg;
+    init_request(&msg, EFFECT_CONTROL_OP_STOP, session->sessionId);
+    EffectResult result = call_effectd(session, &msg);
+    unlock_control(session);
+    return result;
+#endif
 }
 
 EffectResult EffectClient_Close(EffectHandle handle) {
@@ -350,7 +1552,20 @@ EffectResult EffectClient_Close(EffectHandle handle) {
     
     EffectSession* session = (EffectSession*)handle;
     
+#if USE_FMQ
     // TODO: Call HIDL close() method
+#else
+    // No reattach from here on; effectd lets go of the rings before we
+    // unmap them
+    if (session->control) {
+        remove_session(session);
+        EffectControlMessage msg;
+        init_request(&msg, EFFECT_CONTROL_OP_CLOSE, session->sessionId);
+        call_effectd(session, &msg);
+        effect_control_release(session->control);
+        session->control = NULL;
+    }
+#endif
     
     // Clean up
     if (session->eventFdIn >= 0) close(session->eventFdIn);
@@ -364,18 +1579,17 @@ EffectResult EffectClient_Close(EffectHandle handle) {
         effect_fmq_destroy(session->outputFmq);
     }
 #else
-    if (session->shmAddr) {
-        effect_shared_memory_unmap(session->shmAddr, session->shmSize);
-    }
-    
-    if (session->shmFd >= 0) {
-        close(session->shmFd);
-    }
+    unmap_session_memory(session);
 #endif
     
-    pthread_mutex_destroy(&session->statsMutex);
+    pthread_mutex_destroy(&session->intervalMutex);
+#if !USE_FMQ
+    free_params(session);
+    pthread_mutex_destroy(&session->commandLock);
+    pthread_mutex_destroy(&session->controlLock);
+#endif
     
-    free(session);
+    effect_arena_destroy(&session->arena);
     
     return EFFECT_OK;
 }
@@ -0,0 +1,65 @@
+#ifndef EFFECT_ARENA_H
+#define EFFECT_ARENA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Per-session memory arena
+ *
+ * One private anonymous mapping, sized once from the session's
+ * configuration, prefaulted with MAP_POPULATE and locked with mlock so the
+ * processing path never takes a page fault. Allocations are cache-line
+ * aligned bumps; nothing is freed individually, the whole arena goes at
+ * once.
+ *
+ * Locking is best effort: without CAP_IPC_LOCK and a large enough
+ * RLIMIT_MEMLOCK the pages are still prefaulted but may be reclaimed under
+ * memory pressure; locked reports which case applies.
+ */
+typedef struct {
+    uint8_t* base;
+    size_t size;      // Mapped size (whole pages)
+    size_t used;
+    bool locked;      // mlock succeeded
+} effect_arena_t;
+
+/**
+ * Bytes an allocation of size occupies in an arena (for sizing)
+ */
+size_t effect_arena_footprint(size_t size);
+
+/**
+ * Map, prefault and lock an arena
+ *
+ * @param arena Arena to initialize
+ * @param size Minimum usable size in bytes (sum of effect_arena_footprint)
+ * @return 0 on success, -1 if the mapping failed
+ */
+int effect_arena_create(effect_arena_t* arena, size_t size);
+
+/**
+ * Carve a zeroed, cache-line aligned block out of the arena
+ *
+ * @return Block, or NULL if the arena is exhausted
+ */
+void* effect_arena_alloc(effect_arena_t* arena, size_t size);
+
+/**
+ * Unmap the arena and everything allocated from it
+ *
+ * The arena descriptor may itself live inside the arena; it is copied
+ * before unmapping.
+ */
+void effect_arena_destroy(effect_arena_t* arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECT_ARENA_H
@@ -0,0 +1,44 @@
+#ifndef EFFECT_COMMAND_H
+#define EFFECT_COMMAND_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * In-band commands from the HAL to effectd
+ *
+ * Next to its audio rings, a session's shared memory holds a command ring:
+ * a quantum-mode ring whose quantum is one fixed-size EffectCommand. The
+ * client is its only producer; effectd's processing context drains it
+ * before each period and applies every command whose position the input
+ * has reached, so a command takes effect exactly at the first period the
+ * HAL submits after queueing it, with no control-plane round trip.
+ */
+
+#define EFFECT_COMMAND_SIZE 64
+#define EFFECT_COMMAND_MAX_VALUE_SIZE 40    // Larger values use the control plane
+#define EFFECT_COMMAND_RING_SLOTS 64        // Commands queued at most
+
+typedef enum {
+    EFFECT_COMMAND_SET_PARAM = 1,     // Plugin setParam(key, value)
+    EFFECT_COMMAND_RESET = 2,         // Plugin reset
+    EFFECT_COMMAND_BYPASS = 3,        // key 1: pass input through, 0: process again
+} EffectCommandType;
+
+typedef struct {
+    uint64_t position;                // Input ring write position when queued
+    uint32_t type;                    // EffectCommandType
+    uint32_t key;
+    uint32_t valueSize;
+    uint32_t reserved;
+    uint8_t value[EFFECT_COMMAND_MAX_VALUE_SIZE];
+} EffectCommand;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECT_COMMAND_H
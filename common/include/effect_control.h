@@ -0,0 +1,305 @@
+#ifndef EFFECT_CONTROL_H
+#define EFFECT_CONTROL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "effect_shared_memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Control plane over a Unix domain socket, for builds without HIDL
+ *
+ * Carries the IEffectService calls between the client library and effectd
+ * on a SOCK_SEQPACKET socket. Every packet holds one or more records, each
+ * a header followed by its payload (padded to 8 bytes); file descriptors
+ * (shared memory, eventfds) travel as one SCM_RIGHTS message per packet
+ * and are handed out to the records in order, as flagged by their fdMask.
+ *
+ * effectd handles a connection's records strictly in order and answers a
+ * packet with one packet carrying a reply per record, with the request's
+ * requestId. A client may therefore batch several calls into one packet
+ * (one round trip) and pipeline packets without waiting for replies; a
+ * record may refer to a pool registered by an earlier record of the same
+ * batch. Sessions and pools belong to the connection that created them and
+ * are released when it closes.
+ */
+
+#define EFFECT_CONTROL_DEFAULT_PATH "/run/effectd/effectd.sock"
+#define EFFECT_CONTROL_PATH_ENV "EFFECTD_SOCKET"   // Overrides the default path
+
+#define EFFECT_CONTROL_MAX_FDS 3            // Per record
+#define EFFECT_CONTROL_MAX_BATCH 32         // Records per packet
+#define EFFECT_CONTROL_MAX_PARAM_SIZE 1024  // Largest setParam value
+
+// Client's wait for a reply. effectd gives up on a stuck library call well
+// before, so this only runs out if effectd itself is hung.
+#define EFFECT_CONTROL_CALL_TIMEOUT_MS 5000
+
+/**
+ * Operations, one per IEffectService call
+ */
+typedef enum {
+    EFFECT_CONTROL_OP_OPEN = 1,
+    EFFECT_CONTROL_OP_REGISTER_POOL = 2,
+    EFFECT_CONTROL_OP_START = 3,
+    EFFECT_CONTROL_OP_STOP = 4,
+    EFFECT_CONTROL_OP_CLOSE = 5,
+    EFFECT_CONTROL_OP_SET_PARAM = 6,
+    EFFECT_CONTROL_OP_QUERY_STATE = 7,
+    EFFECT_CONTROL_OP_QUERY_STATS = 8,
+    EFFECT_CONTROL_OP_QUERY_INTERVAL_STATS = 9,
+    EFFECT_CONTROL_OP_SET_PARAM_BLOB = 10,
+    EFFECT_CONTROL_OP_CONNECT = 11,
+    EFFECT_CONTROL_OP_ADOPT = 12,
+} EffectControlOp;
+
+/**
+ * Reply results; same values as Result in hidl/1.0/types.hal and the
+ * client's EffectResult
+ */
+typedef enum {
+    EFFECT_CONTROL_OK = 0,
+    EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS = -1,
+    EFFECT_CONTROL_ERROR_NO_MEMORY = -2,
+    EFFECT_CONTROL_ERROR_INVALID_STATE = -3,
+    EFFECT_CONTROL_ERROR_NOT_SUPPORTED = -4,
+    EFFECT_CONTROL_ERROR_TIMEOUT = -5,
+    EFFECT_CONTROL_ERROR_DEAD_OBJECT = -6,
+} EffectControlResult;
+
+// fdMask bits of an OPEN request
+#define EFFECT_CONTROL_FD_SHM 0x1u          // Private shared memory (poolId == 0)
+#define EFFECT_CONTROL_FD_EVENT_IN 0x2u     // HAL -> effectd eventfd
+#define EFFECT_CONTROL_FD_EVENT_OUT 0x4u    // effectd -> HAL eventfd
+
+// fdMask bit of a SET_PARAM_BLOB request
+#define EFFECT_CONTROL_FD_BLOB 0x1u         // Sealed memfd holding the value
+
+// fdMask bit of a CONNECT reply or an ADOPT request
+#define EFFECT_CONTROL_FD_CONNECTION 0x1u   // Connected control socket
+
+/*
+ * CONNECT (header.id: effect type) asks effectd for a connection to the
+ * process hosting that type's library, on which the client then opens its
+ * sessions of that type; the reply carries it in fds[0]. effectd answers
+ * NOT_SUPPORTED when it runs every library itself, and sessions are opened
+ * on the connection the request came on.
+ *
+ * ADOPT is internal to effectd: it hands a library host (or the zygote that
+ * forks hosts, with header.id the library's effect type) a connection to
+ * serve in fds[0].
+ */
+
+/**
+ * Record header
+ */
+typedef struct {
+    uint32_t requestId;       // Echoed in the reply
+    uint16_t op;              // EffectControlOp
+    uint16_t fdMask;          // Which of fds[] are attached
+    uint32_t id;              // Session ID, or pool ID for REGISTER_POOL
+    int32_t result;           // EffectControlResult (replies only)
+    uint32_t payloadSize;     // Bytes of body used
+    uint32_t reserved;
+} EffectControlHeader;
+
+/**
+ * OPEN request; the reply carries the new session ID in header.id
+ */
+typedef struct {
+    uint32_t effectType;
+    uint32_t sampleRate;
+    uint32_t channels;
+    uint32_t format;
+    uint32_t framesPerBuffer;
+    uint32_t wakeupType;
+    uint32_t poolId;                  // Registered pool, 0 for a private region
+    uint32_t reserved;
+    EffectSharedMemoryLayout layout;  // Offsets relative to the pool or region
+} EffectControlOpenArgs;
+
+/**
+ * REGISTER_POOL request; header.id is the pool ID chosen by the client
+ * (non-zero, unique on the connection) and fds[0] the pool's memfd
+ */
+typedef struct {
+    uint64_t size;
+} EffectControlPoolArgs;
+
+typedef struct {
+    uint32_t key;
+    uint32_t valueSize;
+    uint8_t value[EFFECT_CONTROL_MAX_PARAM_SIZE];
+} EffectControlParamArgs;
+
+/**
+ * SET_PARAM_BLOB request: the value is the content of fds[0], a sealed
+ * memfd, or with EFFECT_CONTROL_BLOB_FILE a regular file the client opened,
+ * which effectd copies into sealed memory of its own
+ */
+typedef struct {
+    uint32_t key;
+    uint32_t flags;                   // EFFECT_CONTROL_BLOB_* bits
+} EffectControlBlobArgs;
+
+#define EFFECT_CONTROL_BLOB_FILE 0x1u
+
+/**
+ * QUERY_STATS / QUERY_INTERVAL_STATS reply; mirrors SessionStats in
+ * hidl/1.0/types.hal
+ */
+typedef struct {
+    uint64_t processedFrames;
+    uint64_t droppedFrames;
+    uint32_t avgLatencyUs;
+    uint32_t p95LatencyUs;
+    uint32_t maxLatencyUs;
+    uint32_t timeoutCount;
+    uint32_t xrunCount;
+    uint32_t p50LatencyUs;
+    uint32_t p99LatencyUs;
+    uint32_t p999LatencyUs;
+    uint32_t deadlineMissCount;
+    uint32_t hungCallCount;
+} EffectControlStats;
+
+/**
+ * One request or reply, unpacked
+ *
+ * Only header.payloadSize bytes of body go on the wire. Received fds that
+ * are not in fdMask are -1; the receiver owns the others.
+ */
+typedef struct {
+    EffectControlHeader header;
+    int fds[EFFECT_CONTROL_MAX_FDS];
+    union {
+        EffectControlOpenArgs open;
+        EffectControlPoolArgs pool;
+        EffectControlParamArgs param;
+        EffectControlBlobArgs blob;
+        EffectControlStats stats;
+        uint32_t state;               // QUERY_STATE reply: SessionState
+    } body;
+} EffectControlMessage;
+
+/**
+ * Send messages as one packet
+ *
+ * The fds in each message's fdMask are duplicated into the packet; the
+ * caller keeps its own.
+ *
+ * @return 0 on success, -1 on error
+ */
+int effect_control_send_packet(int sock, const EffectControlMessage* msgs, uint32_t count);
+
+/**
+ * Receive one packet
+ *
+ * Blocks until a packet arrives. A malformed packet is an error; any fds
+ * it carried are closed.
+ *
+ * @param msgs Room for EFFECT_CONTROL_MAX_BATCH messages
+ * @return Number of messages, 0 when the peer closed, -1 on error
+ */
+int effect_control_recv_packet(int sock, EffectControlMessage* msgs);
+
+/**
+ * Close the fds a received message owns
+ */
+void effect_control_close_fds(EffectControlMessage* msg);
+
+/**
+ * Client end of a connection to effectd
+ *
+ * Safe to use from several threads at once. Requests may be submitted
+ * without waiting (effect_control_submit) and their replies collected
+ * later, in any order, with effect_control_wait.
+ */
+typedef struct EffectControlChannel EffectControlChannel;
+
+/**
+ * Connect to effectd
+ *
+ * @param path Socket path, NULL for $EFFECTD_SOCKET or the default
+ * @return Channel with one reference, or NULL if effectd is not listening
+ */
+EffectControlChannel* effect_control_connect(const char* path);
+
+/**
+ * Wrap a connected socket (e.g. one received in a CONNECT reply)
+ *
+ * @param sock SOCK_SEQPACKET socket, owned by the channel on success
+ * @return Channel with one reference, or NULL on failure
+ */
+EffectControlChannel* effect_control_adopt(int sock);
+
+/**
+ * Take another reference
+ */
+void effect_control_acquire(EffectControlChannel* channel);
+
+/**
+ * Drop a reference; the last one closes the connection
+ */
+void effect_control_release(EffectControlChannel* channel);
+
+/**
+ * Whether the connection has failed or effectd has closed it
+ */
+bool effect_control_is_broken(EffectControlChannel* channel);
+
+/**
+ * Block until one of the connections breaks: effectd closed it (it exited
+ * or crashed) or a call on it failed
+ *
+ * @param timeoutMs Longest wait, -1 for no limit
+ * @return Index of a channel that is now broken, or -1 on timeout
+ */
+int effect_control_wait_broken(EffectControlChannel* const* channels, uint32_t count,
+                               int timeoutMs);
+
+/**
+ * Send requests as one batch without waiting for the replies
+ *
+ * Assigns each message's header.requestId; pass those to
+ * effect_control_wait.
+ *
+ * @param count 1 to EFFECT_CONTROL_MAX_BATCH
+ * @return 0 on success, -1 if the channel is broken
+ */
+int effect_control_submit(EffectControlChannel* channel, EffectControlMessage* msgs,
+                          uint32_t count);
+
+/**
+ * Wait for the reply to a submitted request
+ *
+ * Replies to other requests that arrive first are kept for their waiters.
+ * A reply that does not come in time breaks the channel: the peer is taken
+ * to be hung, and a late reply could not be told from the next one.
+ *
+ * @param reply Output: the reply, whose fds (if any) the caller owns
+ * @param timeoutMs Longest wait, -1 for no limit
+ * @return 0 on success, -1 if the channel broke first or the wait timed out
+ */
+int effect_control_wait(EffectControlChannel* channel, uint32_t requestId,
+                        EffectControlMessage* reply, int timeoutMs);
+
+/**
+ * Submit one request and wait for its reply, which overwrites msg
+ *
+ * @param timeoutMs Longest wait for the reply, -1 for no limit
+ * @return Reply result, EFFECT_CONTROL_ERROR_DEAD_OBJECT if the channel
+ *         is broken, or EFFECT_CONTROL_ERROR_TIMEOUT if the reply did not
+ *         come in time (which breaks the channel)
+ */
+int32_t effect_control_call(EffectControlChannel* channel, EffectControlMessage* msg,
+                            int timeoutMs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECT_CONTROL_H
@@ -36,6 +36,17 @@ typedef struct {
     uint64_t writePtr;
 } EffectFmqDescriptor;
 
+/**
+ * Up to two contiguous spans inside the queue memory, handed out by the
+ * zero-copy acquire calls. second is NULL when the span does not wrap.
+ */
+typedef struct {
+    void* first;
+    size_t firstSize;
+    void* second;
+    size_t secondSize;
+} EffectFmqRegion;
+
 /**
  * Create a new FMQ (producer/writer side)
  * 
@@ -107,6 +118,48 @@ size_t effect_fmq_read(EffectFmqHandle handle, void* data, size_t count);
 ssize_t effect_fmq_read_blocking(EffectFmqHandle handle, void* data, 
                                   size_t count, int timeoutMs);
 
+/**
+ * Reserve queue space for writing in place (non-blocking, zero-copy)
+ * 
+ * All-or-nothing: either count bytes are reserved or none are.
+ * 
+ * @param handle FMQ handle
+ * @param count Number of bytes to reserve
+ * @param region Output spans inside the queue
+ * @return 0 on success, -1 if not enough space
+ */
+int effect_fmq_acquire_write(EffectFmqHandle handle, size_t count, EffectFmqRegion* region);
+
+/**
+ * Publish bytes written into a region from effect_fmq_acquire_write
+ * 
+ * @param handle FMQ handle
+ * @param count Number of bytes to publish (must equal the reserved count)
+ * @return 0 on success, -1 on error
+ */
+int effect_fmq_commit_write(EffectFmqHandle handle, size_t count);
+
+/**
+ * Access queued data in place (non-blocking, zero-copy)
+ * 
+ * All-or-nothing: either count bytes are available or none are.
+ * 
+ * @param handle FMQ handle
+ * @param count Number of bytes to access
+ * @param region Output spans inside the queue
+ * @return 0 on success, -1 if not enough data
+ */
+int effect_fmq_acquire_read(EffectFmqHandle handle, size_t count, EffectFmqRegion* region);
+
+/**
+ * Release bytes obtained from effect_fmq_acquire_read back to the writer
+ * 
+ * @param handle FMQ handle
+ * @param count Number of bytes consumed (must equal the acquired count)
+ * @return 0 on success, -1 on error
+ */
+int effect_fmq_release_read(EffectFmqHandle handle, size_t count);
+
 /**
  * Get available space for writing
  * 
@@ -0,0 +1,79 @@
+#ifndef EFFECT_HISTOGRAM_H
+#define EFFECT_HISTOGRAM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Log-bucketed latency histogram
+ *
+ * Values below 2^SUB_BUCKET_BITS get one bucket each; above that every
+ * power of two is split into 2^SUB_BUCKET_BITS equal buckets, so a bucket
+ * is never wider than 1/16 (6.25%) of the values it holds. Values up to
+ * EFFECT_HISTOGRAM_MAX_VALUE are tracked; larger ones land in the last
+ * bucket. Fixed size, no allocation, O(1) record.
+ *
+ * Counts are 32-bit and wrap; effect_histogram_subtract is wrap-safe, so
+ * interval queries stay exact as long as fewer than 2^32 values are
+ * recorded between two reads.
+ */
+#define EFFECT_HISTOGRAM_SUB_BUCKET_BITS 4
+#define EFFECT_HISTOGRAM_SUB_BUCKETS (1u << EFFECT_HISTOGRAM_SUB_BUCKET_BITS)
+#define EFFECT_HISTOGRAM_MAX_BITS 26
+#define EFFECT_HISTOGRAM_MAX_VALUE ((1u << EFFECT_HISTOGRAM_MAX_BITS) - 1)
+#define EFFECT_HISTOGRAM_BUCKETS \
+    (EFFECT_HISTOGRAM_SUB_BUCKETS * \
+     (EFFECT_HISTOGRAM_MAX_BITS - EFFECT_HISTOGRAM_SUB_BUCKET_BITS + 1))
+
+typedef struct {
+    uint32_t counts[EFFECT_HISTOGRAM_BUCKETS];
+    uint64_t count;     // Values recorded
+    uint64_t sum;       // Sum of values recorded
+    uint32_t max;       // Largest value recorded (bucket bound for deltas)
+} effect_histogram_t;
+
+/**
+ * Clear all buckets
+ */
+void effect_histogram_reset(effect_histogram_t* hist);
+
+/**
+ * Record one value (real-time safe)
+ */
+void effect_histogram_record(effect_histogram_t* hist, uint32_t value);
+
+/**
+ * Compute the values recorded between two snapshots of one histogram
+ *
+ * The max of a delta is the upper bound of its highest non-empty bucket,
+ * capped by the newer snapshot's max.
+ *
+ * @param delta Output, may alias neither input
+ * @param newer Later snapshot
+ * @param older Earlier snapshot
+ */
+void effect_histogram_subtract(effect_histogram_t* delta, const effect_histogram_t* newer,
+                               const effect_histogram_t* older);
+
+/**
+ * Value at a percentile
+ *
+ * @param percentile 0-100, e.g. 99.9
+ * @return Upper bound of the bucket holding that rank (capped by max),
+ *         0 for an empty histogram
+ */
+uint32_t effect_histogram_percentile(const effect_histogram_t* hist, double percentile);
+
+/**
+ * Mean of the recorded values, 0 for an empty histogram
+ */
+uint32_t effect_histogram_mean(const effect_histogram_t* hist);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECT_HISTOGRAM_H
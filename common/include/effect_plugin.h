@@ -0,0 +1,140 @@
+#ifndef EFFECT_PLUGIN_H
+#define EFFECT_PLUGIN_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Effect plugin ABI
+ *
+ * A plugin is a shared library exporting the EFFECT_PLUGIN_SYM_* entry
+ * points below with C linkage. effectd resolves all of them once when a
+ * session is opened and never calls dlsym on the processing path.
+ *
+ * Versioning: the major version changes on any incompatible change, the
+ * minor version on additions. effectd loads plugins with the same major
+ * version and a minor version no newer than its own.
+ *
+ * Minor version 1 adds the optional setParamBlob entry point.
+ *
+ * Threading: create, setParam, setParamBlob, getLatency and destroy are
+ * called from control threads; process and reset from the session's
+ * processing context. effectd never calls two entry points on the same
+ * context at once, except setParam and setParamBlob, which may race with
+ * process and must be made safe by the plugin. Small parameters queued
+ * in-band are applied with setParam from the processing context, between
+ * two process calls.
+ */
+
+#define EFFECT_PLUGIN_ABI_VERSION_MAJOR 1
+#define EFFECT_PLUGIN_ABI_VERSION_MINOR 1
+#define EFFECT_PLUGIN_ABI_VERSION \
+    ((EFFECT_PLUGIN_ABI_VERSION_MAJOR << 16) | EFFECT_PLUGIN_ABI_VERSION_MINOR)
+
+#define EFFECT_PLUGIN_SYM_GET_ABI_VERSION "effect_plugin_get_abi_version"
+#define EFFECT_PLUGIN_SYM_CREATE          "effect_plugin_create"
+#define EFFECT_PLUGIN_SYM_PROCESS         "effect_plugin_process"
+#define EFFECT_PLUGIN_SYM_SET_PARAM       "effect_plugin_set_param"
+#define EFFECT_PLUGIN_SYM_SET_PARAM_BLOB  "effect_plugin_set_param_blob"   // Optional
+#define EFFECT_PLUGIN_SYM_RESET           "effect_plugin_reset"
+#define EFFECT_PLUGIN_SYM_GET_LATENCY     "effect_plugin_get_latency"
+#define EFFECT_PLUGIN_SYM_DESTROY         "effect_plugin_destroy"
+
+#define EFFECT_PLUGIN_EXPORT __attribute__((visibility("default")))
+
+/**
+ * Sample buffer layout
+ */
+typedef enum {
+    EFFECT_PLUGIN_LAYOUT_INTERLEAVED = 0,  // planes[0] holds frames * channels samples
+    EFFECT_PLUGIN_LAYOUT_PLANAR = 1,       // planes[c] holds frames samples of channel c
+} EffectPluginLayout;
+
+/**
+ * Stream configuration passed to create
+ */
+typedef struct {
+    uint32_t sampleRate;
+    uint32_t channels;
+    uint32_t format;           // Bits per sample: 16 = int16, 32 = float
+    uint32_t framesPerBuffer;  // Every process call carries exactly this many frames
+    uint32_t layout;           // EffectPluginLayout the host will use
+} EffectPluginConfig;
+
+/**
+ * One period of audio
+ */
+typedef struct {
+    void* const* planes;       // 1 pointer (interleaved) or channels pointers (planar)
+    uint32_t frames;
+} EffectPluginBuffer;
+
+/**
+ * Entry points, as resolved by the host
+ */
+typedef struct {
+    /**
+     * @return EFFECT_PLUGIN_ABI_VERSION the plugin was built against
+     */
+    uint32_t (*getAbiVersion)(void);
+    
+    /**
+     * Create a processing context
+     *
+     * @param config Stream configuration
+     * @param context Output context handle
+     * @return 0 on success, negative if the configuration (including the
+     *         layout) is not supported
+     */
+    int (*create)(const EffectPluginConfig* config, void** context);
+    
+    /**
+     * Process one period; input and output never alias
+     *
+     * @return 0 on success, negative on error (the host passes audio through)
+     */
+    int (*process)(void* context, const EffectPluginBuffer* input, EffectPluginBuffer* output);
+    
+    /**
+     * Set an algorithm parameter
+     *
+     * @return 0 on success, negative on error
+     */
+    int (*setParam)(void* context, uint32_t key, const void* value, uint32_t valueSize);
+    
+    /**
+     * Set a large read-only parameter (a model, a table) in place
+     *
+     * Optional, NULL if the plugin does not export it; the host then passes
+     * the value to setParam. data may be shared with other sessions and
+     * stays mapped until the context is destroyed or key is set again, so
+     * the plugin may use it without copying but must never write to it.
+     *
+     * @return 0 on success, negative on error
+     */
+    int (*setParamBlob)(void* context, uint32_t key, const void* data, uint64_t size);
+    
+    /**
+     * Drop all internal state (delay lines, envelopes) as if newly created
+     */
+    void (*reset)(void* context);
+    
+    /**
+     * @return Algorithmic latency in frames
+     */
+    uint32_t (*getLatency)(void* context);
+    
+    /**
+     * Destroy a context created by create
+     */
+    void (*destroy)(void* context);
+} EffectPluginApi;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECT_PLUGIN_H
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -11,24 +12,90 @@ extern "C" {
 typedef struct {
     uint64_t val;
 } effect_atomic_u64_t;
+typedef struct {
+    uint32_t val;
+} effect_atomic_u32_t;
 #else
 #include <stdatomic.h>
 typedef atomic_uint_fast64_t effect_atomic_u64_t;
+typedef atomic_uint effect_atomic_u32_t;
 #endif
 
+#define EFFECT_RINGBUFFER_MAGIC   0x52464645u  // "EFFR"
+#define EFFECT_RINGBUFFER_VERSION 1u
+#define EFFECT_CACHE_LINE_SIZE    64
+
 /**
- * Lock-free ring buffer for PCM data transfer
- * Uses atomic operations for thread-safe single-producer single-consumer
+ * Ring buffer header
+ *
+ * For cross-process rings this header lives at the start of the shared
+ * mapping and the data bytes follow it, so both processes see the same
+ * indices. The producer and consumer each own one cache line: the owner
+ * is the only writer of that line, and keeps a cached copy of the other
+ * side's index there so it only touches the remote line when the cached
+ * value says the ring looks full (producer) or empty (consumer).
+ * A fourth line carries the futex doorbell used by effect_wakeup.
  */
 typedef struct {
+    // Layout descriptor, written once by the creator
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t capacity;
+    uint32_t quantum;                 // Bytes per period, 0 for byte mode
+    uint8_t reserved0[EFFECT_CACHE_LINE_SIZE - 5 * sizeof(uint32_t)];
+
+    // Producer cache line
     effect_atomic_u64_t write_index;  // Write position (producer)
+    uint64_t cached_read_index;       // Producer's last seen read position
+    uint8_t reserved1[EFFECT_CACHE_LINE_SIZE - 2 * sizeof(uint64_t)];
+
+    // Consumer cache line
     effect_atomic_u64_t read_index;   // Read position (consumer)
-    uint32_t capacity;                // Buffer capacity in bytes
-    uint8_t* data;                    // Data buffer
+    uint64_t cached_write_index;      // Consumer's last seen write position
+    uint8_t reserved2[EFFECT_CACHE_LINE_SIZE - 2 * sizeof(uint64_t)];
+
+    // Doorbell cache line (producer rings, consumer sleeps)
+    effect_atomic_u32_t doorbell;     // Futex word, bumped on every signal
+    effect_atomic_u32_t waiters;      // Consumers currently asleep on doorbell
+    uint8_t reserved3[EFFECT_CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+} effect_ringbuffer_header_t;
+
+/**
+ * Lock-free ring buffer for PCM data transfer
+ * Uses atomic operations for thread-safe single-producer single-consumer
+ *
+ * This is a process-local view onto a ring. The header either points into
+ * a shared mapping (effect_ringbuffer_create_shared / _attach) or at the
+ * embedded localHeader for in-process rings (effect_ringbuffer_init).
+ *
+ * In quantum mode (quantum != 0) the ring only ever moves whole periods of
+ * quantum bytes: writes, reads and acquires either transfer every requested
+ * byte or nothing. Quantum rings require a power-of-two capacity so
+ * positions are computed with a mask instead of a modulo.
+ */
+typedef struct {
+    effect_ringbuffer_header_t* header;   // Indices (shared or local)
+    uint8_t* data;                        // Data buffer
+    uint32_t capacity;                    // Buffer capacity in bytes
+    uint32_t mask;                        // capacity - 1 for power-of-two capacities, else 0
+    uint32_t quantum;                     // Bytes per period, 0 for byte mode
+    effect_ringbuffer_header_t localHeader;
 } effect_ringbuffer_t;
 
 /**
- * Initialize ring buffer
+ * Up to two contiguous spans inside the ring data, handed out by the
+ * acquire calls. second is NULL when the span does not wrap.
+ */
+typedef struct {
+    uint8_t* first;
+    uint32_t firstSize;
+    uint8_t* second;
+    uint32_t secondSize;
+} effect_ringbuffer_region_t;
+
+/**
+ * Initialize an in-process ring buffer
  * 
  * @param rb Ring buffer structure
  * @param data Data buffer (must be allocated by caller)
@@ -36,6 +103,57 @@ typedef struct {
  */
 void effect_ringbuffer_init(effect_ringbuffer_t* rb, void* data, uint32_t capacity);
 
+/**
+ * Initialize an in-process ring buffer in frame-quantum mode
+ * 
+ * @param rb Ring buffer structure
+ * @param data Data buffer (must be allocated by caller)
+ * @param capacity Capacity in bytes (must be a power of 2)
+ * @param quantum Bytes per period (e.g. bytesPerFrame * framesPerBuffer)
+ * @return 0 on success, -1 if capacity is not a power of 2 or cannot hold
+ *         one period
+ */
+int effect_ringbuffer_init_quantum(effect_ringbuffer_t* rb, void* data,
+                                   uint32_t capacity, uint32_t quantum);
+
+/**
+ * Get the number of bytes a shared ring of the given capacity occupies
+ * (header plus data), rounded up to a whole cache line
+ * 
+ * @param capacity Data capacity in bytes
+ * @return Size in bytes of the shared ring region
+ */
+size_t effect_ringbuffer_shared_size(uint32_t capacity);
+
+/**
+ * Create a ring buffer inside shared memory (creator side)
+ * 
+ * Writes a versioned header at the start of mem and places the data bytes
+ * right after it. mem must be cache-line aligned and at least
+ * effect_ringbuffer_shared_size(capacity) bytes long.
+ * 
+ * @param rb Ring buffer view to initialize
+ * @param mem Start of the ring region inside the shared mapping
+ * @param capacity Data capacity in bytes (power of 2 when quantum != 0)
+ * @param quantum Bytes per period for frame-quantum mode, 0 for byte mode
+ * @return 0 on success, -1 on error
+ */
+int effect_ringbuffer_create_shared(effect_ringbuffer_t* rb, void* mem,
+                                    uint32_t capacity, uint32_t quantum);
+
+/**
+ * Attach to a ring buffer created by another process
+ * 
+ * Validates the header magic, version, header size and that the ring fits
+ * inside the region before binding the view to it.
+ * 
+ * @param rb Ring buffer view to initialize
+ * @param mem Start of the ring region inside the shared mapping
+ * @param size Size of the ring region in bytes
+ * @return 0 on success, -1 if the header is invalid
+ */
+int effect_ringbuffer_attach(effect_ringbuffer_t* rb, void* mem, size_t size);
+
 /**
  * Get available bytes for reading
  * 
@@ -52,13 +170,47 @@ uint32_t effect_ringbuffer_get_read_available(const effect_ringbuffer_t* rb);
  */
 uint32_t effect_ringbuffer_get_write_available(const effect_ringbuffer_t* rb);
 
+/**
+ * Get the number of whole periods queued for reading (quantum mode)
+ * 
+ * @param rb Ring buffer
+ * @return Number of periods available, 0 in byte mode
+ */
+uint32_t effect_ringbuffer_get_read_periods(const effect_ringbuffer_t* rb);
+
+/**
+ * Get the number of whole periods that can be written (quantum mode)
+ * 
+ * @param rb Ring buffer
+ * @return Number of free periods, 0 in byte mode
+ */
+uint32_t effect_ringbuffer_get_write_periods(const effect_ringbuffer_t* rb);
+
+/**
+ * Get the total number of bytes ever written (producer position)
+ * 
+ * Positions never wrap in practice, so they name a point in the stream.
+ * 
+ * @param rb Ring buffer
+ * @return Write position in bytes
+ */
+uint64_t effect_ringbuffer_get_write_position(const effect_ringbuffer_t* rb);
+
+/**
+ * Get the total number of bytes ever consumed (consumer position)
+ * 
+ * @param rb Ring buffer
+ * @return Read position in bytes
+ */
+uint64_t effect_ringbuffer_get_read_position(const effect_ringbuffer_t* rb);
+
 /**
  * Write data to ring buffer (non-blocking)
  * 
  * @param rb Ring buffer
  * @param data Source data
  * @param size Number of bytes to write
- * @return Number of bytes actually written
+ * @return Number of bytes actually written (0 or size in quantum mode)
  */
 uint32_t effect_ringbuffer_write(effect_ringbuffer_t* rb, const void* data, uint32_t size);
 
@@ -68,10 +220,58 @@ uint32_t effect_ringbuffer_write(effect_ringbuffer_t* rb, const void* data, uint
  * @param rb Ring buffer
  * @param data Destination buffer
  * @param size Number of bytes to read
- * @return Number of bytes actually read
+ * @return Number of bytes actually read (0 or size in quantum mode)
  */
 uint32_t effect_ringbuffer_read(effect_ringbuffer_t* rb, void* data, uint32_t size);
 
+/**
+ * Reserve space for writing in place (non-blocking, zero-copy)
+ * 
+ * Hands out up to size bytes of free ring space as one or two spans. The
+ * producer fills them directly and publishes with
+ * effect_ringbuffer_commit_write. Nothing is visible to the consumer until
+ * the commit.
+ * 
+ * @param rb Ring buffer
+ * @param size Number of bytes wanted
+ * @param region Output spans
+ * @return Number of bytes reserved (may be less than size; 0 or size in
+ *         quantum mode)
+ */
+uint32_t effect_ringbuffer_acquire_write(effect_ringbuffer_t* rb, uint32_t size,
+                                         effect_ringbuffer_region_t* region);
+
+/**
+ * Publish bytes written into a region from effect_ringbuffer_acquire_write
+ * 
+ * @param rb Ring buffer
+ * @param size Number of bytes to publish (at most the reserved size)
+ */
+void effect_ringbuffer_commit_write(effect_ringbuffer_t* rb, uint32_t size);
+
+/**
+ * Access readable data in place (non-blocking, zero-copy)
+ * 
+ * Hands out up to size bytes of queued data as one or two spans. The data
+ * stays owned by the ring until effect_ringbuffer_release_read.
+ * 
+ * @param rb Ring buffer
+ * @param size Number of bytes wanted
+ * @param region Output spans
+ * @return Number of bytes available in the spans (may be less than size;
+ *         0 or size in quantum mode)
+ */
+uint32_t effect_ringbuffer_acquire_read(effect_ringbuffer_t* rb, uint32_t size,
+                                        effect_ringbuffer_region_t* region);
+
+/**
+ * Return bytes obtained from effect_ringbuffer_acquire_read to the producer
+ * 
+ * @param rb Ring buffer
+ * @param size Number of bytes consumed (at most the acquired size)
+ */
+void effect_ringbuffer_release_read(effect_ringbuffer_t* rb, uint32_t size);
+
 /**
  * Reset ring buffer (clear all data)
  * NOTE: Only safe to call when no concurrent operations
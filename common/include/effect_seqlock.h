@@ -0,0 +1,70 @@
+#ifndef EFFECT_SEQLOCK_H
+#define EFFECT_SEQLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/**
+ * Sequence lock for single-writer statistics
+ *
+ * The writer never blocks and never waits for readers: it bumps the
+ * sequence to odd, updates the protected data and bumps it back to even.
+ * Readers copy the data and retry if the sequence was odd or moved while
+ * they copied, so every snapshot they return is one the writer published.
+ *
+ * Only one thread may write at a time; handing the writer role to another
+ * thread must go through a synchronizing operation (e.g. a mutex or an
+ * atomic handoff), as the session worker pool does.
+ */
+typedef struct {
+    atomic_uint seq;
+} effect_seqlock_t;
+
+static inline void effect_seqlock_init(effect_seqlock_t* lock) {
+    atomic_init(&lock->seq, 0);
+}
+
+/**
+ * Start an update (writer only, real-time safe)
+ */
+static inline void effect_seqlock_write_begin(effect_seqlock_t* lock) {
+    unsigned int seq = atomic_load_explicit(&lock->seq, memory_order_relaxed);
+    atomic_store_explicit(&lock->seq, seq + 1, memory_order_relaxed);
+    // Order the odd sequence before the data stores
+    atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * Publish an update (writer only, real-time safe)
+ */
+static inline void effect_seqlock_write_end(effect_seqlock_t* lock) {
+    unsigned int seq = atomic_load_explicit(&lock->seq, memory_order_relaxed);
+    atomic_store_explicit(&lock->seq, seq + 1, memory_order_release);
+}
+
+/**
+ * Start a read; spins while an update is in progress
+ *
+ * @return Sequence to pass to effect_seqlock_read_retry
+ */
+static inline unsigned int effect_seqlock_read_begin(const effect_seqlock_t* lock) {
+    unsigned int seq;
+    while ((seq = atomic_load_explicit((atomic_uint*)&lock->seq, memory_order_acquire)) & 1u) {
+        // Writer is mid-update; it never sleeps while holding the sequence odd
+    }
+    return seq;
+}
+
+/**
+ * Check whether the data copied since read_begin may be torn
+ *
+ * @return true if the copy must be repeated
+ */
+static inline bool effect_seqlock_read_retry(const effect_seqlock_t* lock, unsigned int seq) {
+    // Order the data loads before the re-check
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit((atomic_uint*)&lock->seq, memory_order_relaxed) != seq;
+}
+
+#endif // EFFECT_SEQLOCK_H
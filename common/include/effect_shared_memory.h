@@ -2,29 +2,92 @@
 #define EFFECT_SHARED_MEMORY_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <sys/types.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Placement of a session's input, output and command rings inside one
+ * shared memory region. Mirrors SharedMemoryInfo in hidl/1.0/types.hal;
+ * each ring region holds the ring header followed by its data bytes.
+ */
+typedef struct {
+    uint64_t size;                    // Total size of shared memory
+    uint32_t inputRingBufferOffset;   // Offset of input ring region
+    uint32_t inputRingBufferSize;     // Size of input ring region
+    uint32_t outputRingBufferOffset;  // Offset of output ring region
+    uint32_t outputRingBufferSize;    // Size of output ring region
+    uint32_t commandRingBufferOffset; // Offset of command ring region
+    uint32_t commandRingBufferSize;   // Size of command ring region, 0 for none
+} EffectSharedMemoryLayout;
+
+/**
+ * Shared memory creation flags
+ *
+ * EFFECT_SHM_FLAG_HUGE_PAGES backs the region with huge pages to cut TLB
+ * misses on large rings: hugetlbfs pages (MFD_HUGETLB) if the system has
+ * some reserved, otherwise transparent huge pages (MADV_HUGEPAGE, needs
+ * shmem_enabled set to advise or always), otherwise normal pages. The size
+ * must be a multiple of effect_shared_memory_huge_page_size().
+ */
+#define EFFECT_SHM_FLAG_HUGE_PAGES 0x1u
+
+/**
+ * Default huge page size of the system (2 MB if it cannot be determined)
+ */
+size_t effect_shared_memory_huge_page_size(void);
+
 /**
  * Create shared memory using memfd_create (preferred) or ashmem (fallback)
  * 
  * @param name Name for the shared memory region
  * @param size Size in bytes
+ * @param flags EFFECT_SHM_FLAG_* bits, 0 for normal pages
+ * @return File descriptor on success, -1 on error
+ */
+int effect_shared_memory_create(const char* name, size_t size, uint32_t flags);
+
+/**
+ * Create a memfd holding a copy of data, sealed so that nobody (including
+ * us) can change it any more
+ * 
+ * Suitable for EffectClient_SetParamBlob.
+ * 
  * @return File descriptor on success, -1 on error
  */
-int effect_shared_memory_create(const char* name, size_t size);
+int effect_shared_memory_create_sealed(const char* name, const void* data, size_t size);
+
+/**
+ * Create a sealed memfd holding a copy of the first size bytes of srcFd
+ * 
+ * Reads with pread(), so srcFd's file offset is left alone.
+ * 
+ * @return File descriptor on success, -1 on error, including srcFd ending
+ *         before size bytes
+ */
+int effect_shared_memory_copy_sealed(const char* name, int srcFd, size_t size);
 
 /**
  * Map shared memory to process address space
  * 
+ * The mapping is prefaulted and, where RLIMIT_MEMLOCK allows, locked. The
+ * side that created the region passes its creation flags so the pages are
+ * faulted in as huge pages; a peer mapping an existing region passes 0.
+ * 
  * @param fd File descriptor from effect_shared_memory_create
  * @param size Size in bytes
+ * @param flags EFFECT_SHM_FLAG_* bits used at creation, or 0
  * @return Mapped address on success, NULL on error
  */
-void* effect_shared_memory_map(int fd, size_t size);
+void* effect_shared_memory_map(int fd, size_t size, uint32_t flags);
+
+/**
+ * Whether fd is backed by hugetlbfs pages
+ */
+bool effect_shared_memory_is_hugetlb(int fd);
 
 /**
  * Unmap shared memory
@@ -0,0 +1,82 @@
+#ifndef EFFECT_SHM_POOL_H
+#define EFFECT_SHM_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Shared memory pool carved into per-session slabs
+ *
+ * The owning side (the client) creates one large memfd, maps it once and
+ * allocates page-aligned slabs from it for each session's rings. The peer
+ * (effectd) imports the same fd once and then locates every session by
+ * offset, so opening a session costs no new fds, mappings or page faults.
+ *
+ * Pools are reference counted; sessions hold a reference for as long as
+ * they use a slab. Allocation and free are serialized internally and are
+ * meant for open/close, not for the processing path.
+ */
+typedef struct EffectShmPool EffectShmPool;
+
+#define EFFECT_SHM_POOL_GRANULE 4096   // Slab size and alignment unit
+
+/**
+ * Create and map a pool (owning side)
+ *
+ * @param name Name for the memfd
+ * @param size Pool size in bytes, rounded up to the granule (or to the huge
+ *             page size with EFFECT_SHM_FLAG_HUGE_PAGES); at most 4 GB
+ * @param flags EFFECT_SHM_FLAG_* bits for the backing memory
+ * @return Pool with one reference, or NULL on error
+ */
+EffectShmPool* effect_shm_pool_create(const char* name, size_t size, uint32_t flags);
+
+/**
+ * Map a pool created by the peer (importing side)
+ *
+ * Takes ownership of fd. Imported pools cannot allocate.
+ *
+ * @return Pool with one reference, or NULL on error
+ */
+EffectShmPool* effect_shm_pool_import(int fd, size_t size);
+
+/**
+ * Take another reference
+ */
+void effect_shm_pool_acquire(EffectShmPool* pool);
+
+/**
+ * Drop a reference; the last one unmaps the pool and closes its fd
+ */
+void effect_shm_pool_release(EffectShmPool* pool);
+
+/**
+ * Allocate a zeroed slab (owning side)
+ *
+ * @param size Bytes needed, rounded up to the granule
+ * @param offset Output: slab offset from the pool base
+ * @return Slab address, or NULL if the pool is exhausted or imported
+ */
+void* effect_shm_pool_alloc(EffectShmPool* pool, size_t size, uint64_t* offset);
+
+/**
+ * Return a slab to the pool (owning side)
+ *
+ * @param offset Offset returned by effect_shm_pool_alloc
+ * @param size Size passed to effect_shm_pool_alloc
+ */
+void effect_shm_pool_free(EffectShmPool* pool, uint64_t offset, size_t size);
+
+int effect_shm_pool_get_fd(const EffectShmPool* pool);
+void* effect_shm_pool_get_base(const EffectShmPool* pool);
+uint64_t effect_shm_pool_get_size(const EffectShmPool* pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECT_SHM_POOL_H
@@ -0,0 +1,84 @@
+#ifndef EFFECT_WAKEUP_H
+#define EFFECT_WAKEUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "effect_ringbuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Wakeup strategy used to tell the consumer of a ring that data arrived
+ */
+typedef enum {
+    EFFECT_WAKEUP_EVENTFD = 0,     // eventfd write + poll/read
+    EFFECT_WAKEUP_FUTEX = 1,       // Futex doorbell in the shared ring header
+    EFFECT_WAKEUP_SPIN_FUTEX = 2,  // Spin on the doorbell, then futex wait
+} EffectWakeupType;
+
+#define EFFECT_WAKEUP_DEFAULT_SPIN_US 50
+
+/**
+ * Process-local wakeup endpoint for one ring
+ *
+ * Each ring has one signalling side (its producer) and one waiting side
+ * (its consumer); both sides initialize their own effect_wakeup_t for the
+ * same ring. Futex strategies only enter the kernel to wake a consumer that
+ * is actually asleep, and the spinning strategy avoids sleeping at all when
+ * the producer answers within spinUs.
+ *
+ * Wakeups can be spurious or coalesced: callers always re-check the ring.
+ */
+typedef struct {
+    EffectWakeupType type;
+    int eventFd;                      // EFFECT_WAKEUP_EVENTFD only
+    effect_atomic_u32_t* doorbell;    // Futex strategies only
+    effect_atomic_u32_t* waiters;
+    uint32_t lastSeen;                // Waiting side: last doorbell value seen
+    uint32_t spinUs;                  // EFFECT_WAKEUP_SPIN_FUTEX only
+} effect_wakeup_t;
+
+/**
+ * Initialize a wakeup endpoint
+ *
+ * @param wakeup Endpoint to initialize
+ * @param type Wakeup strategy
+ * @param eventFd Eventfd for EFFECT_WAKEUP_EVENTFD, ignored otherwise
+ * @param rb Ring whose header holds the doorbell (futex strategies)
+ * @param spinUs Spin budget for EFFECT_WAKEUP_SPIN_FUTEX, 0 for default
+ * @return 0 on success, -1 if the strategy's resources are missing
+ */
+int effect_wakeup_init(effect_wakeup_t* wakeup, EffectWakeupType type, int eventFd,
+                       effect_ringbuffer_t* rb, uint32_t spinUs);
+
+/**
+ * Wake the consumer (producer side, real-time safe)
+ *
+ * @param wakeup Wakeup endpoint
+ * @return 0 on success, -1 on error
+ */
+int effect_wakeup_signal(effect_wakeup_t* wakeup);
+
+/**
+ * Wait for the producer to signal (consumer side)
+ *
+ * Returns immediately if a signal arrived since the previous wait.
+ *
+ * @param wakeup Wakeup endpoint
+ * @param timeoutUs Timeout in microseconds (0 for non-blocking, -1 for blocking)
+ * @return 0 when signalled, -1 on error or timeout
+ */
+int effect_wakeup_wait(effect_wakeup_t* wakeup, int64_t timeoutUs);
+
+/**
+ * Hint to the CPU that the caller is busy-waiting
+ */
+void effect_cpu_relax(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECT_WAKEUP_H
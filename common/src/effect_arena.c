@@ -0,0 +1,55 @@
+#include "effect_arena.h"
+#include "effect_ringbuffer.h"
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+
+size_t effect_arena_footprint(size_t size) {
+    return (size + EFFECT_CACHE_LINE_SIZE - 1) & ~(size_t)(EFFECT_CACHE_LINE_SIZE - 1);
+}
+
+int effect_arena_create(effect_arena_t* arena, size_t size) {
+    if (!arena || size == 0) {
+        return -1;
+    }
+    
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size = (size + page - 1) & ~(page - 1);
+    
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    
+    arena->base = (uint8_t*)base;
+    arena->size = size;
+    arena->used = 0;
+    arena->locked = mlock(base, size) == 0;
+    return 0;
+}
+
+void* effect_arena_alloc(effect_arena_t* arena, size_t size) {
+    size_t footprint = effect_arena_footprint(size);
+    if (!arena || !arena->base || footprint > arena->size - arena->used) {
+        return NULL;
+    }
+    
+    // Fresh anonymous pages are already zero and nothing is ever reused
+    void* block = arena->base + arena->used;
+    arena->used += footprint;
+    return block;
+}
+
+void effect_arena_destroy(effect_arena_t* arena) {
+    if (!arena || !arena->base) {
+        return;
+    }
+    
+    effect_arena_t copy = *arena;
+    arena->base = NULL;
+    munmap(copy.base, copy.size);
+}
@@ -0,0 +1,504 @@
+#include "effect_control.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define PAYLOAD_ALIGN 8
+#define MAX_PACKET_FDS (EFFECT_CONTROL_MAX_BATCH * EFFECT_CONTROL_MAX_FDS)
+#define MAX_RECORD_SIZE (sizeof(EffectControlHeader) + \
+                         sizeof(((EffectControlMessage*)0)->body))
+#define MAX_PACKET_SIZE (EFFECT_CONTROL_MAX_BATCH * MAX_RECORD_SIZE)
+#define FD_MASK_ALL ((1u << EFFECT_CONTROL_MAX_FDS) - 1)
+#define MAX_WAIT_CHANNELS 16
+
+/**
+ * Reply that arrived before anyone waited for it
+ */
+typedef struct PendingReply {
+    struct PendingReply* next;
+    EffectControlMessage msg;
+} PendingReply;
+
+struct EffectControlChannel {
+    int sock;
+    atomic_uint refs;
+    atomic_bool broken;
+    
+    pthread_mutex_t sendLock;
+    uint32_t nextRequestId;           // Guarded by sendLock
+    
+    // One waiter at a time reads the socket; the others wait on recvCond
+    pthread_mutex_t recvLock;
+    pthread_cond_t recvCond;
+    bool receiving;
+    PendingReply* replies;
+    EffectControlMessage inbox[EFFECT_CONTROL_MAX_BATCH];   // Receiving waiter only
+};
+
+/**
+ * Give up on the connection; shutting the socket down also wakes anyone
+ * blocked on it
+ */
+static void mark_broken(EffectControlChannel* channel) {
+    if (!atomic_exchange(&channel->broken, true)) {
+        shutdown(channel->sock, SHUT_RDWR);
+    }
+}
+
+static uint32_t padded(uint32_t size) {
+    return (size + PAYLOAD_ALIGN - 1) & ~(uint32_t)(PAYLOAD_ALIGN - 1);
+}
+
+static uint32_t count_fds(uint32_t fdMask) {
+    return (uint32_t)__builtin_popcount(fdMask);
+}
+
+int effect_control_send_packet(int sock, const EffectControlMessage* msgs, uint32_t count) {
+    if (!msgs || count == 0 || count > EFFECT_CONTROL_MAX_BATCH) {
+        return -1;
+    }
+    
+    uint8_t buffer[MAX_PACKET_SIZE];
+    int fds[MAX_PACKET_FDS];
+    size_t length = 0;
+    uint32_t numFds = 0;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        const EffectControlHeader* header = &msgs[i].header;
+        if (header->payloadSize > sizeof(msgs[i].body) || (header->fdMask & ~FD_MASK_ALL)) {
+            return -1;
+        }
+        
+        memcpy(buffer + length, header, sizeof(*header));
+        length += sizeof(*header);
+        memcpy(buffer + length, &msgs[i].body, header->payloadSize);
+        memset(buffer + length + header->payloadSize, 0,
+               padded(header->payloadSize) - header->payloadSize);
+        length += padded(header->payloadSize);
+        
+        for (uint32_t f = 0; f < EFFECT_CONTROL_MAX_FDS; f++) {
+            if (header->fdMask & (1u << f)) {
+                fds[numFds++] = msgs[i].fds[f];
+            }
+        }
+    }
+    
+    struct iovec iov = { buffer, length };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * MAX_PACKET_FDS)];
+    } control;
+    if (numFds > 0) {
+        msg.msg_control = control.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * numFds);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * numFds);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * numFds);
+    }
+    
+    ssize_t sent;
+    do {
+        sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    
+    return sent == (ssize_t)length ? 0 : -1;
+}
+
+static void close_all(const int* fds, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        close(fds[i]);
+    }
+}
+
+int effect_control_recv_packet(int sock, EffectControlMessage* msgs) {
+    if (!msgs) {
+        return -1;
+    }
+    
+    uint8_t buffer[MAX_PACKET_SIZE];
+    struct iovec iov = { buffer, sizeof(buffer) };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * MAX_PACKET_FDS)];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    
+    ssize_t received;
+    do {
+        received = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    
+    if (received <= 0) {
+        return (int)received;
+    }
+    
+    int fds[MAX_PACKET_FDS];
+    uint32_t numFds = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            uint32_t n = (uint32_t)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            memcpy(fds + numFds, CMSG_DATA(cmsg), n * sizeof(int));
+            numFds += n;
+        }
+    }
+    
+    if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+        close_all(fds, numFds);
+        return -1;
+    }
+    
+    // Unpack records, handing out the fds in order
+    size_t offset = 0;
+    uint32_t count = 0;
+    uint32_t nextFd = 0;
+    while (offset < (size_t)received) {
+        EffectControlMessage* m = &msgs[count];
+        if (count == EFFECT_CONTROL_MAX_BATCH || received - offset < sizeof(m->header)) {
+            close_all(fds, numFds);
+            return -1;
+        }
+        
+        memcpy(&m->header, buffer + offset, sizeof(m->header));
+        offset += sizeof(m->header);
+        
+        uint32_t payloadSize = m->header.payloadSize;
+        if (payloadSize > sizeof(m->body) || received - offset < payloadSize ||
+            (m->header.fdMask & ~FD_MASK_ALL) ||
+            nextFd + count_fds(m->header.fdMask) > numFds) {
+            close_all(fds, numFds);
+            return -1;
+        }
+        
+        memset(&m->body, 0, sizeof(m->body));
+        memcpy(&m->body, buffer + offset, payloadSize);
+        offset += padded(payloadSize);
+        
+        for (uint32_t f = 0; f < EFFECT_CONTROL_MAX_FDS; f++) {
+            m->fds[f] = (m->header.fdMask & (1u << f)) ? fds[nextFd++] : -1;
+        }
+        count++;
+    }
+    
+    if (nextFd != numFds) {
+        close_all(fds, numFds);
+        return -1;
+    }
+    return (int)count;
+}
+
+void effect_control_close_fds(EffectControlMessage* msg) {
+    if (!msg) {
+        return;
+    }
+    
+    for (uint32_t f = 0; f < EFFECT_CONTROL_MAX_FDS; f++) {
+        if ((msg->header.fdMask & (1u << f)) && msg->fds[f] >= 0) {
+            close(msg->fds[f]);
+        }
+        msg->fds[f] = -1;
+    }
+    msg->header.fdMask = 0;
+}
+
+EffectControlChannel* effect_control_connect(const char* path) {
+    if (!path) {
+        path = getenv(EFFECT_CONTROL_PATH_ENV);
+    }
+    if (!path) {
+        path = EFFECT_CONTROL_DEFAULT_PATH;
+    }
+    
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return NULL;
+    }
+    strcpy(addr.sun_path, path);
+    
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return NULL;
+    }
+    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return NULL;
+    }
+    
+    EffectControlChannel* channel = effect_control_adopt(sock);
+    if (!channel) {
+        close(sock);
+    }
+    return channel;
+}
+
+EffectControlChannel* effect_control_adopt(int sock) {
+    if (sock < 0) {
+        return NULL;
+    }
+    
+    EffectControlChannel* channel = (EffectControlChannel*)calloc(1, sizeof(EffectControlChannel));
+    if (!channel) {
+        return NULL;
+    }
+    
+    channel->sock = sock;
+    atomic_init(&channel->refs, 1);
+    atomic_init(&channel->broken, false);
+    pthread_mutex_init(&channel->sendLock, NULL);
+    pthread_mutex_init(&channel->recvLock, NULL);
+    
+    // Timed waits are against CLOCK_MONOTONIC, as poll() is
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&channel->recvCond, &attr);
+    pthread_condattr_destroy(&attr);
+    return channel;
+}
+
+void effect_control_acquire(EffectControlChannel* channel) {
+    if (channel) {
+        atomic_fetch_add(&channel->refs, 1);
+    }
+}
+
+void effect_control_release(EffectControlChannel* channel) {
+    if (!channel || atomic_fetch_sub(&channel->refs, 1) != 1) {
+        return;
+    }
+    
+    // Closing the socket makes effectd release everything opened on it
+    close(channel->sock);
+    
+    while (channel->replies) {
+        PendingReply* reply = channel->replies;
+        channel->replies = reply->next;
+        effect_control_close_fds(&reply->msg);
+        free(reply);
+    }
+    
+    pthread_cond_destroy(&channel->recvCond);
+    pthread_mutex_destroy(&channel->recvLock);
+    pthread_mutex_destroy(&channel->sendLock);
+    free(channel);
+}
+
+bool effect_control_is_broken(EffectControlChannel* channel) {
+    return !channel || atomic_load(&channel->broken);
+}
+
+int effect_control_wait_broken(EffectControlChannel* const* channels, uint32_t count,
+                               int timeoutMs) {
+    if (!channels || count == 0 || count > MAX_WAIT_CHANNELS) {
+        return -1;
+    }
+    
+    // Only hang-ups and errors are polled for, so pending replies stay put
+    struct pollfd pfds[MAX_WAIT_CHANNELS];
+    for (uint32_t i = 0; i < count; i++) {
+        if (atomic_load(&channels[i]->broken)) {
+            return (int)i;
+        }
+        pfds[i].fd = channels[i]->sock;
+        pfds[i].events = POLLRDHUP;
+        pfds[i].revents = 0;
+    }
+    
+    int ready;
+    do {
+        ready = poll(pfds, count, timeoutMs);
+    } while (ready < 0 && errno == EINTR);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        if (ready < 0 || (pfds[i].revents & (POLLRDHUP | POLLHUP | POLLERR | POLLNVAL))) {
+            mark_broken(channels[i]);
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+int effect_control_submit(EffectControlChannel* channel, EffectControlMessage* msgs,
+                          uint32_t count) {
+    if (!channel || !msgs || count == 0 || count > EFFECT_CONTROL_MAX_BATCH) {
+        return -1;
+    }
+    if (atomic_load(&channel->broken)) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&channel->sendLock);
+    for (uint32_t i = 0; i < count; i++) {
+        // 0 is never used, so a zeroed requestId is always unanswered
+        if (++channel->nextRequestId == 0) {
+            channel->nextRequestId = 1;
+        }
+        msgs[i].header.requestId = channel->nextRequestId;
+    }
+    int result = effect_control_send_packet(channel->sock, msgs, count);
+    pthread_mutex_unlock(&channel->sendLock);
+    
+    if (result < 0) {
+        mark_broken(channel);
+    }
+    return result;
+}
+
+/**
+ * Take the reply to requestId off the pending list (recvLock held)
+ */
+static bool take_reply(EffectControlChannel* channel, uint32_t requestId,
+                       EffectControlMessage* reply) {
+    for (PendingReply** link = &channel->replies; *link; link = &(*link)->next) {
+        PendingReply* pending = *link;
+        if (pending->msg.header.requestId == requestId) {
+            *reply = pending->msg;
+            *link = pending->next;
+            free(pending);
+            return true;
+        }
+    }
+    return false;
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Wait until the socket has a packet to read or the deadline passes
+ *
+ * @return true if readable (or hung up), false on timeout
+ */
+static bool wait_readable(int sock, int64_t deadlineMs) {
+    struct pollfd pfd = { sock, POLLIN, 0 };
+    int ready;
+    do {
+        int timeoutMs = -1;
+        if (deadlineMs >= 0) {
+            int64_t left = deadlineMs - now_ms();
+            timeoutMs = left > 0 ? (int)left : 0;
+        }
+        ready = poll(&pfd, 1, timeoutMs);
+    } while (ready < 0 && errno == EINTR);
+    // A failing poll is left to recvmsg to report
+    return ready != 0;
+}
+
+/**
+ * Wait for the reply to requestId until deadlineMs (CLOCK_MONOTONIC, -1 for
+ * none)
+ *
+ * @return EFFECT_CONTROL_OK, EFFECT_CONTROL_ERROR_DEAD_OBJECT if the channel
+ *         broke, or EFFECT_CONTROL_ERROR_TIMEOUT (which also breaks it)
+ */
+static int32_t wait_reply(EffectControlChannel* channel, uint32_t requestId,
+                          EffectControlMessage* reply, int64_t deadlineMs) {
+    pthread_mutex_lock(&channel->recvLock);
+    
+    int32_t result = EFFECT_CONTROL_OK;
+    while (result == EFFECT_CONTROL_OK && !take_reply(channel, requestId, reply)) {
+        if (atomic_load(&channel->broken)) {
+            result = EFFECT_CONTROL_ERROR_DEAD_OBJECT;
+            break;
+        }
+        if (channel->receiving) {
+            if (deadlineMs < 0) {
+                pthread_cond_wait(&channel->recvCond, &channel->recvLock);
+            } else {
+                struct timespec ts = { (time_t)(deadlineMs / 1000),
+                                       (long)(deadlineMs % 1000) * 1000000 };
+                if (pthread_cond_timedwait(&channel->recvCond, &channel->recvLock,
+                                           &ts) == ETIMEDOUT) {
+                    result = EFFECT_CONTROL_ERROR_TIMEOUT;
+                }
+            }
+            continue;
+        }
+        
+        // Read one packet for everyone, without holding the lock
+        channel->receiving = true;
+        pthread_mutex_unlock(&channel->recvLock);
+        int count = -1;
+        if (wait_readable(channel->sock, deadlineMs)) {
+            count = effect_control_recv_packet(channel->sock, channel->inbox);
+        } else {
+            result = EFFECT_CONTROL_ERROR_TIMEOUT;
+        }
+        pthread_mutex_lock(&channel->recvLock);
+        channel->receiving = false;
+        
+        if (count <= 0) {
+            mark_broken(channel);
+        }
+        for (int i = 0; i < count; i++) {
+            PendingReply* pending = (PendingReply*)malloc(sizeof(PendingReply));
+            if (!pending) {
+                // A lost reply would strand its waiter
+                effect_control_close_fds(&channel->inbox[i]);
+                mark_broken(channel);
+                continue;
+            }
+            pending->msg = channel->inbox[i];
+            pending->next = channel->replies;
+            channel->replies = pending;
+        }
+        pthread_cond_broadcast(&channel->recvCond);
+    }
+    
+    pthread_mutex_unlock(&channel->recvLock);
+    
+    // The reply may still come, and be taken for the answer to a later
+    // request: nothing that follows on this connection can be trusted
+    if (result == EFFECT_CONTROL_ERROR_TIMEOUT) {
+        mark_broken(channel);
+    }
+    return result;
+}
+
+int effect_control_wait(EffectControlChannel* channel, uint32_t requestId,
+                        EffectControlMessage* reply, int timeoutMs) {
+    if (!channel || !reply || requestId == 0) {
+        return -1;
+    }
+    
+    int64_t deadlineMs = timeoutMs < 0 ? -1 : now_ms() + timeoutMs;
+    return wait_reply(channel, requestId, reply, deadlineMs) == EFFECT_CONTROL_OK ? 0 : -1;
+}
+
+int32_t effect_control_call(EffectControlChannel* channel, EffectControlMessage* msg,
+                            int timeoutMs) {
+    if (!channel || !msg) {
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    int64_t deadlineMs = timeoutMs < 0 ? -1 : now_ms() + timeoutMs;
+    if (effect_control_submit(channel, msg, 1) < 0) {
+        return EFFECT_CONTROL_ERROR_DEAD_OBJECT;
+    }
+    int32_t result = wait_reply(channel, msg->header.requestId, msg, deadlineMs);
+    return result == EFFECT_CONTROL_OK ? msg->header.result : result;
+}
@@ -17,6 +17,17 @@ struct EffectFmqContext {
     size_t elementSize;
 };
 
+static void fill_region(const MessageQueue<uint8_t, kSynchronizedReadWrite>::MemTransaction& tx,
+                        EffectFmqRegion* region) {
+    const auto& first = tx.getFirstRegion();
+    const auto& second = tx.getSecondRegion();
+    
+    region->first = first.getAddress();
+    region->firstSize = first.getLength();
+    region->second = second.getLength() > 0 ? second.getAddress() : nullptr;
+    region->secondSize = second.getLength();
+}
+
 EffectFmqHandle effect_fmq_create(EffectFmqType type, size_t capacity, size_t elementSize) {
     if (type != EFFECT_FMQ_SYNCHRONIZED) {
         // Only synchronized mode supported for now
@@ -166,6 +177,70 @@ ssize_t effect_fmq_read_blocking(EffectFmqHandle handle, void* data,
     return ctx->queue->read(bytes, count) ? count : -1;
 }
 
+int effect_fmq_acquire_write(EffectFmqHandle handle, size_t count, EffectFmqRegion* region) {
+    if (!handle || !region || count == 0) {
+        return -1;
+    }
+    
+    auto* ctx = static_cast<EffectFmqContext*>(handle);
+    if (!ctx->queue) {
+        return -1;
+    }
+    
+    MessageQueue<uint8_t, kSynchronizedReadWrite>::MemTransaction tx;
+    if (!ctx->queue->beginWrite(count, &tx)) {
+        return -1;
+    }
+    
+    fill_region(tx, region);
+    return 0;
+}
+
+int effect_fmq_commit_write(EffectFmqHandle handle, size_t count) {
+    if (!handle) {
+        return -1;
+    }
+    
+    auto* ctx = static_cast<EffectFmqContext*>(handle);
+    if (!ctx->queue) {
+        return -1;
+    }
+    
+    return ctx->queue->commitWrite(count) ? 0 : -1;
+}
+
+int effect_fmq_acquire_read(EffectFmqHandle handle, size_t count, EffectFmqRegion* region) {
+    if (!handle || !region || count == 0) {
+        return -1;
+    }
+    
+    auto* ctx = static_cast<EffectFmqContext*>(handle);
+    if (!ctx->queue) {
+        return -1;
+    }
+    
+    MessageQueue<uint8_t, kSynchronizedReadWrite>::MemTransaction tx;
+    if (!ctx->queue->beginRead(count, &tx)) {
+        return -1;
+    }
+    
+    fill_region(tx, region);
+    return 0;
+}
+
+int effect_fmq_release_read(EffectFmqHandle handle, size_t count) {
+    if (!handle) {
+        return -1;
+    }
+    
+    auto* ctx = static_cast<EffectFmqContext*>(handle);
+    if (!ctx->queue) {
+        return -1;
+    }
+    
+    return ctx->queue->commitRead(count) ? 0 : -1;
+}
+
 size_t effect_fmq_available_to_write(EffectFmqHandle handle) {
     if (!handle) {
         return 0;
@@ -238,6 +313,13 @@ struct EffectFmqContext {
     size_t elementSize;
 };
 
+static void fill_region(const effect_ringbuffer_region_t& rbRegion, EffectFmqRegion* region) {
+    region->first = rbRegion.first;
+    region->firstSize = rbRegion.firstSize;
+    region->second = rbRegion.second;
+    region->secondSize = rbRegion.secondSize;
+}
+
 EffectFmqHandle effect_fmq_create(EffectFmqType type, size_t capacity, size_t elementSize) {
     auto* ctx = new EffectFmqContext();
     if (!ctx) {
@@ -302,6 +384,56 @@ ssize_t effect_fmq_read_blocking(EffectFmqHandle handle, void* data,
     return effect_fmq_read(handle, data, count);
 }
 
+int effect_fmq_acquire_write(EffectFmqHandle handle, size_t count, EffectFmqRegion* region) {
+    if (!handle || !region || count == 0) {
+        return -1;
+    }
+    
+    auto* ctx = static_cast<EffectFmqContext*>(handle);
+    effect_ringbuffer_region_t rbRegion;
+    if (effect_ringbuffer_acquire_write(&ctx->ringbuffer, (uint32_t)count, &rbRegion) < count) {
+        return -1;
+    }
+    
+    fill_region(rbRegion, region);
+    return 0;
+}
+
+int effect_fmq_commit_write(EffectFmqHandle handle, size_t count) {
+    if (!handle) {
+        return -1;
+    }
+    
+    auto* ctx = static_cast<EffectFmqContext*>(handle);
+    effect_ringbuffer_commit_write(&ctx->ringbuffer, (uint32_t)count);
+    return 0;
+}
+
+int effect_fmq_acquire_read(EffectFmqHandle handle, size_t count, EffectFmqRegion* region) {
+    if (!handle || !region || count == 0) {
+        return -1;
+    }
+    
+    auto* ctx = static_cast<EffectFmqContext*>(handle);
+    effect_ringbuffer_region_t rbRegion;
+    if (effect_ringbuffer_acquire_read(&ctx->ringbuffer, (uint32_t)count, &rbRegion) < count) {
+        return -1;
+    }
+    
+    fill_region(rbRegion, region);
+    return 0;
+}
+
+int effect_fmq_release_read(EffectFmqHandle handle, size_t count) {
+    if (!handle) {
+        return -1;
+    }
+    
+    auto* ctx = static_cast<EffectFmqContext*>(handle);
+    effect_ringbuffer_release_read(&ctx->ringbuffer, (uint32_t)count);
+    return 0;
+}
+
 size_t effect_fmq_available_to_write(EffectFmqHandle handle) {
     if (!handle) {
         return 0;
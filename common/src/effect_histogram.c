@@ -0,0 +1,100 @@
+#include "effect_histogram.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define SUB_BITS EFFECT_HISTOGRAM_SUB_BUCKET_BITS
+#define SUB_BUCKETS EFFECT_HISTOGRAM_SUB_BUCKETS
+
+static uint32_t bucket_index(uint32_t value) {
+    if (value > EFFECT_HISTOGRAM_MAX_VALUE) {
+        value = EFFECT_HISTOGRAM_MAX_VALUE;
+    }
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+    
+    // Position of the top bit selects the power of two, the next SUB_BITS
+    // bits select the bucket within it
+    uint32_t msb = 31u - (uint32_t)__builtin_clz(value);
+    uint32_t shift = msb - SUB_BITS;
+    uint32_t sub = (value >> shift) & (SUB_BUCKETS - 1);
+    return SUB_BUCKETS + shift * SUB_BUCKETS + sub;
+}
+
+static uint32_t bucket_upper_bound(uint32_t index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    
+    uint32_t shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    uint32_t sub = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    uint32_t lower = (SUB_BUCKETS + sub) << shift;
+    return lower + (1u << shift) - 1;
+}
+
+void effect_histogram_reset(effect_histogram_t* hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+void effect_histogram_record(effect_histogram_t* hist, uint32_t value) {
+    hist->counts[bucket_index(value)]++;
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+void effect_histogram_subtract(effect_histogram_t* delta, const effect_histogram_t* newer,
+                               const effect_histogram_t* older) {
+    uint32_t highest = 0;
+    bool found = false;
+    
+    for (uint32_t i = 0; i < EFFECT_HISTOGRAM_BUCKETS; i++) {
+        delta->counts[i] = newer->counts[i] - older->counts[i];
+        if (delta->counts[i] != 0) {
+            highest = i;
+            found = true;
+        }
+    }
+    delta->count = newer->count - older->count;
+    delta->sum = newer->sum - older->sum;
+    
+    delta->max = 0;
+    if (found) {
+        uint32_t bound = bucket_upper_bound(highest);
+        delta->max = (bound < newer->max) ? bound : newer->max;
+    }
+}
+
+uint32_t effect_histogram_percentile(const effect_histogram_t* hist, double percentile) {
+    if (hist->count == 0) {
+        return 0;
+    }
+    
+    // Smallest value with at least percentile% of the samples at or below it
+    uint64_t rank = (uint64_t)((percentile / 100.0) * (double)hist->count + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    if (rank > hist->count) {
+        rank = hist->count;
+    }
+    
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < EFFECT_HISTOGRAM_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            uint32_t bound = bucket_upper_bound(i);
+            return (bound < hist->max) ? bound : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+uint32_t effect_histogram_mean(const effect_histogram_t* hist) {
+    if (hist->count == 0) {
+        return 0;
+    }
+    return (uint32_t)((hist->sum + hist->count / 2) / hist->count);
+}
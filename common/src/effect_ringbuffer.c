@@ -2,52 +2,250 @@
 #include <string.h>
 #include <stdatomic.h>
 
-void effect_ringbuffer_init(effect_ringbuffer_t* rb, void* data, uint32_t capacity) {
-    atomic_init(&rb->write_index, 0);
-    atomic_init(&rb->read_index, 0);
+_Static_assert(sizeof(effect_ringbuffer_header_t) == 4 * EFFECT_CACHE_LINE_SIZE,
+               "ring header must be exactly four cache lines");
+
+static bool is_power_of_two(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+static bool quantum_valid(uint32_t capacity, uint32_t quantum) {
+    return quantum == 0 || (is_power_of_two(capacity) && quantum <= capacity);
+}
+
+/**
+ * Point a view at a ring's indices and data
+ * 
+ * The geometry is passed in rather than read from the header: a peer can
+ * rewrite a shared header at any time, so only values that were checked
+ * may be bound.
+ */
+static void view_bind(effect_ringbuffer_t* rb, effect_ringbuffer_header_t* header, uint8_t* data,
+                      uint32_t capacity, uint32_t quantum) {
+    rb->header = header;
+    rb->data = data;
     rb->capacity = capacity;
-    rb->data = (uint8_t*)data;
+    rb->mask = is_power_of_two(capacity) ? capacity - 1 : 0;
+    rb->quantum = quantum;
+}
+
+static void header_format(effect_ringbuffer_header_t* header, uint32_t capacity, uint32_t quantum) {
+    memset(header, 0, sizeof(*header));
+    header->magic = EFFECT_RINGBUFFER_MAGIC;
+    header->version = EFFECT_RINGBUFFER_VERSION;
+    header->headerSize = sizeof(effect_ringbuffer_header_t);
+    header->capacity = capacity;
+    header->quantum = quantum;
+    atomic_init(&header->write_index, 0);
+    atomic_init(&header->read_index, 0);
+    atomic_init(&header->doorbell, 0);
+    atomic_init(&header->waiters, 0);
+}
+
+void effect_ringbuffer_init(effect_ringbuffer_t* rb, void* data, uint32_t capacity) {
+    header_format(&rb->localHeader, capacity, 0);
+    view_bind(rb, &rb->localHeader, (uint8_t*)data, capacity, 0);
+}
+
+int effect_ringbuffer_init_quantum(effect_ringbuffer_t* rb, void* data,
+                                   uint32_t capacity, uint32_t quantum) {
+    if (!rb || !data || quantum == 0 || !quantum_valid(capacity, quantum)) {
+        return -1;
+    }
+    
+    header_format(&rb->localHeader, capacity, quantum);
+    view_bind(rb, &rb->localHeader, (uint8_t*)data, capacity, quantum);
+    return 0;
+}
+
+size_t effect_ringbuffer_shared_size(uint32_t capacity) {
+    size_t size = sizeof(effect_ringbuffer_header_t) + capacity;
+    return (size + EFFECT_CACHE_LINE_SIZE - 1) & ~(size_t)(EFFECT_CACHE_LINE_SIZE - 1);
+}
+
+int effect_ringbuffer_create_shared(effect_ringbuffer_t* rb, void* mem,
+                                    uint32_t capacity, uint32_t quantum) {
+    if (!rb || !mem || capacity == 0 || !quantum_valid(capacity, quantum)) {
+        return -1;
+    }
+    
+    // Indices must not straddle cache lines shared with foreign data
+    if (((uintptr_t)mem & (EFFECT_CACHE_LINE_SIZE - 1)) != 0) {
+        return -1;
+    }
+    
+    effect_ringbuffer_header_t* header = (effect_ringbuffer_header_t*)mem;
+    header_format(header, capacity, quantum);
+    
+    view_bind(rb, header, (uint8_t*)mem + sizeof(effect_ringbuffer_header_t), capacity, quantum);
+    return 0;
+}
+
+int effect_ringbuffer_attach(effect_ringbuffer_t* rb, void* mem, size_t size) {
+    if (!rb || !mem || size < sizeof(effect_ringbuffer_header_t)) {
+        return -1;
+    }
+    
+    if (((uintptr_t)mem & (EFFECT_CACHE_LINE_SIZE - 1)) != 0) {
+        return -1;
+    }
+    
+    // The peer may rewrite the header while we look at it: read each field
+    // once, then check and bind only the copies
+    const volatile effect_ringbuffer_header_t* shared =
+        (const volatile effect_ringbuffer_header_t*)mem;
+    uint32_t magic = shared->magic;
+    uint32_t version = shared->version;
+    uint32_t headerSize = shared->headerSize;
+    uint32_t capacity = shared->capacity;
+    uint32_t quantum = shared->quantum;
+    
+    if (magic != EFFECT_RINGBUFFER_MAGIC ||
+        version != EFFECT_RINGBUFFER_VERSION ||
+        headerSize != sizeof(effect_ringbuffer_header_t) ||
+        capacity == 0 ||
+        capacity > size - sizeof(effect_ringbuffer_header_t) ||
+        !quantum_valid(capacity, quantum)) {
+        return -1;
+    }
+    
+    view_bind(rb, (effect_ringbuffer_header_t*)mem,
+              (uint8_t*)mem + sizeof(effect_ringbuffer_header_t), capacity, quantum);
+    return 0;
 }
 
 uint32_t effect_ringbuffer_get_read_available(const effect_ringbuffer_t* rb) {
-    uint64_t write_idx = atomic_load_explicit(&rb->write_index, memory_order_acquire);
-    uint64_t read_idx = atomic_load_explicit(&rb->read_index, memory_order_acquire);
+    uint64_t write_idx = atomic_load_explicit(&rb->header->write_index, memory_order_acquire);
+    uint64_t read_idx = atomic_load_explicit(&rb->header->read_index, memory_order_acquire);
     return (uint32_t)(write_idx - read_idx);
 }
 
 uint32_t effect_ringbuffer_get_write_available(const effect_ringbuffer_t* rb) {
-    uint64_t write_idx = atomic_load_explicit(&rb->write_index, memory_order_acquire);
-    uint64_t read_idx = atomic_load_explicit(&rb->read_index, memory_order_acquire);
+    uint64_t write_idx = atomic_load_explicit(&rb->header->write_index, memory_order_acquire);
+    uint64_t read_idx = atomic_load_explicit(&rb->header->read_index, memory_order_acquire);
     uint32_t used = (uint32_t)(write_idx - read_idx);
     return rb->capacity - used;
 }
 
-uint32_t effect_ringbuffer_write(effect_ringbuffer_t* rb, const void* data, uint32_t size) {
-    if (size == 0) return 0;
+uint32_t effect_ringbuffer_get_read_periods(const effect_ringbuffer_t* rb) {
+    if (rb->quantum == 0) {
+        return 0;
+    }
+    return effect_ringbuffer_get_read_available(rb) / rb->quantum;
+}
+
+uint32_t effect_ringbuffer_get_write_periods(const effect_ringbuffer_t* rb) {
+    if (rb->quantum == 0) {
+        return 0;
+    }
+    return effect_ringbuffer_get_write_available(rb) / rb->quantum;
+}
+
+uint64_t effect_ringbuffer_get_write_position(const effect_ringbuffer_t* rb) {
+    return atomic_load_explicit(&rb->header->write_index, memory_order_acquire);
+}
+
+uint64_t effect_ringbuffer_get_read_position(const effect_ringbuffer_t* rb) {
+    return atomic_load_explicit(&rb->header->read_index, memory_order_acquire);
+}
+
+/**
+ * Clamp a transfer request to what the ring can move
+ * Quantum rings move all of size or nothing, and only whole periods.
+ */
+static uint32_t transfer_size(const effect_ringbuffer_t* rb, uint32_t size, uint32_t available) {
+    if (rb->quantum != 0) {
+        return (size <= available && size % rb->quantum == 0) ? size : 0;
+    }
+    return (size < available) ? size : available;
+}
+
+static void region_init(const effect_ringbuffer_t* rb, uint64_t index, uint32_t size,
+                        effect_ringbuffer_region_t* region) {
+    // Calculate position in circular buffer
+    uint32_t pos = rb->mask ? (uint32_t)index & rb->mask : (uint32_t)(index % rb->capacity);
+    uint32_t contiguous = rb->capacity - pos;
     
-    uint64_t write_idx = atomic_load_explicit(&rb->write_index, memory_order_relaxed);
-    uint64_t read_idx = atomic_load_explicit(&rb->read_index, memory_order_acquire);
+    region->first = rb->data + pos;
+    if (size <= contiguous) {
+        // Single contiguous span
+        region->firstSize = size;
+        region->second = NULL;
+        region->secondSize = 0;
+    } else {
+        // Split span (wrap around)
+        region->firstSize = contiguous;
+        region->second = rb->data;
+        region->secondSize = size - contiguous;
+    }
+}
+
+uint32_t effect_ringbuffer_acquire_write(effect_ringbuffer_t* rb, uint32_t size,
+                                         effect_ringbuffer_region_t* region) {
+    effect_ringbuffer_header_t* header = rb->header;
+    uint64_t write_idx = atomic_load_explicit(&header->write_index, memory_order_relaxed);
+    uint64_t read_idx = header->cached_read_index;
     
     uint32_t available = rb->capacity - (uint32_t)(write_idx - read_idx);
-    uint32_t to_write = (size < available) ? size : available;
+    if (available < size) {
+        // Cached view looks too full - refresh from the consumer's line
+        read_idx = atomic_load_explicit(&header->read_index, memory_order_acquire);
+        header->cached_read_index = read_idx;
+        available = rb->capacity - (uint32_t)(write_idx - read_idx);
+    }
     
-    if (to_write == 0) return 0;
+    uint32_t to_write = transfer_size(rb, size, available);
+    region_init(rb, write_idx, to_write, region);
+    return to_write;
+}
+
+void effect_ringbuffer_commit_write(effect_ringbuffer_t* rb, uint32_t size) {
+    uint64_t write_idx = atomic_load_explicit(&rb->header->write_index, memory_order_relaxed);
     
-    // Calculate position in circular buffer
-    uint32_t pos = (uint32_t)(write_idx % rb->capacity);
-    uint32_t contiguous = rb->capacity - pos;
+    // Update write index with release semantics
+    atomic_store_explicit(&rb->header->write_index, write_idx + size, memory_order_release);
+}
+
+uint32_t effect_ringbuffer_acquire_read(effect_ringbuffer_t* rb, uint32_t size,
+                                        effect_ringbuffer_region_t* region) {
+    effect_ringbuffer_header_t* header = rb->header;
+    uint64_t write_idx = header->cached_write_index;
+    uint64_t read_idx = atomic_load_explicit(&header->read_index, memory_order_relaxed);
     
-    if (to_write <= contiguous) {
-        // Single contiguous write
-        memcpy(rb->data + pos, data, to_write);
-    } else {
-        // Split write (wrap around)
-        memcpy(rb->data + pos, data, contiguous);
-        memcpy(rb->data, (const uint8_t*)data + contiguous, to_write - contiguous);
+    uint32_t available = (uint32_t)(write_idx - read_idx);
+    if (available < size) {
+        // Cached view looks too empty - refresh from the producer's line
+        write_idx = atomic_load_explicit(&header->write_index, memory_order_acquire);
+        header->cached_write_index = write_idx;
+        available = (uint32_t)(write_idx - read_idx);
     }
     
-    // Update write index with release semantics
-    atomic_store_explicit(&rb->write_index, write_idx + to_write, memory_order_release);
+    uint32_t to_read = transfer_size(rb, size, available);
+    region_init(rb, read_idx, to_read, region);
+    return to_read;
+}
+
+void effect_ringbuffer_release_read(effect_ringbuffer_t* rb, uint32_t size) {
+    uint64_t read_idx = atomic_load_explicit(&rb->header->read_index, memory_order_relaxed);
+    
+    // Update read index with release semantics
+    atomic_store_explicit(&rb->header->read_index, read_idx + size, memory_order_release);
+}
+
+uint32_t effect_ringbuffer_write(effect_ringbuffer_t* rb, const void* data, uint32_t size) {
+    if (size == 0) return 0;
+    
+    effect_ringbuffer_region_t region;
+    uint32_t to_write = effect_ringbuffer_acquire_write(rb, size, &region);
+    
+    if (to_write == 0) return 0;
+    
+    memcpy(region.first, data, region.firstSize);
+    if (region.second) {
+        memcpy(region.second, (const uint8_t*)data + region.firstSize, region.secondSize);
+    }
+    
+    effect_ringbuffer_commit_write(rb, to_write);
     
     return to_write;
 }
@@ -55,34 +253,24 @@ uint32_t effect_ringbuffer_write(effect_ringbuffer_t* rb, const void* data, uint
 uint32_t effect_ringbuffer_read(effect_ringbuffer_t* rb, void* data, uint32_t size) {
     if (size == 0) return 0;
     
-    uint64_t write_idx = atomic_load_explicit(&rb->write_index, memory_order_acquire);
-    uint64_t read_idx = atomic_load_explicit(&rb->read_index, memory_order_relaxed);
-    
-    uint32_t available = (uint32_t)(write_idx - read_idx);
-    uint32_t to_read = (size < available) ? size : available;
+    effect_ringbuffer_region_t region;
+    uint32_t to_read = effect_ringbuffer_acquire_read(rb, size, &region);
     
     if (to_read == 0) return 0;
     
-    // Calculate position in circular buffer
-    uint32_t pos = (uint32_t)(read_idx % rb->capacity);
-    uint32_t contiguous = rb->capacity - pos;
-    
-    if (to_read <= contiguous) {
-        // Single contiguous read
-        memcpy(data, rb->data + pos, to_read);
-    } else {
-        // Split read (wrap around)
-        memcpy(data, rb->data + pos, contiguous);
-        memcpy((uint8_t*)data + contiguous, rb->data, to_read - contiguous);
+    memcpy(data, region.first, region.firstSize);
+    if (region.second) {
+        memcpy((uint8_t*)data + region.firstSize, region.second, region.secondSize);
     }
     
-    // Update read index with release semantics
-    atomic_store_explicit(&rb->read_index, read_idx + to_read, memory_order_release);
+    effect_ringbuffer_release_read(rb, to_read);
     
     return to_read;
 }
 
 void effect_ringbuffer_reset(effect_ringbuffer_t* rb) {
-    atomic_store_explicit(&rb->write_index, 0, memory_order_release);
-    atomic_store_explicit(&rb->read_index, 0, memory_order_release);
+    atomic_store_explicit(&rb->header->write_index, 0, memory_order_release);
+    atomic_store_explicit(&rb->header->read_index, 0, memory_order_release);
+    rb->header->cached_read_index = 0;
+    rb->header->cached_write_index = 0;
 }
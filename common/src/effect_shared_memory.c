@@ -8,6 +8,8 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdatomic.h>
+#include <sys/vfs.h>
 
 // Try memfd_create first, fallback to ashmem
 #ifndef __NR_memfd_create
@@ -28,13 +30,94 @@
 #define MFD_CLOEXEC 0x0001U
 #endif
 
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB 0x0004U
+#endif
+
+#ifndef HUGETLBFS_MAGIC
+#define HUGETLBFS_MAGIC 0x958458f6
+#endif
+
+#define DEFAULT_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define COPY_CHUNK_SIZE (64 * 1024)   // Stack buffer for effect_shared_memory_copy_sealed
+
 static int memfd_create_wrapper(const char* name, unsigned int flags) {
     return (int)syscall(__NR_memfd_create, name, flags);
 }
 
-int effect_shared_memory_create(const char* name, size_t size) {
+size_t effect_shared_memory_huge_page_size(void) {
+    static atomic_size_t cached = 0;
+    
+    size_t size = atomic_load_explicit(&cached, memory_order_relaxed);
+    if (size != 0) {
+        return size;
+    }
+    
+    size = DEFAULT_HUGE_PAGE_SIZE;
+    FILE* meminfo = fopen("/proc/meminfo", "re");
+    if (meminfo) {
+        char line[128];
+        unsigned long kb;
+        while (fgets(line, sizeof(line), meminfo)) {
+            if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1 && kb > 0) {
+                size = (size_t)kb * 1024;
+                break;
+            }
+        }
+        fclose(meminfo);
+    }
+    
+    atomic_store_explicit(&cached, size, memory_order_relaxed);
+    return size;
+}
+
+bool effect_shared_memory_is_hugetlb(int fd) {
+    struct statfs fs;
+    return fstatfs(fd, &fs) == 0 && (unsigned long)fs.f_type == HUGETLBFS_MAGIC;
+}
+
+/**
+ * hugetlbfs memfd of size bytes, or -1 if no huge pages can be reserved
+ */
+static int create_hugetlb(const char* name, size_t size) {
+    if (size == 0 || size % effect_shared_memory_huge_page_size() != 0) {
+        return -1;
+    }
+    
+    int fd = memfd_create_wrapper(name, MFD_CLOEXEC | MFD_HUGETLB);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    // Huge pages are reserved at mmap time, so a failed pool only shows up
+    // there; for shared mappings the reservation outlives this probe
+    void* probe = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        probe = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (probe == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    munmap(probe, size);
+    return fd;
+}
+
+int effect_shared_memory_create(const char* name, size_t size, uint32_t flags) {
     int fd = -1;
     
+    if (flags & EFFECT_SHM_FLAG_HUGE_PAGES) {
+        fd = create_hugetlb(name, size);
+        if (fd >= 0) {
+            return fd;
+        }
+        // Fall through to normal memory; map() still asks for THP
+    }
+    
     // Try memfd_create first (Linux 3.17+)
     fd = memfd_create_wrapper(name, MFD_CLOEXEC);
     
@@ -70,11 +153,107 @@ int effect_shared_memory_create(const char* name, size_t size) {
     return fd;
 }
 
-void* effect_shared_memory_map(int fd, size_t size) {
-    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+int effect_shared_memory_create_sealed(const char* name, const void* data, size_t size) {
+    if (!data || size == 0) {
+        return -1;
+    }
+    
+    int fd = memfd_create_wrapper(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    // write() leaves no writable mapping behind, which F_SEAL_WRITE requires
+    const uint8_t* src = (const uint8_t*)data;
+    size_t written = 0;
+    while (written < size) {
+        ssize_t ret = write(fd, src + written, size - written);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            close(fd);
+            return -1;
+        }
+        written += (size_t)ret;
+    }
+    
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int effect_shared_memory_copy_sealed(const char* name, int srcFd, size_t size) {
+    if (srcFd < 0 || size == 0) {
+        return -1;
+    }
+    
+    int fd = memfd_create_wrapper(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    uint8_t buffer[COPY_CHUNK_SIZE];
+    size_t copied = 0;
+    while (copied < size) {
+        size_t chunk = size - copied < sizeof(buffer) ? size - copied : sizeof(buffer);
+        ssize_t ret = pread(srcFd, buffer, chunk, (off_t)copied);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            close(fd);
+            return -1;
+        }
+        
+        for (ssize_t written = 0; written < ret;) {
+            ssize_t n = write(fd, buffer + written, (size_t)(ret - written));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                close(fd);
+                return -1;
+            }
+            written += n;
+        }
+        copied += (size_t)ret;
+    }
+    
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void* effect_shared_memory_map(int fd, size_t size, uint32_t flags) {
+    // Transparent huge pages only help if advised before the first fault
+    bool thp = (flags & EFFECT_SHM_FLAG_HUGE_PAGES) && !effect_shared_memory_is_hugetlb(fd);
+    
+    // Rings are touched every period: fault them in now, and keep them
+    // resident if we are allowed to (best effort)
+    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | (thp ? 0 : MAP_POPULATE), fd, 0);
     if (addr == MAP_FAILED) {
         return NULL;
     }
+    
+    if (thp) {
+#ifdef MADV_HUGEPAGE
+        madvise(addr, size, MADV_HUGEPAGE);
+#endif
+        // Reading a shmem hole allocates the page, so this prefaults
+        // without disturbing anything the peer may already have written
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        for (size_t off = 0; off < size; off += page) {
+            (void)*(volatile uint8_t*)((uint8_t*)addr + off);
+        }
+    }
+    
+    mlock(addr, size);
     return addr;
 }
 
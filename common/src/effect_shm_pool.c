@@ -0,0 +1,203 @@
+#include "effect_shm_pool.h"
+#include "effect_shared_memory.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/**
+ * Free range of the pool, in bytes
+ */
+typedef struct {
+    uint64_t offset;
+    uint64_t size;
+} Extent;
+
+struct EffectShmPool {
+    int fd;
+    uint8_t* base;
+    uint64_t size;
+    atomic_uint refs;
+    bool owner;
+    
+    // Free extents sorted by offset, never adjacent (merged on free)
+    pthread_mutex_t lock;
+    Extent* freeList;
+    uint32_t freeCount;
+    uint32_t freeCapacity;
+};
+
+static uint64_t round_to_granule(uint64_t size) {
+    return (size + EFFECT_SHM_POOL_GRANULE - 1) & ~(uint64_t)(EFFECT_SHM_POOL_GRANULE - 1);
+}
+
+static EffectShmPool* pool_new(int fd, uint64_t size, bool owner, uint32_t flags) {
+    EffectShmPool* pool = (EffectShmPool*)calloc(1, sizeof(EffectShmPool));
+    if (!pool) {
+        return NULL;
+    }
+    
+    pool->base = (uint8_t*)effect_shared_memory_map(fd, (size_t)size, flags);
+    if (!pool->base) {
+        free(pool);
+        return NULL;
+    }
+    
+    pool->fd = fd;
+    pool->size = size;
+    pool->owner = owner;
+    atomic_init(&pool->refs, 1);
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+EffectShmPool* effect_shm_pool_create(const char* name, size_t size, uint32_t flags) {
+    uint64_t poolSize = round_to_granule(size);
+    if (flags & EFFECT_SHM_FLAG_HUGE_PAGES) {
+        uint64_t hugePage = effect_shared_memory_huge_page_size();
+        poolSize = (poolSize + hugePage - 1) / hugePage * hugePage;
+    }
+    if (poolSize == 0 || poolSize > UINT32_MAX) {
+        // Ring offsets in EffectSharedMemoryLayout are 32-bit
+        return NULL;
+    }
+    
+    int fd = effect_shared_memory_create(name, (size_t)poolSize, flags);
+    if (fd < 0) {
+        return NULL;
+    }
+    
+    EffectShmPool* pool = pool_new(fd, poolSize, true, flags);
+    if (!pool) {
+        close(fd);
+        return NULL;
+    }
+    
+    // Free extents alternate with used ones, so this many always suffice
+    pool->freeCapacity = (uint32_t)(poolSize / EFFECT_SHM_POOL_GRANULE / 2 + 1);
+    pool->freeList = (Extent*)malloc(pool->freeCapacity * sizeof(Extent));
+    if (!pool->freeList) {
+        effect_shm_pool_release(pool);
+        return NULL;
+    }
+    pool->freeList[0].offset = 0;
+    pool->freeList[0].size = poolSize;
+    pool->freeCount = 1;
+    return pool;
+}
+
+EffectShmPool* effect_shm_pool_import(int fd, size_t size) {
+    if (fd < 0 || size == 0) {
+        return NULL;
+    }
+    return pool_new(fd, size, false, 0);
+}
+
+void effect_shm_pool_acquire(EffectShmPool* pool) {
+    if (pool) {
+        atomic_fetch_add(&pool->refs, 1);
+    }
+}
+
+void effect_shm_pool_release(EffectShmPool* pool) {
+    if (!pool || atomic_fetch_sub(&pool->refs, 1) != 1) {
+        return;
+    }
+    
+    effect_shared_memory_unmap(pool->base, (size_t)pool->size);
+    close(pool->fd);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->freeList);
+    free(pool);
+}
+
+void* effect_shm_pool_alloc(EffectShmPool* pool, size_t size, uint64_t* offset) {
+    if (!pool || !pool->owner || !offset || size == 0) {
+        return NULL;
+    }
+    
+    uint64_t slabSize = round_to_granule(size);
+    void* slab = NULL;
+    
+    pthread_mutex_lock(&pool->lock);
+    
+    // First fit keeps long-lived sessions packed at the low end
+    for (uint32_t i = 0; i < pool->freeCount; i++) {
+        Extent* extent = &pool->freeList[i];
+        if (extent->size < slabSize) {
+            continue;
+        }
+        
+        *offset = extent->offset;
+        extent->offset += slabSize;
+        extent->size -= slabSize;
+        if (extent->size == 0) {
+            memmove(extent, extent + 1, (pool->freeCount - i - 1) * sizeof(Extent));
+            pool->freeCount--;
+        }
+        slab = pool->base + *offset;
+        break;
+    }
+    
+    pthread_mutex_unlock(&pool->lock);
+    
+    if (slab) {
+        // A recycled slab still holds the previous session's rings
+        memset(slab, 0, (size_t)slabSize);
+    }
+    return slab;
+}
+
+void effect_shm_pool_free(EffectShmPool* pool, uint64_t offset, size_t size) {
+    if (!pool || !pool->owner || size == 0) {
+        return;
+    }
+    
+    uint64_t slabSize = round_to_granule(size);
+    
+    pthread_mutex_lock(&pool->lock);
+    
+    // Find the first free extent after the slab
+    uint32_t i = 0;
+    while (i < pool->freeCount && pool->freeList[i].offset < offset) {
+        i++;
+    }
+    
+    bool mergePrev = i > 0 &&
+                     pool->freeList[i - 1].offset + pool->freeList[i - 1].size == offset;
+    bool mergeNext = i < pool->freeCount && offset + slabSize == pool->freeList[i].offset;
+    
+    if (mergePrev && mergeNext) {
+        pool->freeList[i - 1].size += slabSize + pool->freeList[i].size;
+        memmove(&pool->freeList[i], &pool->freeList[i + 1],
+                (pool->freeCount - i - 1) * sizeof(Extent));
+        pool->freeCount--;
+    } else if (mergePrev) {
+        pool->freeList[i - 1].size += slabSize;
+    } else if (mergeNext) {
+        pool->freeList[i].offset = offset;
+        pool->freeList[i].size += slabSize;
+    } else if (pool->freeCount < pool->freeCapacity) {
+        memmove(&pool->freeList[i + 1], &pool->freeList[i],
+                (pool->freeCount - i) * sizeof(Extent));
+        pool->freeList[i].offset = offset;
+        pool->freeList[i].size = slabSize;
+        pool->freeCount++;
+    }
+    
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int effect_shm_pool_get_fd(const EffectShmPool* pool) {
+    return pool ? pool->fd : -1;
+}
+
+void* effect_shm_pool_get_base(const EffectShmPool* pool) {
+    return pool ? pool->base : NULL;
+}
+
+uint64_t effect_shm_pool_get_size(const EffectShmPool* pool) {
+    return pool ? pool->size : 0;
+}
@@ -0,0 +1,186 @@
+#include "effect_wakeup.h"
+#include "effect_shared_memory.h"
+#include <stdatomic.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static int64_t get_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000LL;
+}
+
+static void us_to_timespec(int64_t us, struct timespec* ts) {
+    ts->tv_sec = (time_t)(us / 1000000LL);
+    ts->tv_nsec = (long)((us % 1000000LL) * 1000LL);
+}
+
+// The doorbell is shared between processes, so no FUTEX_PRIVATE_FLAG
+static int futex_wait(effect_atomic_u32_t* word, uint32_t expected, int64_t timeoutUs) {
+    struct timespec ts;
+    struct timespec* tsp = NULL;
+    if (timeoutUs >= 0) {
+        us_to_timespec(timeoutUs, &ts);
+        tsp = &ts;
+    }
+    return (int)syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, expected, tsp, NULL, 0);
+}
+
+static int futex_wake(effect_atomic_u32_t* word) {
+    return (int)syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+void effect_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+int effect_wakeup_init(effect_wakeup_t* wakeup, EffectWakeupType type, int eventFd,
+                       effect_ringbuffer_t* rb, uint32_t spinUs) {
+    if (!wakeup) {
+        return -1;
+    }
+    
+    wakeup->type = type;
+    wakeup->eventFd = -1;
+    wakeup->doorbell = NULL;
+    wakeup->waiters = NULL;
+    wakeup->lastSeen = 0;
+    wakeup->spinUs = spinUs ? spinUs : EFFECT_WAKEUP_DEFAULT_SPIN_US;
+    
+    // Spinning only helps when the producer runs on another core
+    if (sysconf(_SC_NPROCESSORS_ONLN) <= 1) {
+        wakeup->spinUs = 0;
+    }
+    
+    switch (type) {
+        case EFFECT_WAKEUP_EVENTFD:
+            if (eventFd < 0) {
+                return -1;
+            }
+            wakeup->eventFd = eventFd;
+            return 0;
+        
+        case EFFECT_WAKEUP_FUTEX:
+        case EFFECT_WAKEUP_SPIN_FUTEX:
+            if (!rb || !rb->header) {
+                return -1;
+            }
+            wakeup->doorbell = &rb->header->doorbell;
+            wakeup->waiters = &rb->header->waiters;
+            wakeup->lastSeen = atomic_load_explicit(wakeup->doorbell, memory_order_acquire);
+            return 0;
+        
+        default:
+            return -1;
+    }
+}
+
+int effect_wakeup_signal(effect_wakeup_t* wakeup) {
+    if (wakeup->type == EFFECT_WAKEUP_EVENTFD) {
+        return effect_eventfd_signal(wakeup->eventFd);
+    }
+    
+    // Ring first, then look for sleepers. Both sides use seq_cst so either
+    // the waiter sees the new doorbell value or we see it registered.
+    atomic_fetch_add_explicit(wakeup->doorbell, 1, memory_order_seq_cst);
+    if (atomic_load_explicit(wakeup->waiters, memory_order_seq_cst) != 0) {
+        return futex_wake(wakeup->doorbell) < 0 ? -1 : 0;
+    }
+    return 0;
+}
+
+static bool doorbell_rang(effect_wakeup_t* wakeup) {
+    uint32_t value = atomic_load_explicit(wakeup->doorbell, memory_order_acquire);
+    if (value != wakeup->lastSeen) {
+        wakeup->lastSeen = value;
+        return true;
+    }
+    return false;
+}
+
+static int eventfd_wait_us(int fd, int64_t timeoutUs) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    
+    struct timespec ts;
+    struct timespec* tsp = NULL;
+    if (timeoutUs >= 0) {
+        us_to_timespec(timeoutUs, &ts);
+        tsp = &ts;
+    }
+    
+    int ret = ppoll(&pfd, 1, tsp, NULL);
+    if (ret <= 0) {
+        return -1; // Timeout or error
+    }
+    
+    // Read the eventfd to clear it
+    uint64_t val;
+    ssize_t read_ret = read(fd, &val, sizeof(val));
+    return (read_ret == sizeof(val)) ? 0 : -1;
+}
+
+int effect_wakeup_wait(effect_wakeup_t* wakeup, int64_t timeoutUs) {
+    if (wakeup->type == EFFECT_WAKEUP_EVENTFD) {
+        return eventfd_wait_us(wakeup->eventFd, timeoutUs);
+    }
+    
+    if (doorbell_rang(wakeup)) {
+        return 0;
+    }
+    if (timeoutUs == 0) {
+        return -1;
+    }
+    
+    int64_t now = get_time_us();
+    int64_t deadline = (timeoutUs > 0) ? now + timeoutUs : INT64_MAX;
+    
+    if (wakeup->type == EFFECT_WAKEUP_SPIN_FUTEX && wakeup->spinUs > 0) {
+        int64_t spinEnd = now + wakeup->spinUs;
+        if (spinEnd > deadline) {
+            spinEnd = deadline;
+        }
+        do {
+            effect_cpu_relax();
+            if (doorbell_rang(wakeup)) {
+                return 0;
+            }
+        } while (get_time_us() < spinEnd);
+    }
+    
+    for (;;) {
+        atomic_fetch_add_explicit(wakeup->waiters, 1, memory_order_seq_cst);
+        uint32_t value = atomic_load_explicit(wakeup->doorbell, memory_order_seq_cst);
+        if (value == wakeup->lastSeen) {
+            int64_t remaining = -1;
+            if (deadline != INT64_MAX) {
+                remaining = deadline - get_time_us();
+                if (remaining < 0) {
+                    remaining = 0;
+                }
+            }
+            if (remaining != 0) {
+                futex_wait(wakeup->doorbell, value, remaining);
+            }
+        }
+        atomic_fetch_sub_explicit(wakeup->waiters, 1, memory_order_seq_cst);
+        
+        if (doorbell_rang(wakeup)) {
+            return 0;
+        }
+        if (get_time_us() >= deadline) {
+            return -1;
+        }
+        // Spurious or interrupted wakeup - sleep again
+    }
+}
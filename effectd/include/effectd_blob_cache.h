@@ -0,0 +1,82 @@
+#ifndef EFFECTD_BLOB_CACHE_H
+#define EFFECTD_BLOB_CACHE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EFFECTD_BLOB_MAX_SIZE (256ull * 1024 * 1024)
+
+/**
+ * Read-only mappings of large parameter values (models, tables), shared
+ * by content
+ *
+ * A blob comes from a sealed memfd the client passed, or from a file the
+ * client opened, which effectd copies once into a sealed memfd of its own:
+ * nobody can change or truncate the content under a mapping. Blobs are
+ * mapped read-only and prefaulted once. They are keyed by a hash of their
+ * content (confirmed byte for byte), so every session loading the same
+ * model shares one mapping however the model was handed over; the mapping
+ * goes away with its last reference.
+ */
+typedef struct EffectdBlobCache EffectdBlobCache;
+typedef struct EffectdBlob EffectdBlob;
+
+EffectdBlobCache* effectd_blob_cache_create(void);
+
+/**
+ * Free the cache; every blob must have been released
+ */
+void effectd_blob_cache_destroy(EffectdBlobCache* cache);
+
+/**
+ * Get the blob holding the content of a sealed memfd
+ *
+ * fd must be sealed against writing, shrinking and growing (F_SEAL_WRITE,
+ * F_SEAL_SHRINK, F_SEAL_GROW) so its content cannot change under the
+ * mapping. The caller keeps fd.
+ *
+ * @return Blob with one reference for the caller, or NULL if fd is not
+ *         sealed, empty or larger than EFFECTD_BLOB_MAX_SIZE
+ */
+EffectdBlob* effectd_blob_cache_get_fd(EffectdBlobCache* cache, int fd);
+
+/**
+ * Get the blob holding the current content of a regular file
+ *
+ * The content is copied into a sealed memfd, once per version of the file:
+ * a file with the same device, inode, size and modification time as one
+ * already copied gets the same blob. The caller keeps fd.
+ *
+ * @param fd Regular file opened for reading by the client
+ * @return Blob with one reference for the caller, or NULL if fd is not a
+ *         regular file, is empty or larger than EFFECTD_BLOB_MAX_SIZE, or
+ *         changed while being copied
+ */
+EffectdBlob* effectd_blob_cache_get_file(EffectdBlobCache* cache, int fd);
+
+/**
+ * Take another reference
+ */
+void effectd_blob_acquire(EffectdBlob* blob);
+
+/**
+ * Drop a reference; the last one unmaps the blob
+ */
+void effectd_blob_release(EffectdBlob* blob);
+
+const void* effectd_blob_get_data(const EffectdBlob* blob);
+uint64_t effectd_blob_get_size(const EffectdBlob* blob);
+
+/**
+ * Number of distinct blobs mapped
+ */
+uint32_t effectd_blob_cache_get_count(EffectdBlobCache* cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECTD_BLOB_CACHE_H
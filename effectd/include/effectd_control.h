@@ -0,0 +1,89 @@
+#ifndef EFFECTD_CONTROL_H
+#define EFFECTD_CONTROL_H
+
+#include "effectd_session.h"
+#include "effectd_registry.h"
+#include "effectd_blob_cache.h"
+#include "effectd_zygote.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct EffectdWorkerPool;
+struct EffectdPoller;
+struct EffectdWatchdog;
+
+/**
+ * IEffectService over a Unix domain socket (see effect_control.h)
+ *
+ * One thread accepts clients and serves every connection's requests in
+ * order. Sessions opened on a connection are registered in the registry
+ * and attached to the given dispatchers; they and the pools the client
+ * registered are released when the connection closes, so a crashed client
+ * leaves nothing behind.
+ *
+ * With a zygote, clients are instead handed a connection to the process
+ * hosting each library (EFFECT_CONTROL_OP_CONNECT), where a control plane
+ * created with effectd_control_create_host serves them.
+ */
+typedef struct EffectdControl EffectdControl;
+
+/**
+ * Create the listening socket at path
+ *
+ * The socket is only accessible to effectd's user and group (0660), and
+ * connections from other users are refused. Its directory is created
+ * (0770) if missing. A stale socket file at path is replaced, but the
+ * call fails if another effectd still answers on it. The socket may be
+ * created before forking, so that the processes serving it can take turns
+ * (see effectd_supervisor.h) while clients queue on it.
+ *
+ * @return Listening socket, or -1 on failure
+ */
+int effectd_control_listen(const char* path);
+
+/**
+ * Start serving clients that connect to listenFd
+ *
+ * @param listenFd Socket from effectd_control_listen, owned by the control
+ *                 plane on success
+ * @param zygote Library hosts to hand out connections to, or NULL to run
+ *               every library in this process
+ * @param registry Registry that assigns session IDs
+ * @param blobCache Cache serving setParamBlob values
+ * @param workerPool Worker pool for new sessions, or NULL
+ * @param poller Busy-poll dispatcher for new sessions, or NULL
+ * @param watchdog Hung-call watchdog for new sessions, or NULL
+ * @return Control plane, or NULL on failure
+ */
+EffectdControl* effectd_control_create(int listenFd, EffectdZygote* zygote,
+                                       EffectdRegistry* registry, EffectdBlobCache* blobCache,
+                                       struct EffectdWorkerPool* workerPool,
+                                       struct EffectdPoller* poller,
+                                       struct EffectdWatchdog* watchdog);
+
+/**
+ * Start serving in a library host: clients arrive as connections effectd
+ * hands over on brokerFd (EFFECT_CONTROL_OP_ADOPT)
+ *
+ * @param brokerFd Connection from effectd, owned by the control plane
+ *                 (closed on failure)
+ * @return Control plane, or NULL on failure
+ */
+EffectdControl* effectd_control_create_host(int brokerFd, EffectdRegistry* registry,
+                                            EffectdBlobCache* blobCache,
+                                            struct EffectdWorkerPool* workerPool,
+                                            struct EffectdWatchdog* watchdog);
+
+/**
+ * Stop serving and close every connection (and with it its sessions); the
+ * socket file is left to whoever created it
+ */
+void effectd_control_destroy(EffectdControl* control);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECTD_CONTROL_H
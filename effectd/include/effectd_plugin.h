@@ -0,0 +1,57 @@
+#ifndef EFFECTD_PLUGIN_H
+#define EFFECTD_PLUGIN_H
+
+#include <stdint.h>
+#include "effect_plugin.h"
+#include "effectd_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Load a plugin and resolve every entry point
+ *
+ * Optional entry points the plugin does not export are left NULL.
+ *
+ * @param path Library path or name, as accepted by dlopen
+ * @param api Function table to fill
+ * @return dlopen handle, or NULL if the library is missing, lacks an entry
+ *         point or was built against an incompatible ABI version
+ */
+void* effectd_plugin_load(const char* path, EffectPluginApi* api);
+
+/**
+ * Unload a plugin loaded by effectd_plugin_load
+ */
+void effectd_plugin_unload(void* handle);
+
+/**
+ * Load every effect type's library ahead of the first session, page it in
+ * and keep it loaded, so opening a session does not pay for dlopen,
+ * relocation or page faults (a standby effectd does this before it is
+ * promoted, and library hosts inherit it from the zygote). Libraries that
+ * cannot be loaded are skipped and fail at open as usual.
+ */
+void effectd_plugin_preload(void);
+
+/**
+ * Override the library used for an effect type (e.g. to point effectd at
+ * the sample plugins on a development host)
+ *
+ * @return 0 on success, -1 for an unknown type
+ */
+int effectd_plugin_set_library(EffectLibType type, const char* path);
+
+/**
+ * Library path used for an effect type
+ *
+ * @return Path, or NULL for an unknown type
+ */
+const char* effectd_plugin_get_library(EffectLibType type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECTD_PLUGIN_H
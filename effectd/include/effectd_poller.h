@@ -0,0 +1,91 @@
+#ifndef EFFECTD_POLLER_H
+#define EFFECTD_POLLER_H
+
+#include <stdint.h>
+#include "effectd_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Upper bound on sessions served by one poller
+#define EFFECTD_POLLER_MAX_SESSIONS 64
+
+/**
+ * Busy-poll dispatcher for a dedicated core
+ *
+ * One thread pinned to one CPU sweeps the input rings of all its sessions
+ * round robin and processes whatever is queued, without ever sleeping on a
+ * wakeup. Input signals are ignored, so the wakeup latency is one sweep
+ * instead of a scheduler wakeup. With futex wakeups neither side makes a
+ * syscall in steady state (the HAL only enters the kernel when it is asleep
+ * itself); eventfd sessions are served too but still cost a write per
+ * output period.
+ *
+ * Fairness: a session gets at most periodsPerTurn periods per sweep and the
+ * sweep starts one session further along each time, so a session with a
+ * deep backlog cannot delay the others by more than one quantum each.
+ * Within a sweep the ready sessions run earliest deadline first.
+ *
+ * Idle backoff: when a sweep finds nothing, the pause between sweeps grows
+ * exponentially (CPU relax hints, no syscalls) to ease the load on the
+ * rings' cache lines. After idleSpinUs without work the poller naps
+ * idleSleepUs between sweeps, if that is non-zero.
+ *
+ * The poller never yields its CPU while busy-polling: the CPU must be
+ * isolated (isolcpus/cpusets) and must not run anything else.
+ */
+typedef struct EffectdPoller EffectdPoller;
+
+typedef struct {
+    int cpu;                   // CPU to pin to, -1 to leave the affinity alone
+    int rtPriority;            // SCHED_FIFO priority, 0 to keep the default policy
+    uint32_t periodsPerTurn;   // Periods per session per sweep, 0 for 1
+    uint32_t idleSpinUs;       // Busy-poll this long after the last period, 0 for ever
+    uint32_t idleSleepUs;      // Nap between sweeps once past idleSpinUs, 0 for none
+} EffectdPollerConfig;
+
+/**
+ * Start a poller thread
+ *
+ * @return Poller, or NULL on failure
+ */
+EffectdPoller* effectd_poller_create(const EffectdPollerConfig* config);
+
+/**
+ * Stop the poller thread and free it
+ *
+ * All sessions must have been removed first.
+ */
+void effectd_poller_destroy(EffectdPoller* poller);
+
+/**
+ * Start polling a session
+ *
+ * @return 0 on success, -1 if the poller is full
+ */
+int effectd_poller_add_session(EffectdPoller* poller, EffectSession* session);
+
+/**
+ * Stop polling a session
+ *
+ * The caller clears session->threadRunning first. Returns once the poller
+ * no longer references the session.
+ */
+void effectd_poller_remove_session(EffectdPoller* poller, EffectSession* session);
+
+/**
+ * Replace the poller thread, stuck in a library call (watchdog only)
+ *
+ * The stuck thread is abandoned (effectd_sched_abandon_thread) and a new
+ * one carries on sweeping.
+ *
+ * @return 0 on success, -1 if no thread could be started
+ */
+int effectd_poller_replace_thread(EffectdPoller* poller);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECTD_POLLER_H
@@ -0,0 +1,81 @@
+#ifndef EFFECTD_REGISTRY_H
+#define EFFECTD_REGISTRY_H
+
+#include <stdint.h>
+#include "effectd_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Slot index bits of a session ID; the rest is the slot's generation
+#define EFFECTD_REGISTRY_SLOT_BITS 10
+#define EFFECTD_REGISTRY_MAX_SESSIONS (1u << EFFECTD_REGISTRY_SLOT_BITS)
+
+/**
+ * Table of open sessions, indexed by session ID
+ *
+ * A session ID is (generation << EFFECTD_REGISTRY_SLOT_BITS) | slot. The
+ * slot gives O(1) lookup; the generation is bumped every time a slot is
+ * reused, so a stale ID from a closed session (or a confused client) fails
+ * lookup instead of reaching whichever session took the slot next. 0 is
+ * never a valid ID.
+ *
+ * Lookups are lock free: a reader pins the session with a per-slot
+ * reference count that shares one atomic word with the slot's ID, so
+ * control-plane calls (start, stop, setParam, queryStats) contend only with
+ * other calls on the same session, and never with the data plane, which
+ * does not touch the registry at all. Adding and removing sessions take a
+ * mutex; removal waits for the session's readers to drain.
+ */
+typedef struct EffectdRegistry EffectdRegistry;
+
+EffectdRegistry* effectd_registry_create(void);
+
+/**
+ * Free the table (the sessions in it are not destroyed)
+ */
+void effectd_registry_destroy(EffectdRegistry* registry);
+
+/**
+ * Register a session and assign its ID (also stored in session->sessionId)
+ *
+ * @return Session ID, or 0 if the table is full
+ */
+uint32_t effectd_registry_add(EffectdRegistry* registry, EffectSession* session);
+
+/**
+ * Look up and pin a session
+ *
+ * The session stays valid until effectd_registry_release.
+ *
+ * @return Session, or NULL if the ID is unknown, stale or being removed
+ */
+EffectSession* effectd_registry_acquire(EffectdRegistry* registry, uint32_t sessionId);
+
+/**
+ * Unpin a session returned by effectd_registry_acquire
+ */
+void effectd_registry_release(EffectdRegistry* registry, uint32_t sessionId);
+
+/**
+ * Unregister a session
+ *
+ * New lookups fail immediately; returns once every pinned reference has
+ * been released, so the caller may then destroy the session. Must not be
+ * called while holding a reference to the same session.
+ *
+ * @return Session that was registered under the ID, or NULL if none
+ */
+EffectSession* effectd_registry_remove(EffectdRegistry* registry, uint32_t sessionId);
+
+/**
+ * Number of registered sessions
+ */
+uint32_t effectd_registry_get_count(EffectdRegistry* registry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECTD_REGISTRY_H
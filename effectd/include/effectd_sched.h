@@ -0,0 +1,151 @@
+#ifndef EFFECTD_SCHED_H
+#define EFFECTD_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Scheduling class for a session's processing thread
+ */
+typedef enum {
+    EFFECTD_SCHED_OTHER = 0,      // Default time-sharing policy
+    EFFECTD_SCHED_FIFO = 1,       // SCHED_FIFO at priority
+    EFFECTD_SCHED_DEADLINE = 2,   // SCHED_DEADLINE: budgetUs every audio period
+} EffectdSchedClass;
+
+/**
+ * Per-effect-type scheduling policy
+ *
+ * budgetUs is the CPU time the effect type declares it needs per audio
+ * period (worst case). A session's share of a CPU is budgetUs divided by
+ * its period (framesPerBuffer / sampleRate); the admission controller keeps
+ * the sum of the shares of all open sessions within the configured
+ * capacity. A budget of 0 declares nothing and is always admitted.
+ *
+ * The thread settings (class, priority, cpuMask) apply to the thread the
+ * session is processed on. The worker pool and the busy-poll dispatcher run
+ * every session at SCHED_FIFO, EFFECTD_SCHED_DEFAULT_PRIORITY on their own
+ * CPUs, so only sessions whose grant asks for exactly that are placed on
+ * them (see effectd_sched_fits_shared); the others, including downgraded
+ * ones, get a dedicated thread.
+ */
+typedef struct {
+    EffectdSchedClass schedClass;
+    int priority;             // SCHED_FIFO priority (1-99)
+    uint32_t budgetUs;        // Declared CPU time per audio period, 0 for none
+    uint64_t cpuMask;         // CPUs the thread may run on, 0 for any
+    bool downgrade;           // Over budget: admit as SCHED_OTHER instead of rejecting
+} EffectdSchedPolicy;
+
+/**
+ * What a session was admitted with; released when the session goes away
+ */
+typedef struct {
+    EffectdSchedPolicy policy;    // Effective policy (downgraded if over budget)
+    uint32_t periodUs;            // Audio period of the session
+    uint32_t sharePpm;            // CPU share reserved, parts per million of a CPU
+    bool admitted;
+} EffectdSchedGrant;
+
+#define EFFECTD_SCHED_DEFAULT_PRIORITY 10
+#define EFFECTD_SCHED_DEFAULT_CAPACITY_PCT 90   // Of every online CPU
+
+/**
+ * Set the scheduling policy for an effect type
+ *
+ * @param type EffectLibType
+ * @return 0 on success, -1 for an unknown type or invalid policy
+ */
+int effectd_sched_set_policy(uint32_t type, const EffectdSchedPolicy* policy);
+
+/**
+ * Scheduling policy of an effect type
+ *
+ * @return 0 on success, -1 for an unknown type
+ */
+int effectd_sched_get_policy(uint32_t type, EffectdSchedPolicy* policy);
+
+/**
+ * Set the total CPU share admission may hand out
+ *
+ * @param percent Percent of one CPU (e.g. 360 for 90% of four CPUs)
+ */
+void effectd_sched_set_capacity(uint32_t percent);
+
+/**
+ * Move the admission ledger to memory shared with processes forked later
+ *
+ * Must be called before forking the library hosts (-i), so that their
+ * sessions are admitted against one budget rather than each host against
+ * the whole capacity. Policies are not shared: set them before forking.
+ *
+ * @return 0 on success, -1 if the ledger stays private to this process
+ */
+int effectd_sched_share_ledger(void);
+
+/**
+ * Return the shares reserved by a process that died
+ *
+ * @param pid Library host that is gone
+ */
+void effectd_sched_forget(pid_t pid);
+
+/**
+ * Admit a session of an effect type against the budget
+ *
+ * @param type EffectLibType
+ * @param sampleRate Session sample rate in Hz
+ * @param framesPerBuffer Session period in frames
+ * @param grant Output: effective policy and reserved share
+ * @return 0 if admitted (possibly downgraded), -1 if rejected
+ */
+int effectd_sched_admit(uint32_t type, uint32_t sampleRate, uint32_t framesPerBuffer,
+                        EffectdSchedGrant* grant);
+
+/**
+ * Return a grant's share to the budget (no-op if not admitted)
+ */
+void effectd_sched_release(EffectdSchedGrant* grant);
+
+/**
+ * CPU share currently reserved by every process sharing the ledger, parts
+ * per million of a CPU
+ */
+uint64_t effectd_sched_get_reserved_ppm(void);
+
+/**
+ * Apply a grant's policy to the calling thread (best effort)
+ *
+ * SCHED_DEADLINE falls back to SCHED_FIFO at the policy's priority if the
+ * kernel refuses it (e.g. because the thread's affinity is restricted).
+ *
+ * @return 0 if the requested class was applied, -1 if it fell back
+ */
+int effectd_sched_apply(const EffectdSchedGrant* grant);
+
+/**
+ * Whether a grant asks for nothing but what the shared dispatchers (worker
+ * pool, busy-poll) give every session: SCHED_FIFO at the default priority,
+ * on any CPU
+ */
+bool effectd_sched_fits_shared(const EffectdSchedGrant* grant);
+
+/**
+ * Let go of a processing thread stuck in a library call
+ *
+ * The thread is demoted to SCHED_IDLE, so that a call spinning forever only
+ * gets CPU time nothing else wants, and detached; it must not be joined.
+ */
+void effectd_sched_abandon_thread(pthread_t thread);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECTD_SCHED_H
@@ -17,6 +17,15 @@ typedef void* EffectFmqHandle;
 #endif
 
 #include "effect_ringbuffer.h"
+#include "effect_shared_memory.h"
+#include "effect_wakeup.h"
+#include "effect_plugin.h"
+#include "effect_seqlock.h"
+#include "effect_histogram.h"
+#include "effect_arena.h"
+#include "effect_shm_pool.h"
+#include "effect_command.h"
+#include "effectd_sched.h"
 
 // Use FMQ by default on Android, fallback to shared memory on other platforms
 #ifndef USE_SHARED_MEMORY
@@ -25,6 +34,11 @@ typedef void* EffectFmqHandle;
 #define USE_FMQ 0
 #endif
 
+#define EFFECTD_SESSION_MAX_BLOBS 8   // Blob parameters held at once
+#define EFFECTD_SESSION_MAX_PARAMS 16       // Parameters kept for replay
+#define EFFECTD_SESSION_MAX_PARAM_SIZE 256  // Larger values are not replayed
+#define EFFECTD_SESSION_CALL_TIMEOUT_MS 1000 // Longest wait for a control-side library call
+
 typedef enum {
     SESSION_STATE_IDLE = 0,
     SESSION_STATE_OPENED = 1,
@@ -43,6 +57,7 @@ typedef struct {
     uint32_t channels;
     uint32_t format;
     uint32_t framesPerBuffer;
+    uint32_t wakeupType;      // EffectWakeupType
 } AudioConfig;
 
 typedef struct {
@@ -53,8 +68,48 @@ typedef struct {
     uint32_t maxLatencyUs;
     uint32_t timeoutCount;
     uint32_t xrunCount;
+    uint32_t p50LatencyUs;
+    uint32_t p99LatencyUs;
+    uint32_t p999LatencyUs;   // 99.9th percentile
+    uint32_t deadlineMissCount; // Periods finished after their deadline
+    uint32_t hungCallCount;     // Library calls abandoned by the watchdog
 } SessionStats;
 
+/**
+ * A parameter value as last set, replayed into a replacement context
+ */
+typedef struct {
+    uint64_t serial;                  // When it was set, across both tables
+    uint32_t key;
+    uint32_t valueSize;
+    bool kept;                        // false: too large to keep, not replayed
+    uint8_t value[EFFECTD_SESSION_MAX_PARAM_SIZE];
+} EffectdParam;
+
+/**
+ * Memory the library works in for a period: wrap scratch and planar staging
+ *
+ * Output is produced here and only copied into the output queue once the
+ * library calls returned in time. A thread stuck in the library keeps its
+ * set and the session carries on with a fresh one, so a call that returns
+ * late only writes into memory nobody reads any more.
+ */
+typedef struct {
+    effect_arena_t arena;             // Own mapping, if not in the session's arena
+    bool ownArena;
+    uint8_t* scratchIn;               // Input period that wraps around its queue
+    uint8_t* scratchOut;              // Output period
+    uint8_t* planarIn;                // Planar staging (EFFECT_PLUGIN_LAYOUT_PLANAR only)
+    uint8_t* planarOut;
+    void** inPlanes;
+    void** outPlanes;
+} EffectdCallBuffers;
+
+struct EffectdWorkerPool;
+struct EffectdPoller;
+struct EffectdWatchdog;
+struct EffectdBlob;
+
 typedef struct EffectSession {
     uint32_t sessionId;
     EffectLibType effectType;
@@ -66,46 +121,160 @@ typedef struct EffectSession {
     EffectFmqHandle inputFmq;
     EffectFmqHandle outputFmq;
 #else
-    // Shared memory (legacy)
+    // Shared memory (legacy): a private mapping, or the client's slab pool
+    int shmFd;
     void* shmAddr;
     size_t shmSize;
+    EffectShmPool* shmPool;           // Referenced, not mapped, per session
     
-    // Ring buffers
+    // Ring buffers (attached to headers created by the client)
     effect_ringbuffer_t inputRb;
     effect_ringbuffer_t outputRb;
+    
+    // In-band commands (effect_command.h), drained by the processing context
+    effect_ringbuffer_t commandRb;
+    bool hasCommandRing;
 #endif
     
-    // Event FDs
+    // Event FDs (EFFECT_WAKEUP_EVENTFD only)
     int eventFdIn;   // HAL -> effectd
     int eventFdOut;  // effectd -> HAL
     
-    // Third-party library handle
+    // Wakeup endpoints: we wait on the input ring and signal the output ring
+    effect_wakeup_t inputWakeup;
+    effect_wakeup_t outputWakeup;
+    
+    // Third-party library handle, resolved plugin entry points and context
     void* libHandle;
     void* libContext;
+    effect_atomic_u32_t contextReady; // 0 while the watchdog builds a replacement
+    EffectPluginApi plugin;
+    uint32_t pluginLayout;            // EffectPluginLayout accepted by create
+    bool bypassed;                    // Input passed through (EFFECT_COMMAND_BYPASS)
+    pthread_mutex_t contextLock;      // Control calls into libContext vs. the watchdog
+    
+    // Control-side library calls each run on a thread of their own, and are
+    // given up on after EFFECTD_SESSION_CALL_TIMEOUT_MS; one that overran
+    // keeps its context until it returns
+    pthread_mutex_t callLock;
+    pthread_cond_t callCond;          // A control-side call returned
+    void* stuckContext;               // Context of a call given up on, NULL if none
+    bool retireStuck;                 // The session let go of stuckContext
+    
+    // Parameters set so far, for a replacement context. Control calls
+    // record theirs under contextLock. In-band commands are recorded by the
+    // processing context, which must never wait, under a seqlock it alone
+    // writes. The entry with the highest serial of a key is the latest.
+    EffectdParam params[EFFECTD_SESSION_MAX_PARAMS];
+    uint32_t numParams;
+    EffectdParam streamParams[EFFECTD_SESSION_MAX_PARAMS];
+    uint32_t numStreamParams;
+    effect_seqlock_t streamParamsLock;
+    effect_atomic_u64_t paramSerial;
+    
+    // Blob parameters the plugin uses in place, mapped until replaced or destroy
+    struct EffectdBlob* blobs[EFFECTD_SESSION_MAX_BLOBS];
+    uint32_t blobKeys[EFFECTD_SESSION_MAX_BLOBS];
+    uint32_t numBlobs;
+    
+    // Buffers of the periods to come; replaced along with the context
+    EffectdCallBuffers* buffers;
     
-    // Processing thread
+    // Processing thread (or busy-poll dispatcher / worker pool when set)
     pthread_t processingThread;
+    effect_atomic_u32_t threadActive; // Processing thread not yet exited
     bool threadRunning;
+    struct EffectdWorkerPool* workerPool;
+    bool pooled;
+    effect_atomic_u32_t scheduled;    // Queued on or running in a pool worker
+    struct EffectdPoller* poller;
+    bool polled;
+    EffectdSchedGrant schedGrant;     // From admission control at open
     
-    // Statistics
+    // Hung-call detection: start of the library calls of the period in
+    // flight (CLOCK_MONOTONIC us), 0 if none, EFFECTD_SESSION_CALL_ABANDONED
+    // while the watchdog replaces the context
+    struct EffectdWatchdog* watchdog;
+    effect_atomic_u64_t callStartUs;
+    effect_atomic_u32_t refs;         // The owner, plus each abandoned call
+    
+    // Prefaulted, mlocked arena holding this struct and the first buffers
+    effect_arena_t arena;
+    
+    // Period geometry
+    uint32_t bytesPerFrame;
+    uint32_t bufferSize;
+    uint32_t periodUs;                // framesPerBuffer / sampleRate, 0 if unknown
+    int64_t deadlineUs;               // Deadline of the oldest queued period, 0 if none
+    
+    // Statistics; latency fields are derived from latencyHist when read
     SessionStats stats;
-    pthread_mutex_t statsMutex;
+    effect_histogram_t latencyHist;
+    effect_seqlock_t statsLock;       // Written only by the processing context
+    
+    // Snapshot taken by the previous effectd_session_get_interval_stats()
+    pthread_mutex_t intervalMutex;    // Readers only
+    SessionStats intervalStats;
+    effect_histogram_t intervalHist;
     
 } EffectSession;
 
+#define EFFECTD_SESSION_CALL_ABANDONED UINT64_MAX
+
 /**
  * Create a new effect session
+ * 
+ * All per-session buffers are allocated here, sized from config, so
+ * nothing is allocated or faulted in once the session is started.
  */
 EffectSession* effectd_session_create(uint32_t sessionId, EffectLibType effectType, 
                                       const AudioConfig* config);
 
 /**
- * Open session and initialize third-party library
+ * Open session: load the effect type's plugin and create its context
+ * 
+ * @return 0 on success, -1 if the plugin is missing, incompatible or
+ *         rejects the configuration
  */
 int effectd_session_open(EffectSession* session);
 
+#if !USE_FMQ
+/**
+ * Attach the session to the client's shared memory rings
+ * 
+ * Maps shmFd and validates the ring headers described by layout. On success
+ * the session takes ownership of shmFd, eventFdIn and eventFdOut. The event
+ * FDs are only required for EFFECT_WAKEUP_EVENTFD sessions and may be -1
+ * otherwise.
+ * Must be called after open and before start.
+ */
+int effectd_session_attach_shared_memory(EffectSession* session, int shmFd,
+                                         const EffectSharedMemoryLayout* layout,
+                                         int eventFdIn, int eventFdOut);
+
 /**
- * Start processing thread
+ * Attach the session to rings in a slab of the client's shared pool
+ * 
+ * The pool is imported once per client with effect_shm_pool_import; the
+ * layout's offsets are relative to the pool base and its size must be the
+ * pool size. The session takes a pool reference and ownership of the event
+ * FDs (which may be -1 for futex wakeups).
+ * Must be called after open and before start.
+ */
+int effectd_session_attach_pool(EffectSession* session, EffectShmPool* pool,
+                                const EffectSharedMemoryLayout* layout,
+                                int eventFdIn, int eventFdOut);
+#endif
+
+/**
+ * Start processing thread (after open, or again after stop)
+ * 
+ * Like the other calls below that call into the library from the control
+ * thread (open, stop, destroy, set_param, set_param_blob, get_latency),
+ * it waits at most EFFECTD_SESSION_CALL_TIMEOUT_MS for the library. A call
+ * that overruns is left to return on its own thread and the caller's call
+ * fails; until it returns, further library calls from the control thread
+ * fail at once.
  */
 int effectd_session_start(EffectSession* session);
 
@@ -125,6 +294,97 @@ void effectd_session_destroy(EffectSession* session);
 int effectd_session_set_param(EffectSession* session, uint32_t key, 
                               const void* value, uint32_t valueSize);
 
+/**
+ * Set a large parameter from a blob (see effectd_blob_cache.h)
+ * 
+ * Plugins with setParamBlob use the mapping in place; the session then
+ * keeps the caller's blob reference until the key is set again or the
+ * session is destroyed. Other plugins get a copy through setParam and the
+ * reference is dropped at once. Either way the session owns the reference
+ * on success; on failure the caller keeps it.
+ * 
+ * @return 0 on success, -1 if the plugin rejects the value or the session
+ *         holds EFFECTD_SESSION_MAX_BLOBS keys already
+ */
+int effectd_session_set_param_blob(EffectSession* session, uint32_t key,
+                                   struct EffectdBlob* blob);
+
+/**
+ * Algorithmic latency of the loaded library in frames, 0 if unknown
+ */
+uint32_t effectd_session_get_latency(EffectSession* session);
+
+/**
+ * Run the session on a shared worker pool instead of its own thread
+ * Must be called before start; pool may be NULL to use a dedicated thread.
+ */
+void effectd_session_set_worker_pool(EffectSession* session, struct EffectdWorkerPool* pool);
+
+/**
+ * Run the session on a busy-poll dispatcher; takes precedence over the
+ * worker pool. Must be called before start; poller may be NULL.
+ */
+void effectd_session_set_poller(EffectSession* session, struct EffectdPoller* poller);
+
+/**
+ * Have a watchdog abandon library calls that overrun (see effectd_watchdog.h)
+ * Must be called before start; watchdog may be NULL.
+ */
+void effectd_session_set_watchdog(EffectSession* session, struct EffectdWatchdog* watchdog);
+
+/**
+ * Abandon the library calls in flight since startUs (watchdog only)
+ * 
+ * The thread stuck in the library is left to it: the session moves to new
+ * buffers, and its dispatcher to a new thread. The stuck thread destroys
+ * the old context and buffers and exits if the call ever returns. Counted
+ * in hungCallCount.
+ * 
+ * A new context is then created with the session's configuration and
+ * parameters, like a control call: on a thread of its own, waited for at
+ * most EFFECTD_SESSION_CALL_TIMEOUT_MS. Until it is in place the session
+ * passes audio through and leaves in-band commands queued; if it cannot be
+ * had, the session passes audio through from then on.
+ * 
+ * @return 0 if abandoned, -1 if those calls are over, a control call is
+ *         using the context (it waits for the library at most
+ *         EFFECTD_SESSION_CALL_TIMEOUT_MS) or there is no memory for new
+ *         buffers; try again later
+ */
+int effectd_session_abandon_call(EffectSession* session, uint64_t startUs);
+
+/**
+ * Process every whole period currently queued (called by the session's
+ * processing context only)
+ * 
+ * @return Number of periods processed
+ */
+int effectd_session_process_pending(EffectSession* session);
+
+/**
+ * Process up to maxPeriods queued periods (processing context only)
+ * 
+ * @return Number of periods processed
+ */
+int effectd_session_process_periods(EffectSession* session, uint32_t maxPeriods);
+
+/**
+ * Check whether at least one whole input period is queued
+ */
+bool effectd_session_has_pending(EffectSession* session);
+
+/**
+ * Note that input is queued (processing context only)
+ * 
+ * If no period was queued before, the new one is due one period after
+ * nowUs; otherwise the deadline of the oldest queued period stands. Periods
+ * finished after their deadline are counted in deadlineMissCount.
+ * 
+ * @return Deadline of the oldest queued period (CLOCK_MONOTONIC us), 0 if
+ *         the session has no known period
+ */
+int64_t effectd_session_mark_ready(EffectSession* session, int64_t nowUs);
+
 /**
  * Query session state
  */
@@ -132,7 +392,17 @@ SessionState effectd_session_get_state(EffectSession* session);
 
 /**
  * Query session statistics
+ * 
+ * Latency percentiles come from a log-bucketed histogram (within 6.25%).
  */
 void effectd_session_get_stats(EffectSession* session, SessionStats* stats);
 
+/**
+ * Query session statistics for the interval since the previous call
+ * 
+ * Counters and latency figures only cover periods processed since the
+ * previous call (or since create for the first one).
+ */
+void effectd_session_get_interval_stats(EffectSession* session, SessionStats* stats);
+
 #endif // EFFECTD_SESSION_H
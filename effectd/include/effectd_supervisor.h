@@ -0,0 +1,48 @@
+#ifndef EFFECTD_SUPERVISOR_H
+#define EFFECTD_SUPERVISOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Hot-standby supervision
+ *
+ * The process effectd is started as becomes a supervisor that forks two
+ * effectd children: the active one, which serves clients, and a standby
+ * that initializes everything it can ahead of time (dispatchers, plugin
+ * libraries) and then waits. When the active child dies the standby is
+ * promoted at once and starts serving the listening socket the supervisor
+ * created before forking, where reconnecting clients are already queued;
+ * a new standby is then forked behind it. Clients reattach their sessions
+ * on their own, so processed audio is back within a few periods.
+ *
+ * Children die with the supervisor.
+ */
+
+/**
+ * Fork the children and supervise them until SIGTERM or SIGINT
+ *
+ * Returns in every child right after it is forked, with the signal mask
+ * and handlers main() set up; the child initializes and then calls
+ * effectd_supervisor_wait_promotion. In the supervisor it returns once the
+ * children have been stopped.
+ *
+ * @return 0 in a child, 1 in the supervisor after a clean stop, -1 in the
+ *         supervisor on failure
+ */
+int effectd_supervisor_run(void);
+
+/**
+ * Block a child until it is promoted to active (immediately for the first
+ * one)
+ *
+ * @return 0 once active, -1 if the supervisor is gone
+ */
+int effectd_supervisor_wait_promotion(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECTD_SUPERVISOR_H
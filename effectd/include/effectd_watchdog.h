@@ -0,0 +1,73 @@
+#ifndef EFFECTD_WATCHDOG_H
+#define EFFECTD_WATCHDOG_H
+
+#include <stdint.h>
+#include "effectd_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Upper bound on sessions watched by one watchdog
+#define EFFECTD_WATCHDOG_MAX_SESSIONS 256
+
+// Least time a period's library calls may take before they are abandoned
+#define EFFECTD_WATCHDOG_MIN_BUDGET_US 10000
+
+/**
+ * Hung-call watchdog
+ *
+ * A library call that never returns would otherwise hold its processing
+ * thread for good: every later period of the session times out in the
+ * client, and so do those of the other sessions on the same worker or
+ * poller. The watchdog thread checks the library calls of every started
+ * session's period in flight against a budget of a few periods. Calls that
+ * overrun it are abandoned (effectd_session_abandon_call): the session
+ * carries on on a new thread, passing audio through until it has a fresh
+ * context with its parameters, and the client sees a few late periods
+ * instead of a stall.
+ *
+ * The stuck thread is left to the library at idle priority. If the call
+ * ever returns, the thread destroys the old context and exits.
+ */
+typedef struct EffectdWatchdog EffectdWatchdog;
+
+/**
+ * Start a watchdog thread
+ *
+ * @param budgetPeriods Periods a period's library calls may take, at least
+ *                      EFFECTD_WATCHDOG_MIN_BUDGET_US
+ * @param rtPriority SCHED_FIFO priority for the watchdog, 0 to keep the
+ *                   default policy; it should preempt the dispatchers
+ * @return Watchdog, or NULL on failure
+ */
+EffectdWatchdog* effectd_watchdog_create(uint32_t budgetPeriods, int rtPriority);
+
+/**
+ * Stop the watchdog thread and free it
+ *
+ * All sessions must have been removed first.
+ */
+void effectd_watchdog_destroy(EffectdWatchdog* watchdog);
+
+/**
+ * Start watching a session
+ *
+ * @return 0 on success, -1 if watchdog is NULL or full
+ */
+int effectd_watchdog_add_session(EffectdWatchdog* watchdog, EffectSession* session);
+
+/**
+ * Stop watching a session
+ *
+ * Returns once the watchdog no longer references the session, with any
+ * abandonment in progress completed; that waits for the new context at
+ * most EFFECTD_SESSION_CALL_TIMEOUT_MS. No-op if watchdog is NULL.
+ */
+void effectd_watchdog_remove_session(EffectdWatchdog* watchdog, EffectSession* session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECTD_WATCHDOG_H
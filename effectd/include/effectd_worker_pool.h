@@ -0,0 +1,87 @@
+#ifndef EFFECTD_WORKER_POOL_H
+#define EFFECTD_WORKER_POOL_H
+
+#include <stdint.h>
+#include "effectd_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Upper bound on sessions served by one pool
+#define EFFECTD_WORKER_POOL_MAX_SESSIONS 256
+
+/**
+ * Pool of real-time worker threads shared by all sessions
+ *
+ * Each worker is pinned to one CPU and owns an epoll set with the input
+ * eventfds of the sessions homed on it, plus a run queue of sessions with
+ * pending periods. A worker drains its own run queue first and steals from
+ * its peers when idle, so a burst on one core spreads across the others
+ * instead of waiting behind a busy session. A session is queued at most
+ * once at a time and only ever runs on one worker at a time.
+ *
+ * Run queues are earliest deadline first: a period is due one session
+ * period after it arrived, and a worker runs one period of its most urgent
+ * session at a time, so a 2.5 ms voice stream is not held up behind a
+ * 20 ms music effect. Sessions finishing late count deadline misses.
+ *
+ * Only EFFECT_WAKEUP_EVENTFD sessions can be pooled; futex doorbells cannot
+ * be multiplexed through epoll.
+ */
+typedef struct EffectdWorkerPool EffectdWorkerPool;
+
+/**
+ * Create a worker pool
+ *
+ * @param numWorkers Number of workers, 0 for one per online CPU
+ * @param rtPriority SCHED_FIFO priority for the workers, 0 to keep the
+ *                   default policy
+ * @return Pool, or NULL on failure
+ */
+EffectdWorkerPool* effectd_worker_pool_create(uint32_t numWorkers, int rtPriority);
+
+/**
+ * Stop all workers and free the pool
+ *
+ * All sessions must have been removed first.
+ */
+void effectd_worker_pool_destroy(EffectdWorkerPool* pool);
+
+/**
+ * Start serving a session on the least loaded worker
+ *
+ * @return 0 on success, -1 if the session cannot be pooled or the pool is full
+ */
+int effectd_worker_pool_add_session(EffectdWorkerPool* pool, EffectSession* session);
+
+/**
+ * Stop serving a session
+ *
+ * The caller clears session->threadRunning first. Returns once no worker
+ * references the session any more.
+ */
+void effectd_worker_pool_remove_session(EffectdWorkerPool* pool, EffectSession* session);
+
+/**
+ * Replace the worker thread stuck running a session (watchdog only)
+ *
+ * The stuck thread is abandoned (effectd_sched_abandon_thread) and a new
+ * one takes over its epoll set and run queue, so the other sessions homed
+ * on it carry on. The session is queued again if it has input pending.
+ *
+ * @return 0 on success, -1 if no worker runs the session or no thread
+ *         could be started
+ */
+int effectd_worker_pool_replace_worker(EffectdWorkerPool* pool, EffectSession* session);
+
+/**
+ * Number of workers in the pool
+ */
+uint32_t effectd_worker_pool_get_size(const EffectdWorkerPool* pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECTD_WORKER_POOL_H
@@ -0,0 +1,63 @@
+#ifndef EFFECTD_ZYGOTE_H
+#define EFFECTD_ZYGOTE_H
+
+#include "effectd_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A process per plugin library, forked from a pre-initialized template
+ *
+ * The zygote is forked from effectd once the libraries are preloaded and
+ * prefaulted, while effectd is still single-threaded, and from then on
+ * only forks library hosts. A host serves the sessions of one effect type
+ * with its own dispatchers; it starts in milliseconds since it inherits
+ * the libraries already loaded, relocated and paged in. A crash in a
+ * library takes down its host and the sessions of that type only: their
+ * clients reattach, and the next connection spawns a new host.
+ *
+ * effectd hands clients connections to the hosts (EFFECT_CONTROL_OP_CONNECT);
+ * the hosts never see the listening socket. The zygote dies with effectd,
+ * and the hosts with the zygote.
+ */
+typedef struct EffectdZygote EffectdZygote;
+
+/**
+ * Body of a library host, run in the forked process
+ *
+ * @param type Effect type whose sessions the host serves
+ * @param brokerFd Connection from effectd, which hands over client
+ *                 connections on it (EFFECT_CONTROL_OP_ADOPT)
+ * @return Exit status
+ */
+typedef int (*EffectdHostMain)(EffectLibType type, int brokerFd);
+
+/**
+ * Fork the zygote and have it spawn a host for every effect type
+ *
+ * Must be called while the calling process has a single thread.
+ *
+ * @return Zygote, or NULL on failure
+ */
+EffectdZygote* effectd_zygote_create(EffectdHostMain hostMain);
+
+/**
+ * Stop the zygote, and with it every host
+ */
+void effectd_zygote_destroy(EffectdZygote* zygote);
+
+/**
+ * Open a connection to the host of an effect type, spawning a new host if
+ * the previous one died or does not answer in time (it is then killed)
+ *
+ * @return Client end of the connection, owned by the caller, or -1 on failure
+ */
+int effectd_zygote_connect(EffectdZygote* zygote, EffectLibType type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECTD_ZYGOTE_H
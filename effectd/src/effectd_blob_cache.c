@@ -0,0 +1,257 @@
+#include "effectd_blob_cache.h"
+#include "effect_shared_memory.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define REQUIRED_SEALS (F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW)
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ull
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4Full
+
+struct EffectdBlob {
+    struct EffectdBlob* next;
+    EffectdBlobCache* cache;
+    const void* data;
+    uint64_t size;
+    uint64_t hash;
+    uint32_t refs;                    // Guarded by cache lock
+    
+    // Version of the file last copied into this blob, if any (cache lock)
+    bool fromFile;
+    dev_t fileDev;
+    ino_t fileIno;
+    struct timespec fileMtime;
+};
+
+struct EffectdBlobCache {
+    pthread_mutex_t lock;
+    EffectdBlob* blobs;
+    uint32_t count;
+};
+
+static uint64_t rotl64(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+/**
+ * 64-bit content hash; a word at a time, since models run to megabytes.
+ * Only used to find candidates, so it need not resist collisions.
+ */
+static uint64_t hash_content(const uint8_t* data, uint64_t size) {
+    uint64_t h = size * HASH_PRIME_1;
+    uint64_t i = 0;
+    
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        h = rotl64(h ^ (word * HASH_PRIME_2), 31) * HASH_PRIME_1;
+    }
+    for (; i < size; i++) {
+        h = rotl64(h ^ (data[i] * HASH_PRIME_2), 11) * HASH_PRIME_1;
+    }
+    
+    // Final avalanche
+    h ^= h >> 33;
+    h *= HASH_PRIME_2;
+    h ^= h >> 29;
+    return h;
+}
+
+EffectdBlobCache* effectd_blob_cache_create(void) {
+    EffectdBlobCache* cache = (EffectdBlobCache*)calloc(1, sizeof(EffectdBlobCache));
+    if (!cache) {
+        return NULL;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void effectd_blob_cache_destroy(EffectdBlobCache* cache) {
+    if (!cache) {
+        return;
+    }
+    
+    if (cache->count > 0) {
+        syslog(LOG_WARNING, "%u parameter blobs still referenced", cache->count);
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+/**
+ * Map fd, then hand out the cached blob with the same content if there is
+ * one, or cache the new mapping
+ */
+static EffectdBlob* get_blob(EffectdBlobCache* cache, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        (uint64_t)st.st_size > EFFECTD_BLOB_MAX_SIZE) {
+        return NULL;
+    }
+    uint64_t size = (uint64_t)st.st_size;
+    
+    // Plugins read models on the processing path, so fault everything in now
+    void* data = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    uint64_t hash = hash_content((const uint8_t*)data, size);
+    
+    pthread_mutex_lock(&cache->lock);
+    for (EffectdBlob* blob = cache->blobs; blob; blob = blob->next) {
+        if (blob->hash == hash && blob->size == size && memcmp(blob->data, data, (size_t)size) == 0) {
+            blob->refs++;
+            pthread_mutex_unlock(&cache->lock);
+            munmap(data, (size_t)size);
+            return blob;
+        }
+    }
+    
+    EffectdBlob* blob = (EffectdBlob*)calloc(1, sizeof(EffectdBlob));
+    if (!blob) {
+        pthread_mutex_unlock(&cache->lock);
+        munmap(data, (size_t)size);
+        return NULL;
+    }
+    blob->cache = cache;
+    blob->data = data;
+    blob->size = size;
+    blob->hash = hash;
+    blob->refs = 1;
+    blob->next = cache->blobs;
+    cache->blobs = blob;
+    cache->count++;
+    pthread_mutex_unlock(&cache->lock);
+    return blob;
+}
+
+EffectdBlob* effectd_blob_cache_get_fd(EffectdBlobCache* cache, int fd) {
+    if (!cache || fd < 0) {
+        return NULL;
+    }
+    
+    // Anything less and the client could change the model under the mapping
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & REQUIRED_SEALS) != REQUIRED_SEALS) {
+        syslog(LOG_WARNING, "Rejected parameter blob that is not sealed");
+        return NULL;
+    }
+    
+    return get_blob(cache, fd);
+}
+
+static bool same_version(const EffectdBlob* blob, const struct stat* st) {
+    return blob->fromFile && blob->fileDev == st->st_dev && blob->fileIno == st->st_ino &&
+           blob->size == (uint64_t)st->st_size &&
+           blob->fileMtime.tv_sec == st->st_mtim.tv_sec &&
+           blob->fileMtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+EffectdBlob* effectd_blob_cache_get_file(EffectdBlobCache* cache, int fd) {
+    if (!cache || fd < 0) {
+        return NULL;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        (uint64_t)st.st_size > EFFECTD_BLOB_MAX_SIZE) {
+        return NULL;
+    }
+    
+    // This version of the file has been copied before
+    pthread_mutex_lock(&cache->lock);
+    for (EffectdBlob* blob = cache->blobs; blob; blob = blob->next) {
+        if (same_version(blob, &st)) {
+            blob->refs++;
+            pthread_mutex_unlock(&cache->lock);
+            return blob;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    
+    // The file's owner may still change or truncate it, so only a copy of
+    // our own is ever mapped; one that raced with a change is refused
+    int copy = effect_shared_memory_copy_sealed("effectd_blob", fd, (size_t)st.st_size);
+    struct stat after;
+    if (copy < 0 || fstat(fd, &after) < 0 || after.st_size != st.st_size ||
+        after.st_mtim.tv_sec != st.st_mtim.tv_sec || after.st_mtim.tv_nsec != st.st_mtim.tv_nsec) {
+        syslog(LOG_WARNING, "Failed to copy parameter file, or it changed meanwhile");
+        if (copy >= 0) {
+            close(copy);
+        }
+        return NULL;
+    }
+    
+    // The mapping outlives the copy's fd
+    EffectdBlob* blob = get_blob(cache, copy);
+    close(copy);
+    if (blob) {
+        pthread_mutex_lock(&cache->lock);
+        blob->fromFile = true;
+        blob->fileDev = st.st_dev;
+        blob->fileIno = st.st_ino;
+        blob->fileMtime = st.st_mtim;
+        pthread_mutex_unlock(&cache->lock);
+    }
+    return blob;
+}
+
+void effectd_blob_acquire(EffectdBlob* blob) {
+    if (!blob) {
+        return;
+    }
+    
+    pthread_mutex_lock(&blob->cache->lock);
+    blob->refs++;
+    pthread_mutex_unlock(&blob->cache->lock);
+}
+
+void effectd_blob_release(EffectdBlob* blob) {
+    if (!blob) {
+        return;
+    }
+    
+    EffectdBlobCache* cache = blob->cache;
+    pthread_mutex_lock(&cache->lock);
+    if (--blob->refs > 0) {
+        pthread_mutex_unlock(&cache->lock);
+        return;
+    }
+    for (EffectdBlob** link = &cache->blobs; *link; link = &(*link)->next) {
+        if (*link == blob) {
+            *link = blob->next;
+            break;
+        }
+    }
+    cache->count--;
+    pthread_mutex_unlock(&cache->lock);
+    
+    munmap((void*)blob->data, (size_t)blob->size);
+    free(blob);
+}
+
+const void* effectd_blob_get_data(const EffectdBlob* blob) {
+    return blob ? blob->data : NULL;
+}
+
+uint64_t effectd_blob_get_size(const EffectdBlob* blob) {
+    return blob ? blob->size : 0;
+}
+
+uint32_t effectd_blob_cache_get_count(EffectdBlobCache* cache) {
+    if (!cache) {
+        return 0;
+    }
+    
+    pthread_mutex_lock(&cache->lock);
+    uint32_t count = cache->count;
+    pthread_mutex_unlock(&cache->lock);
+    return count;
+}
@@ -0,0 +1,681 @@
+#include "effectd_control.h"
+#include "effectd_zygote.h"
+#include "effect_control.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define LISTEN_BACKLOG 16
+#define SOCKET_MODE 0660                  // effectd's user and group only
+#define SOCKET_DIR_MODE 0770
+#define MAX_PEER_GROUPS 64
+#define MAX_EVENTS 16
+#define MAX_POOLS_PER_CONNECTION 4
+
+typedef struct {
+    uint32_t id;
+    EffectShmPool* pool;
+} ImportedPool;
+
+/**
+ * One client; everything it opened goes away with it
+ */
+typedef struct Connection {
+    struct Connection* next;
+    int fd;
+    uint32_t* sessionIds;
+    uint32_t numSessions;
+    uint32_t sessionCapacity;
+    ImportedPool pools[MAX_POOLS_PER_CONNECTION];
+    uint32_t numPools;
+    bool broker;                      // A library host's connection from effectd
+} Connection;
+
+struct EffectdControl {
+    int listenFd;                     // -1 in a library host
+    int epollFd;
+    int stopFd;                       // eventfd, signalled by destroy
+    pthread_t thread;
+    
+    EffectdRegistry* registry;
+    EffectdBlobCache* blobCache;
+    struct EffectdWorkerPool* workerPool;
+    struct EffectdPoller* poller;
+    struct EffectdWatchdog* watchdog;
+    EffectdZygote* zygote;            // NULL when libraries run in this process
+    
+    // Service thread only
+    Connection* connections;
+    EffectControlMessage requests[EFFECT_CONTROL_MAX_BATCH];
+    EffectControlMessage replies[EFFECT_CONTROL_MAX_BATCH];
+};
+
+/**
+ * Whether fd's file is at least size bytes, so mapping size bytes of it
+ * cannot fault
+ */
+static bool fd_covers(int fd, uint64_t size) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && (uint64_t)st.st_size >= size;
+}
+
+static EffectShmPool* find_pool(Connection* conn, uint32_t poolId) {
+    for (uint32_t i = 0; i < conn->numPools; i++) {
+        if (conn->pools[i].id == poolId) {
+            return conn->pools[i].pool;
+        }
+    }
+    return NULL;
+}
+
+static int find_session(Connection* conn, uint32_t sessionId) {
+    for (uint32_t i = 0; i < conn->numSessions; i++) {
+        if (conn->sessionIds[i] == sessionId) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int32_t handle_register_pool(Connection* conn, EffectControlMessage* req) {
+    uint32_t poolId = req->header.id;
+    uint64_t size = req->body.pool.size;
+    int fd = req->fds[0];
+    
+    if (poolId == 0 || fd < 0 || size == 0 || find_pool(conn, poolId) || !fd_covers(fd, size)) {
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    if (conn->numPools == MAX_POOLS_PER_CONNECTION) {
+        return EFFECT_CONTROL_ERROR_NO_MEMORY;
+    }
+    
+    EffectShmPool* pool = effect_shm_pool_import(fd, (size_t)size);
+    if (!pool) {
+        return EFFECT_CONTROL_ERROR_NO_MEMORY;
+    }
+    req->fds[0] = -1;
+    
+    conn->pools[conn->numPools].id = poolId;
+    conn->pools[conn->numPools].pool = pool;
+    conn->numPools++;
+    return EFFECT_CONTROL_OK;
+}
+
+static int32_t handle_open(EffectdControl* control, Connection* conn,
+                           EffectControlMessage* req, EffectControlMessage* reply) {
+    const EffectControlOpenArgs* args = &req->body.open;
+    if (args->effectType > EFFECT_LIB_NOISE_REDUCTION) {
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    EffectShmPool* pool = NULL;
+    if (args->poolId != 0) {
+        pool = find_pool(conn, args->poolId);
+        if (!pool) {
+            return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+        }
+    } else if (req->fds[0] < 0 || !fd_covers(req->fds[0], args->layout.size)) {
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    if (conn->numSessions == conn->sessionCapacity) {
+        uint32_t capacity = conn->sessionCapacity ? conn->sessionCapacity * 2 : 4;
+        uint32_t* ids = (uint32_t*)realloc(conn->sessionIds, capacity * sizeof(uint32_t));
+        if (!ids) {
+            return EFFECT_CONTROL_ERROR_NO_MEMORY;
+        }
+        conn->sessionIds = ids;
+        conn->sessionCapacity = capacity;
+    }
+    
+    AudioConfig config;
+    config.sampleRate = args->sampleRate;
+    config.channels = args->channels;
+    config.format = args->format;
+    config.framesPerBuffer = args->framesPerBuffer;
+    config.wakeupType = args->wakeupType;
+    
+    EffectSession* session = effectd_session_create(0, (EffectLibType)args->effectType, &config);
+    if (!session) {
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    if (effectd_session_open(session) < 0) {
+        effectd_session_destroy(session);
+        return EFFECT_CONTROL_ERROR_NOT_SUPPORTED;
+    }
+    
+    int attached = pool ?
+        effectd_session_attach_pool(session, pool, &args->layout, req->fds[1], req->fds[2]) :
+        effectd_session_attach_shared_memory(session, req->fds[0], &args->layout,
+                                             req->fds[1], req->fds[2]);
+    if (attached < 0) {
+        effectd_session_destroy(session);
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    // The session owns the fds it attached; any others are closed with the request
+    if (!pool) {
+        req->fds[0] = -1;
+    }
+    req->fds[1] = -1;
+    req->fds[2] = -1;
+    
+    effectd_session_set_poller(session, control->poller);
+    effectd_session_set_worker_pool(session, control->workerPool);
+    effectd_session_set_watchdog(session, control->watchdog);
+    
+    uint32_t sessionId = effectd_registry_add(control->registry, session);
+    if (sessionId == 0) {
+        effectd_session_destroy(session);
+        return EFFECT_CONTROL_ERROR_NO_MEMORY;
+    }
+    
+    conn->sessionIds[conn->numSessions++] = sessionId;
+    reply->header.id = sessionId;
+    return EFFECT_CONTROL_OK;
+}
+
+static void close_session(EffectdControl* control, uint32_t sessionId) {
+    EffectSession* session = effectd_registry_remove(control->registry, sessionId);
+    if (session) {
+        effectd_session_destroy(session);
+    }
+}
+
+static int32_t handle_close(EffectdControl* control, Connection* conn, uint32_t sessionId) {
+    int index = find_session(conn, sessionId);
+    if (index < 0) {
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    conn->sessionIds[index] = conn->sessionIds[--conn->numSessions];
+    close_session(control, sessionId);
+    return EFFECT_CONTROL_OK;
+}
+
+static void copy_stats(EffectControlStats* out, const SessionStats* stats) {
+    memset(out, 0, sizeof(*out));
+    out->processedFrames = stats->processedFrames;
+    out->droppedFrames = stats->droppedFrames;
+    out->avgLatencyUs = stats->avgLatencyUs;
+    out->p95LatencyUs = stats->p95LatencyUs;
+    out->maxLatencyUs = stats->maxLatencyUs;
+    out->timeoutCount = stats->timeoutCount;
+    out->xrunCount = stats->xrunCount;
+    out->p50LatencyUs = stats->p50LatencyUs;
+    out->p99LatencyUs = stats->p99LatencyUs;
+    out->p999LatencyUs = stats->p999LatencyUs;
+    out->deadlineMissCount = stats->deadlineMissCount;
+    out->hungCallCount = stats->hungCallCount;
+}
+
+static int32_t set_param_blob(EffectdControl* control, EffectSession* session,
+                              const EffectControlMessage* req) {
+    const EffectControlBlobArgs* args = &req->body.blob;
+    EffectdBlob* blob;
+    
+    // effectd never opens files on a client's behalf; clients hand over fds
+    if (req->fds[0] < 0) {
+        blob = NULL;
+    } else if (args->flags & EFFECT_CONTROL_BLOB_FILE) {
+        blob = effectd_blob_cache_get_file(control->blobCache, req->fds[0]);
+    } else {
+        blob = effectd_blob_cache_get_fd(control->blobCache, req->fds[0]);
+    }
+    if (!blob) {
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    if (effectd_session_set_param_blob(session, args->key, blob) < 0) {
+        effectd_blob_release(blob);
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    return EFFECT_CONTROL_OK;
+}
+
+/**
+ * Calls on an existing session, which stays pinned for the duration
+ */
+static int32_t handle_session_op(EffectdControl* control, Connection* conn,
+                                 const EffectControlMessage* req, EffectControlMessage* reply) {
+    uint32_t sessionId = req->header.id;
+    if (find_session(conn, sessionId) < 0) {
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    EffectSession* session = effectd_registry_acquire(control->registry, sessionId);
+    if (!session) {
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    int32_t result = EFFECT_CONTROL_OK;
+    SessionStats stats;
+    
+    switch (req->header.op) {
+        case EFFECT_CONTROL_OP_START:
+            if (effectd_session_start(session) < 0) {
+                result = EFFECT_CONTROL_ERROR_INVALID_STATE;
+            }
+            break;
+        case EFFECT_CONTROL_OP_STOP:
+            if (effectd_session_stop(session) < 0) {
+                result = EFFECT_CONTROL_ERROR_INVALID_STATE;
+            }
+            break;
+        case EFFECT_CONTROL_OP_SET_PARAM:
+            if (req->body.param.valueSize == 0 ||
+                req->body.param.valueSize > EFFECT_CONTROL_MAX_PARAM_SIZE ||
+                effectd_session_set_param(session, req->body.param.key, req->body.param.value,
+                                          req->body.param.valueSize) < 0) {
+                result = EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+            }
+            break;
+        case EFFECT_CONTROL_OP_SET_PARAM_BLOB:
+            result = set_param_blob(control, session, req);
+            break;
+        case EFFECT_CONTROL_OP_QUERY_STATE:
+            reply->body.state = (uint32_t)effectd_session_get_state(session);
+            reply->header.payloadSize = sizeof(reply->body.state);
+            break;
+        case EFFECT_CONTROL_OP_QUERY_STATS:
+        case EFFECT_CONTROL_OP_QUERY_INTERVAL_STATS:
+            if (req->header.op == EFFECT_CONTROL_OP_QUERY_STATS) {
+                effectd_session_get_stats(session, &stats);
+            } else {
+                effectd_session_get_interval_stats(session, &stats);
+            }
+            copy_stats(&reply->body.stats, &stats);
+            reply->header.payloadSize = sizeof(reply->body.stats);
+            break;
+        default:
+            result = EFFECT_CONTROL_ERROR_NOT_SUPPORTED;
+            break;
+    }
+    
+    effectd_registry_release(control->registry, sessionId);
+    return result;
+}
+
+static int add_connection(EffectdControl* control, int fd, bool broker);
+
+static int32_t handle_connect(EffectdControl* control, EffectControlMessage* req,
+                              EffectControlMessage* reply) {
+    if (!control->zygote) {
+        return EFFECT_CONTROL_ERROR_NOT_SUPPORTED;
+    }
+    if (req->header.id > EFFECT_LIB_NOISE_REDUCTION) {
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    int fd = effectd_zygote_connect(control->zygote, (EffectLibType)req->header.id);
+    if (fd < 0) {
+        return EFFECT_CONTROL_ERROR_DEAD_OBJECT;
+    }
+    reply->header.fdMask = EFFECT_CONTROL_FD_CONNECTION;
+    reply->fds[0] = fd;
+    return EFFECT_CONTROL_OK;
+}
+
+static int32_t handle_adopt(EffectdControl* control, Connection* conn, EffectControlMessage* req) {
+    // Only effectd hands connections to a library host
+    if (!conn->broker || req->fds[0] < 0) {
+        return EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+    }
+    if (add_connection(control, req->fds[0], false) < 0) {
+        return EFFECT_CONTROL_ERROR_NO_MEMORY;
+    }
+    req->fds[0] = -1;
+    return EFFECT_CONTROL_OK;
+}
+
+static void handle_request(EffectdControl* control, Connection* conn,
+                           EffectControlMessage* req, EffectControlMessage* reply) {
+    memset(&reply->header, 0, sizeof(reply->header));
+    reply->header.requestId = req->header.requestId;
+    reply->header.op = req->header.op;
+    reply->header.id = req->header.id;
+    
+    switch (req->header.op) {
+        case EFFECT_CONTROL_OP_OPEN:
+            reply->header.result = handle_open(control, conn, req, reply);
+            break;
+        case EFFECT_CONTROL_OP_REGISTER_POOL:
+            reply->header.result = handle_register_pool(conn, req);
+            break;
+        case EFFECT_CONTROL_OP_CLOSE:
+            reply->header.result = handle_close(control, conn, req->header.id);
+            break;
+        case EFFECT_CONTROL_OP_CONNECT:
+            reply->header.result = handle_connect(control, req, reply);
+            break;
+        case EFFECT_CONTROL_OP_ADOPT:
+            reply->header.result = handle_adopt(control, conn, req);
+            break;
+        default:
+            reply->header.result = handle_session_op(control, conn, req, reply);
+            break;
+    }
+    
+    // Whatever the handler did not take ownership of
+    effect_control_close_fds(req);
+}
+
+static void close_connection(EffectdControl* control, Connection* conn) {
+    for (Connection** link = &control->connections; *link; link = &(*link)->next) {
+        if (*link == conn) {
+            *link = conn->next;
+            break;
+        }
+    }
+    
+    if (conn->numSessions > 0) {
+        syslog(LOG_INFO, "Client gone, closing its %u sessions", conn->numSessions);
+    }
+    for (uint32_t i = 0; i < conn->numSessions; i++) {
+        close_session(control, conn->sessionIds[i]);
+    }
+    // Sessions hold their own pool references
+    for (uint32_t i = 0; i < conn->numPools; i++) {
+        effect_shm_pool_release(conn->pools[i].pool);
+    }
+    
+    close(conn->fd);
+    free(conn->sessionIds);
+    free(conn);
+}
+
+/**
+ * Serve a connected socket, which is closed on failure
+ */
+static int add_connection(EffectdControl* control, int fd, bool broker) {
+    Connection* conn = (Connection*)calloc(1, sizeof(Connection));
+    if (!conn) {
+        close(fd);
+        return -1;
+    }
+    conn->fd = fd;
+    conn->broker = broker;
+    
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = conn;
+    if (epoll_ctl(control->epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        close(fd);
+        free(conn);
+        return -1;
+    }
+    
+    conn->next = control->connections;
+    control->connections = conn;
+    return 0;
+}
+
+/**
+ * Whether a client may use effectd: root, effectd's own user, or a member
+ * of its group, which owns the socket
+ *
+ * The socket mode already keeps everyone else out; this also covers a
+ * connection handed over by a process that was allowed to open it.
+ */
+static bool peer_allowed(int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+        return false;
+    }
+    if (cred.uid == 0 || cred.uid == geteuid() || cred.gid == getegid()) {
+        return true;
+    }
+    
+#ifdef SO_PEERGROUPS
+    gid_t groups[MAX_PEER_GROUPS];
+    len = sizeof(groups);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERGROUPS, groups, &len) == 0) {
+        for (uint32_t i = 0; i < len / sizeof(gid_t); i++) {
+            if (groups[i] == getegid()) {
+                return true;
+            }
+        }
+    }
+#endif
+    
+    syslog(LOG_WARNING, "Refused control connection from pid %d uid %u",
+           (int)cred.pid, (unsigned)cred.uid);
+    return false;
+}
+
+static void accept_connection(EffectdControl* control) {
+    int fd = accept4(control->listenFd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    if (!peer_allowed(fd)) {
+        close(fd);
+        return;
+    }
+    add_connection(control, fd, false);
+}
+
+/**
+ * Serve one packet: every request in order, then all replies in one packet
+ */
+static void serve_connection(EffectdControl* control, Connection* conn) {
+    int count = effect_control_recv_packet(conn->fd, control->requests);
+    if (count <= 0) {
+        close_connection(control, conn);
+        return;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        handle_request(control, conn, &control->requests[i], &control->replies[i]);
+    }
+    
+    int sent = effect_control_send_packet(conn->fd, control->replies, (uint32_t)count);
+    
+    // The packet carried duplicates of any fds handed out (CONNECT)
+    for (int i = 0; i < count; i++) {
+        effect_control_close_fds(&control->replies[i]);
+    }
+    if (sent < 0) {
+        close_connection(control, conn);
+    }
+}
+
+static void* control_thread_func(void* arg) {
+    EffectdControl* control = (EffectdControl*)arg;
+    struct epoll_event events[MAX_EVENTS];
+    
+    while (true) {
+        int n = epoll_wait(control->epollFd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syslog(LOG_ERR, "Control plane wait failed: %d", errno);
+            return NULL;
+        }
+        
+        for (int i = 0; i < n; i++) {
+            void* source = events[i].data.ptr;
+            if (source == &control->stopFd) {
+                return NULL;
+            } else if (source == control) {
+                accept_connection(control);
+            } else {
+                serve_connection(control, (Connection*)source);
+            }
+        }
+    }
+}
+
+static int watch(EffectdControl* control, int fd, void* source) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = source;
+    return epoll_ctl(control->epollFd, EPOLL_CTL_ADD, fd, &event);
+}
+
+int effectd_control_listen(const char* path) {
+    if (!path) {
+        return -1;
+    }
+    
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    
+    // The runtime directory is created private to effectd's user and group
+    char dir[sizeof(addr.sun_path)];
+    strcpy(dir, path);
+    char* slash = strrchr(dir, '/');
+    if (slash && slash != dir) {
+        *slash = '\0';
+        if (mkdir(dir, SOCKET_DIR_MODE) == 0) {
+            chmod(dir, SOCKET_DIR_MODE);
+        } else if (errno != EEXIST) {
+            syslog(LOG_ERR, "Failed to create %s: %d", dir, errno);
+            return -1;
+        }
+    }
+    
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    // A socket file left by a previous instance would make bind fail, but
+    // one that still answers belongs to a running effectd
+    int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (probe >= 0) {
+        bool live = connect(probe, (struct sockaddr*)&addr, sizeof(addr)) == 0 ||
+                    errno == EAGAIN;
+        close(probe);
+        if (live) {
+            syslog(LOG_ERR, "Another effectd is listening on %s", path);
+            close(fd);
+            return -1;
+        }
+    }
+    unlink(path);
+    
+    // Bound with the final mode so that it is never reachable by others;
+    // effectd is still single-threaded here, so the umask change is safe
+    mode_t mask = umask(0777 & ~SOCKET_MODE);
+    int bound = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    umask(mask);
+    
+    if (bound < 0 || listen(fd, LISTEN_BACKLOG) < 0) {
+        syslog(LOG_ERR, "Failed to listen on %s: %d", path, errno);
+        close(fd);
+        if (bound == 0) {
+            unlink(path);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Serve listenFd, or the single connection brokerFd of a library host
+ */
+static EffectdControl* create(int listenFd, int brokerFd, EffectdZygote* zygote,
+                              EffectdRegistry* registry, EffectdBlobCache* blobCache,
+                              struct EffectdWorkerPool* workerPool,
+                              struct EffectdPoller* poller,
+                              struct EffectdWatchdog* watchdog) {
+    if ((listenFd < 0 && brokerFd < 0) || !registry || !blobCache) {
+        return NULL;
+    }
+    
+    EffectdControl* control = (EffectdControl*)calloc(1, sizeof(EffectdControl));
+    if (!control) {
+        return NULL;
+    }
+    control->listenFd = listenFd;
+    control->registry = registry;
+    control->blobCache = blobCache;
+    control->workerPool = workerPool;
+    control->poller = poller;
+    control->watchdog = watchdog;
+    control->zygote = zygote;
+    
+    control->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    control->stopFd = eventfd(0, EFD_CLOEXEC);
+    
+    bool failed = control->epollFd < 0 || control->stopFd < 0 ||
+                  (listenFd >= 0 && watch(control, control->listenFd, control) < 0) ||
+                  watch(control, control->stopFd, &control->stopFd) < 0;
+    if (!failed && brokerFd >= 0) {
+        // Closed by add_connection on failure, by close_connection from here on
+        failed = add_connection(control, brokerFd, true) < 0;
+        brokerFd = -1;
+    }
+    if (failed || pthread_create(&control->thread, NULL, control_thread_func, control) != 0) {
+        syslog(LOG_ERR, "Failed to start control plane: %d", errno);
+        while (control->connections) {
+            close_connection(control, control->connections);
+        }
+        if (brokerFd >= 0) close(brokerFd);
+        if (control->epollFd >= 0) close(control->epollFd);
+        if (control->stopFd >= 0) close(control->stopFd);
+        free(control);
+        return NULL;
+    }
+    
+    return control;
+}
+
+EffectdControl* effectd_control_create(int listenFd, EffectdZygote* zygote,
+                                       EffectdRegistry* registry, EffectdBlobCache* blobCache,
+                                       struct EffectdWorkerPool* workerPool,
+                                       struct EffectdPoller* poller,
+                                       struct EffectdWatchdog* watchdog) {
+    if (listenFd < 0) {
+        return NULL;
+    }
+    return create(listenFd, -1, zygote, registry, blobCache, workerPool, poller, watchdog);
+}
+
+EffectdControl* effectd_control_create_host(int brokerFd, EffectdRegistry* registry,
+                                            EffectdBlobCache* blobCache,
+                                            struct EffectdWorkerPool* workerPool,
+                                            struct EffectdWatchdog* watchdog) {
+    if (brokerFd < 0) {
+        return NULL;
+    }
+    return create(-1, brokerFd, NULL, registry, blobCache, workerPool, NULL, watchdog);
+}
+
+void effectd_control_destroy(EffectdControl* control) {
+    if (!control) {
+        return;
+    }
+    
+    uint64_t one = 1;
+    if (write(control->stopFd, &one, sizeof(one)) == sizeof(one)) {
+        pthread_join(control->thread, NULL);
+    }
+    
+    while (control->connections) {
+        close_connection(control, control->connections);
+    }
+    
+    if (control->listenFd >= 0) {
+        close(control->listenFd);
+    }
+    close(control->epollFd);
+    close(control->stopFd);
+    free(control);
+}
@@ -0,0 +1,140 @@
+#include "effectd_plugin.h"
+#include <stdbool.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#define NUM_LIB_TYPES 2
+
+// Plugins wrapping the vendor algorithms, overridable per type
+static const char* g_library_paths[NUM_LIB_TYPES] = {
+    "libeffect_plugin_karaoke_no_mic.so",    // EFFECT_LIB_KARAOKE_NO_MIC
+    "libeffect_plugin_noise_reduction.so",   // EFFECT_LIB_NOISE_REDUCTION
+};
+
+// Held by effectd_plugin_preload for the life of the process
+static void* g_preloaded[NUM_LIB_TYPES];
+
+static void* resolve(void* handle, const char* path, const char* symbol) {
+    void* fn = dlsym(handle, symbol);
+    if (!fn) {
+        syslog(LOG_ERR, "Plugin %s does not export %s", path, symbol);
+    }
+    return fn;
+}
+
+void* effectd_plugin_load(const char* path, EffectPluginApi* api) {
+    if (!path || !api) {
+        return NULL;
+    }
+    
+    void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        syslog(LOG_ERR, "Failed to load plugin %s: %s", path, dlerror());
+        return NULL;
+    }
+    
+    // Casting through void* keeps -Wpedantic quiet about object/function pointers
+    *(void**)&api->getAbiVersion = resolve(handle, path, EFFECT_PLUGIN_SYM_GET_ABI_VERSION);
+    *(void**)&api->create = resolve(handle, path, EFFECT_PLUGIN_SYM_CREATE);
+    *(void**)&api->process = resolve(handle, path, EFFECT_PLUGIN_SYM_PROCESS);
+    *(void**)&api->setParam = resolve(handle, path, EFFECT_PLUGIN_SYM_SET_PARAM);
+    *(void**)&api->reset = resolve(handle, path, EFFECT_PLUGIN_SYM_RESET);
+    *(void**)&api->getLatency = resolve(handle, path, EFFECT_PLUGIN_SYM_GET_LATENCY);
+    *(void**)&api->destroy = resolve(handle, path, EFFECT_PLUGIN_SYM_DESTROY);
+    // Optional since 1.1, so a missing one is not an error
+    *(void**)&api->setParamBlob = dlsym(handle, EFFECT_PLUGIN_SYM_SET_PARAM_BLOB);
+    
+    if (!api->getAbiVersion || !api->create || !api->process || !api->setParam ||
+        !api->reset || !api->getLatency || !api->destroy) {
+        dlclose(handle);
+        return NULL;
+    }
+    
+    uint32_t version = api->getAbiVersion();
+    uint32_t major = version >> 16;
+    uint32_t minor = version & 0xFFFFu;
+    if (major != EFFECT_PLUGIN_ABI_VERSION_MAJOR || minor > EFFECT_PLUGIN_ABI_VERSION_MINOR) {
+        syslog(LOG_ERR, "Plugin %s has ABI %u.%u, effectd supports %u.%u", path,
+               major, minor, EFFECT_PLUGIN_ABI_VERSION_MAJOR, EFFECT_PLUGIN_ABI_VERSION_MINOR);
+        dlclose(handle);
+        return NULL;
+    }
+    
+    return handle;
+}
+
+void effectd_plugin_unload(void* handle) {
+    if (handle) {
+        dlclose(handle);
+    }
+}
+
+/**
+ * dl_iterate_phdr callback: read a byte of every page of the object that
+ * contains the address in arg
+ */
+static int prefault_object(struct dl_phdr_info* info, size_t size, void* arg) {
+    (void)size;
+    uintptr_t address = (uintptr_t)arg;
+    bool found = false;
+    for (int i = 0; i < info->dlpi_phnum && !found; i++) {
+        const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+        uintptr_t start = info->dlpi_addr + phdr->p_vaddr;
+        found = phdr->p_type == PT_LOAD && address >= start && address < start + phdr->p_memsz;
+    }
+    if (!found) {
+        return 0;
+    }
+    
+    uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+        // Execute-only segments cannot be read
+        if (phdr->p_type != PT_LOAD || !(phdr->p_flags & PF_R)) {
+            continue;
+        }
+        uintptr_t start = info->dlpi_addr + phdr->p_vaddr;
+        uintptr_t end = start + phdr->p_memsz;
+        for (uintptr_t page = start & ~(pageSize - 1); page < end; page += pageSize) {
+            (void)*(volatile const uint8_t*)page;
+        }
+    }
+    return 1;
+}
+
+void effectd_plugin_preload(void) {
+    for (int type = 0; type < NUM_LIB_TYPES; type++) {
+        if (g_preloaded[type]) {
+            continue;
+        }
+        g_preloaded[type] = dlopen(g_library_paths[type], RTLD_NOW | RTLD_LOCAL);
+        if (!g_preloaded[type]) {
+            syslog(LOG_DEBUG, "Plugin %s not preloaded: %s", g_library_paths[type], dlerror());
+            continue;
+        }
+        
+        // Page the library in, so neither this process nor the hosts forked
+        // from it fault on the first period
+        void* symbol = dlsym(g_preloaded[type], EFFECT_PLUGIN_SYM_CREATE);
+        if (symbol) {
+            dl_iterate_phdr(prefault_object, symbol);
+        }
+    }
+}
+
+int effectd_plugin_set_library(EffectLibType type, const char* path) {
+    if ((unsigned)type >= NUM_LIB_TYPES || !path) {
+        return -1;
+    }
+    g_library_paths[type] = path;
+    return 0;
+}
+
+const char* effectd_plugin_get_library(EffectLibType type) {
+    if ((unsigned)type >= NUM_LIB_TYPES) {
+        return NULL;
+    }
+    return g_library_paths[type];
+}
@@ -0,0 +1,250 @@
+#include "effectd_poller.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#define MAX_RELAX_SHIFT 6      // Idle pause grows to 64 relax hints per sweep
+
+struct EffectdPoller {
+    EffectdPollerConfig config;
+    pthread_t thread;
+    bool joinable;                        // thread was started; guarded by lock
+    atomic_bool running;
+    atomic_uint epoch;                    // Bumped after every sweep
+    
+    // Sessions polled; NULL slots are skipped. Read without locks by the
+    // poller, changed under lock by add/remove.
+    _Atomic(EffectSession*) slots[EFFECTD_POLLER_MAX_SESSIONS];
+    atomic_uint numSlots;                 // Slots in use are all below this
+    pthread_mutex_t lock;
+};
+
+static int64_t get_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void setup_poller_thread(EffectdPoller* poller) {
+    if (poller->config.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(poller->config.cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    
+    if (poller->config.rtPriority > 0) {
+        struct sched_param param;
+        param.sched_priority = poller->config.rtPriority;
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }
+}
+
+/**
+ * Visit every session once, starting at first, and run the ready ones
+ * earliest deadline first
+ *
+ * @return true if any period was processed
+ */
+static bool sweep(EffectdPoller* poller, uint32_t first) {
+    uint32_t numSlots = atomic_load(&poller->numSlots);
+    EffectSession* ready[EFFECTD_POLLER_MAX_SESSIONS];
+    int64_t deadlines[EFFECTD_POLLER_MAX_SESSIONS];
+    uint32_t numReady = 0;
+    int64_t now = 0;
+    
+    for (uint32_t i = 0; i < numSlots; i++) {
+        EffectSession* session = atomic_load(&poller->slots[(first + i) % numSlots]);
+        
+        // The ring indices are the only shared state an idle session costs
+        if (!session || !session->threadRunning || !effectd_session_has_pending(session)) {
+            continue;
+        }
+        if (now == 0) {
+            now = get_time_us();
+        }
+        
+        // Insertion sort; sessions without a known period go last, and
+        // ties keep the rotated order
+        int64_t deadline = effectd_session_mark_ready(session, now);
+        uint64_t key = deadline != 0 ? (uint64_t)deadline : UINT64_MAX;
+        uint32_t j = numReady++;
+        while (j > 0 && key < (deadlines[j - 1] != 0 ? (uint64_t)deadlines[j - 1] : UINT64_MAX)) {
+            ready[j] = ready[j - 1];
+            deadlines[j] = deadlines[j - 1];
+            j--;
+        }
+        ready[j] = session;
+        deadlines[j] = deadline;
+    }
+    
+    bool busy = false;
+    for (uint32_t i = 0; i < numReady; i++) {
+        if (effectd_session_process_periods(ready[i], poller->config.periodsPerTurn) > 0) {
+            busy = true;
+        }
+    }
+    
+    atomic_fetch_add(&poller->epoch, 1);
+    return busy;
+}
+
+static void* poller_thread_func(void* arg) {
+    EffectdPoller* poller = (EffectdPoller*)arg;
+    uint32_t first = 0;
+    uint32_t relaxShift = 0;
+    int64_t lastWorkUs = get_time_us();
+    
+    setup_poller_thread(poller);
+    
+    while (atomic_load_explicit(&poller->running, memory_order_relaxed)) {
+        if (sweep(poller, first++)) {
+            relaxShift = 0;
+            lastWorkUs = get_time_us();
+            continue;
+        }
+        
+        if (poller->config.idleSleepUs > 0 && poller->config.idleSpinUs > 0 &&
+            get_time_us() - lastWorkUs > (int64_t)poller->config.idleSpinUs) {
+            struct timespec nap;
+            nap.tv_sec = poller->config.idleSleepUs / 1000000;
+            nap.tv_nsec = (long)(poller->config.idleSleepUs % 1000000) * 1000;
+            nanosleep(&nap, NULL);
+            continue;
+        }
+        
+        for (uint32_t i = 0; i < (1u << relaxShift); i++) {
+            effect_cpu_relax();
+        }
+        if (relaxShift < MAX_RELAX_SHIFT) {
+            relaxShift++;
+        }
+    }
+    
+    return NULL;
+}
+
+EffectdPoller* effectd_poller_create(const EffectdPollerConfig* config) {
+    if (!config) {
+        return NULL;
+    }
+    
+    EffectdPoller* poller = (EffectdPoller*)calloc(1, sizeof(EffectdPoller));
+    if (!poller) {
+        return NULL;
+    }
+    
+    poller->config = *config;
+    if (poller->config.periodsPerTurn == 0) {
+        poller->config.periodsPerTurn = 1;
+    }
+    pthread_mutex_init(&poller->lock, NULL);
+    atomic_store(&poller->running, true);
+    
+    if (pthread_create(&poller->thread, NULL, poller_thread_func, poller) != 0) {
+        pthread_mutex_destroy(&poller->lock);
+        free(poller);
+        return NULL;
+    }
+    poller->joinable = true;
+    
+    return poller;
+}
+
+void effectd_poller_destroy(EffectdPoller* poller) {
+    if (!poller) {
+        return;
+    }
+    
+    atomic_store(&poller->running, false);
+    if (poller->joinable) {
+        pthread_join(poller->thread, NULL);
+    }
+    
+    pthread_mutex_destroy(&poller->lock);
+    free(poller);
+}
+
+int effectd_poller_add_session(EffectdPoller* poller, EffectSession* session) {
+    if (!poller || !session) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&poller->lock);
+    
+    // Reuse a hole left by a removed session before growing the range
+    uint32_t numSlots = atomic_load(&poller->numSlots);
+    uint32_t slot = numSlots;
+    for (uint32_t i = 0; i < numSlots; i++) {
+        if (!atomic_load(&poller->slots[i])) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot >= EFFECTD_POLLER_MAX_SESSIONS) {
+        pthread_mutex_unlock(&poller->lock);
+        return -1;
+    }
+    
+    atomic_store(&poller->slots[slot], session);
+    if (slot == numSlots) {
+        atomic_store(&poller->numSlots, numSlots + 1);
+    }
+    
+    pthread_mutex_unlock(&poller->lock);
+    return 0;
+}
+
+void effectd_poller_remove_session(EffectdPoller* poller, EffectSession* session) {
+    if (!poller || !session) {
+        return;
+    }
+    
+    pthread_mutex_lock(&poller->lock);
+    
+    uint32_t numSlots = atomic_load(&poller->numSlots);
+    bool found = false;
+    for (uint32_t i = 0; i < numSlots; i++) {
+        if (atomic_load(&poller->slots[i]) == session) {
+            atomic_store(&poller->slots[i], NULL);
+            found = true;
+            break;
+        }
+    }
+    while (numSlots > 0 && !atomic_load(&poller->slots[numSlots - 1])) {
+        numSlots--;
+    }
+    atomic_store(&poller->numSlots, numSlots);
+    
+    pthread_mutex_unlock(&poller->lock);
+    
+    if (!found) {
+        return;
+    }
+    
+    // A sweep in progress may have loaded the session before the slot was
+    // cleared; once the epoch moves that sweep is over
+    unsigned int epoch = atomic_load(&poller->epoch);
+    while (atomic_load(&poller->epoch) == epoch) {
+        sched_yield();
+    }
+}
+
+int effectd_poller_replace_thread(EffectdPoller* poller) {
+    if (!poller) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&poller->lock);
+    if (poller->joinable) {
+        effectd_sched_abandon_thread(poller->thread);
+    }
+    poller->joinable = pthread_create(&poller->thread, NULL, poller_thread_func, poller) == 0;
+    int ret = poller->joinable ? 0 : -1;
+    pthread_mutex_unlock(&poller->lock);
+    
+    return ret;
+}
@@ -0,0 +1,158 @@
+#include "effectd_registry.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <pthread.h>
+
+#define SLOT_MASK (EFFECTD_REGISTRY_MAX_SESSIONS - 1)
+#define MAX_GENERATION (UINT32_MAX >> EFFECTD_REGISTRY_SLOT_BITS)
+
+/**
+ * One table entry, on its own cache line so lookups of different sessions
+ * never share one
+ *
+ * state packs the live ID (high 32 bits, 0 while free or being removed)
+ * with the count of pinned references (low 32 bits), so a reader checks
+ * the ID and takes its reference in a single compare-and-swap.
+ */
+typedef struct {
+    _Alignas(EFFECT_CACHE_LINE_SIZE) atomic_uint_fast64_t state;
+    _Atomic(EffectSession*) session;
+    uint32_t generation;                  // Guarded by registry lock
+} Slot;
+
+struct EffectdRegistry {
+    Slot slots[EFFECTD_REGISTRY_MAX_SESSIONS];
+    pthread_mutex_t lock;                 // Add and remove only
+    uint32_t freeSlots[EFFECTD_REGISTRY_MAX_SESSIONS];
+    uint32_t numFree;
+};
+
+static uint32_t state_id(uint64_t state) {
+    return (uint32_t)(state >> 32);
+}
+
+static uint32_t state_refs(uint64_t state) {
+    return (uint32_t)state;
+}
+
+EffectdRegistry* effectd_registry_create(void) {
+    EffectdRegistry* registry = (EffectdRegistry*)aligned_alloc(EFFECT_CACHE_LINE_SIZE,
+                                                                sizeof(EffectdRegistry));
+    if (!registry) {
+        return NULL;
+    }
+    
+    pthread_mutex_init(&registry->lock, NULL);
+    for (uint32_t i = 0; i < EFFECTD_REGISTRY_MAX_SESSIONS; i++) {
+        atomic_init(&registry->slots[i].state, 0);
+        atomic_init(&registry->slots[i].session, NULL);
+        registry->slots[i].generation = 0;
+        // Hand out low slots first
+        registry->freeSlots[i] = EFFECTD_REGISTRY_MAX_SESSIONS - 1 - i;
+    }
+    registry->numFree = EFFECTD_REGISTRY_MAX_SESSIONS;
+    return registry;
+}
+
+void effectd_registry_destroy(EffectdRegistry* registry) {
+    if (!registry) {
+        return;
+    }
+    pthread_mutex_destroy(&registry->lock);
+    free(registry);
+}
+
+uint32_t effectd_registry_add(EffectdRegistry* registry, EffectSession* session) {
+    if (!registry || !session) {
+        return 0;
+    }
+    
+    pthread_mutex_lock(&registry->lock);
+    
+    if (registry->numFree == 0) {
+        pthread_mutex_unlock(&registry->lock);
+        return 0;
+    }
+    
+    uint32_t index = registry->freeSlots[--registry->numFree];
+    Slot* slot = &registry->slots[index];
+    
+    // Generation 0 is skipped so that no ID is ever 0
+    slot->generation = slot->generation % MAX_GENERATION + 1;
+    uint32_t sessionId = (slot->generation << EFFECTD_REGISTRY_SLOT_BITS) | index;
+    
+    session->sessionId = sessionId;
+    atomic_store(&slot->session, session);
+    // Publishing the ID makes the session visible to lookups
+    atomic_store(&slot->state, (uint64_t)sessionId << 32);
+    
+    pthread_mutex_unlock(&registry->lock);
+    return sessionId;
+}
+
+EffectSession* effectd_registry_acquire(EffectdRegistry* registry, uint32_t sessionId) {
+    if (!registry || sessionId == 0) {
+        return NULL;
+    }
+    
+    Slot* slot = &registry->slots[sessionId & SLOT_MASK];
+    uint64_t state = atomic_load(&slot->state);
+    do {
+        if (state_id(state) != sessionId) {
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak(&slot->state, &state, state + 1));
+    
+    return atomic_load(&slot->session);
+}
+
+void effectd_registry_release(EffectdRegistry* registry, uint32_t sessionId) {
+    if (!registry || sessionId == 0) {
+        return;
+    }
+    
+    atomic_fetch_sub(&registry->slots[sessionId & SLOT_MASK].state, 1);
+}
+
+EffectSession* effectd_registry_remove(EffectdRegistry* registry, uint32_t sessionId) {
+    if (!registry || sessionId == 0) {
+        return NULL;
+    }
+    
+    uint32_t index = sessionId & SLOT_MASK;
+    Slot* slot = &registry->slots[index];
+    
+    // Clear the ID, keeping the references: no new reader gets in, and of
+    // two concurrent removals only one gets past this point
+    uint64_t state = atomic_load(&slot->state);
+    do {
+        if (state_id(state) != sessionId) {
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak(&slot->state, &state, (uint64_t)state_refs(state)));
+    
+    // Readers only hold a reference for the length of one control call
+    while (state_refs(atomic_load(&slot->state)) != 0) {
+        sched_yield();
+    }
+    
+    EffectSession* session = atomic_load(&slot->session);
+    atomic_store(&slot->session, NULL);
+    
+    pthread_mutex_lock(&registry->lock);
+    registry->freeSlots[registry->numFree++] = index;
+    pthread_mutex_unlock(&registry->lock);
+    return session;
+}
+
+uint32_t effectd_registry_get_count(EffectdRegistry* registry) {
+    if (!registry) {
+        return 0;
+    }
+    
+    pthread_mutex_lock(&registry->lock);
+    uint32_t count = EFFECTD_REGISTRY_MAX_SESSIONS - registry->numFree;
+    pthread_mutex_unlock(&registry->lock);
+    return count;
+}
@@ -0,0 +1,340 @@
+#include "effectd_sched.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define NUM_LIB_TYPES 2
+#define MAX_LEDGER_PROCS 16   // effectd and its library hosts, respawns included
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+/**
+ * Kernel ABI of sched_setattr (struct sched_attr, SCHED_ATTR_SIZE_VER0)
+ */
+typedef struct {
+    uint32_t size;
+    uint32_t schedPolicy;
+    uint64_t schedFlags;
+    int32_t schedNice;
+    uint32_t schedPriority;
+    uint64_t schedRuntime;
+    uint64_t schedDeadline;
+    uint64_t schedPeriod;
+} DeadlineAttr;
+
+/**
+ * CPU shares reserved by one process
+ */
+typedef struct {
+    pid_t pid;                // 0 for a free slot
+    uint64_t reservedPpm;
+} LedgerEntry;
+
+/**
+ * Admission ledger, shared by effectd and its library hosts once
+ * effectd_sched_share_ledger() has moved it to shared memory
+ *
+ * Every process reserves in its own entry, so that the shares of a host
+ * that died can be returned without its cooperation.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t capacityPpm;     // 0 until set or first used
+    LedgerEntry procs[MAX_LEDGER_PROCS];
+} Ledger;
+
+static pthread_mutex_t g_sched_lock = PTHREAD_MUTEX_INITIALIZER;   // Policies
+
+// Undeclared budgets: every session is admitted, as before admission control
+static EffectdSchedPolicy g_policies[NUM_LIB_TYPES] = {
+    { EFFECTD_SCHED_FIFO, EFFECTD_SCHED_DEFAULT_PRIORITY, 0, 0, false },   // EFFECT_LIB_KARAOKE_NO_MIC
+    { EFFECTD_SCHED_FIFO, EFFECTD_SCHED_DEFAULT_PRIORITY, 0, 0, false },   // EFFECT_LIB_NOISE_REDUCTION
+};
+
+static Ledger g_local_ledger = { .lock = PTHREAD_MUTEX_INITIALIZER };
+static Ledger* g_ledger = &g_local_ledger;
+
+static void ledger_lock(void) {
+    if (pthread_mutex_lock(&g_ledger->lock) == EOWNERDEAD) {
+        // A host died holding the lock; entries are only ever updated whole
+        pthread_mutex_consistent(&g_ledger->lock);
+    }
+}
+
+static void ledger_unlock(void) {
+    pthread_mutex_unlock(&g_ledger->lock);
+}
+
+static uint64_t capacity_ppm_locked(void) {
+    if (g_ledger->capacityPpm == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        g_ledger->capacityPpm = (uint64_t)(cpus > 0 ? cpus : 1) * EFFECTD_SCHED_DEFAULT_CAPACITY_PCT * 10000;
+    }
+    return g_ledger->capacityPpm;
+}
+
+static uint64_t reserved_ppm_locked(void) {
+    uint64_t reserved = 0;
+    for (int i = 0; i < MAX_LEDGER_PROCS; i++) {
+        reserved += g_ledger->procs[i].reservedPpm;
+    }
+    return reserved;
+}
+
+/**
+ * Entry of the calling process, claiming a free one if it has none (lock held)
+ */
+static LedgerEntry* own_entry_locked(bool claim) {
+    pid_t pid = getpid();
+    LedgerEntry* unused = NULL;
+    for (int i = 0; i < MAX_LEDGER_PROCS; i++) {
+        LedgerEntry* entry = &g_ledger->procs[i];
+        if (entry->pid == pid) {
+            return entry;
+        }
+        if (!unused && entry->pid == 0) {
+            unused = entry;
+        }
+    }
+    if (claim && unused) {
+        unused->pid = pid;
+        unused->reservedPpm = 0;
+        return unused;
+    }
+    return NULL;
+}
+
+int effectd_sched_set_policy(uint32_t type, const EffectdSchedPolicy* policy) {
+    if (type >= NUM_LIB_TYPES || !policy) {
+        return -1;
+    }
+    if ((policy->schedClass == EFFECTD_SCHED_FIFO &&
+         (policy->priority < 1 || policy->priority > 99)) ||
+        (policy->schedClass == EFFECTD_SCHED_DEADLINE && policy->budgetUs == 0) ||
+        policy->schedClass > EFFECTD_SCHED_DEADLINE) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&g_sched_lock);
+    g_policies[type] = *policy;
+    pthread_mutex_unlock(&g_sched_lock);
+    return 0;
+}
+
+int effectd_sched_get_policy(uint32_t type, EffectdSchedPolicy* policy) {
+    if (type >= NUM_LIB_TYPES || !policy) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&g_sched_lock);
+    *policy = g_policies[type];
+    pthread_mutex_unlock(&g_sched_lock);
+    return 0;
+}
+
+void effectd_sched_set_capacity(uint32_t percent) {
+    ledger_lock();
+    g_ledger->capacityPpm = (uint64_t)percent * 10000;
+    ledger_unlock();
+}
+
+int effectd_sched_share_ledger(void) {
+    if (g_ledger != &g_local_ledger) {
+        return 0;
+    }
+    
+    Ledger* shared = (Ledger*)mmap(NULL, sizeof(Ledger), PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        return -1;
+    }
+    
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    int err = pthread_mutex_init(&shared->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (err != 0) {
+        munmap(shared, sizeof(Ledger));
+        return -1;
+    }
+    
+    // Whatever this process reserved so far comes along
+    ledger_lock();
+    shared->capacityPpm = g_local_ledger.capacityPpm;
+    memcpy(shared->procs, g_local_ledger.procs, sizeof(shared->procs));
+    g_ledger = shared;
+    pthread_mutex_unlock(&g_local_ledger.lock);
+    return 0;
+}
+
+void effectd_sched_forget(pid_t pid) {
+    if (pid <= 0) {
+        return;
+    }
+    
+    ledger_lock();
+    for (int i = 0; i < MAX_LEDGER_PROCS; i++) {
+        if (g_ledger->procs[i].pid == pid) {
+            if (g_ledger->procs[i].reservedPpm > 0) {
+                syslog(LOG_INFO, "Returning %llu ppm reserved by process %d",
+                       (unsigned long long)g_ledger->procs[i].reservedPpm, (int)pid);
+            }
+            g_ledger->procs[i].pid = 0;
+            g_ledger->procs[i].reservedPpm = 0;
+        }
+    }
+    ledger_unlock();
+}
+
+int effectd_sched_admit(uint32_t type, uint32_t sampleRate, uint32_t framesPerBuffer,
+                        EffectdSchedGrant* grant) {
+    if (type >= NUM_LIB_TYPES || !grant) {
+        return -1;
+    }
+    
+    memset(grant, 0, sizeof(*grant));
+    if (sampleRate > 0) {
+        grant->periodUs = (uint32_t)((uint64_t)framesPerBuffer * 1000000 / sampleRate);
+    }
+    
+    pthread_mutex_lock(&g_sched_lock);
+    grant->policy = g_policies[type];
+    pthread_mutex_unlock(&g_sched_lock);
+    uint32_t budgetUs = grant->policy.budgetUs;
+    
+    if (budgetUs == 0) {
+        // Nothing declared, nothing to reserve
+        grant->admitted = true;
+        return 0;
+    }
+    
+    // A budget the period cannot hold never fits, however idle we are
+    bool fits = grant->periodUs > 0 && budgetUs <= grant->periodUs;
+    uint64_t sharePpm = fits ? (uint64_t)budgetUs * 1000000 / grant->periodUs : 0;
+    
+    // Checked against the sessions of every process sharing the ledger
+    ledger_lock();
+    fits = fits && reserved_ppm_locked() + sharePpm <= capacity_ppm_locked();
+    LedgerEntry* entry = fits ? own_entry_locked(true) : NULL;
+    fits = entry != NULL;
+    
+    if (fits) {
+        entry->reservedPpm += sharePpm;
+        grant->sharePpm = (uint32_t)sharePpm;
+        grant->admitted = true;
+    } else if (grant->policy.downgrade) {
+        // Best effort: runs, but neither reserves nor preempts admitted sessions
+        grant->policy.schedClass = EFFECTD_SCHED_OTHER;
+        grant->policy.priority = 0;
+        grant->admitted = true;
+    }
+    
+    ledger_unlock();
+    
+    if (!grant->admitted) {
+        syslog(LOG_WARNING, "Rejected effect type %u: %u us per %u us period exceeds CPU budget",
+               type, budgetUs, grant->periodUs);
+        return -1;
+    }
+    if (!fits) {
+        syslog(LOG_WARNING, "Effect type %u over CPU budget, downgraded to SCHED_OTHER", type);
+    }
+    return 0;
+}
+
+void effectd_sched_release(EffectdSchedGrant* grant) {
+    if (!grant || !grant->admitted) {
+        return;
+    }
+    
+    ledger_lock();
+    LedgerEntry* entry = own_entry_locked(false);
+    // Gone if the share was already forgotten
+    if (entry && entry->reservedPpm >= grant->sharePpm) {
+        entry->reservedPpm -= grant->sharePpm;
+    }
+    ledger_unlock();
+    
+    grant->sharePpm = 0;
+    grant->admitted = false;
+}
+
+uint64_t effectd_sched_get_reserved_ppm(void) {
+    ledger_lock();
+    uint64_t reserved = reserved_ppm_locked();
+    ledger_unlock();
+    return reserved;
+}
+
+static int apply_deadline(const EffectdSchedGrant* grant) {
+#ifdef SYS_sched_setattr
+    DeadlineAttr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.schedPolicy = SCHED_DEADLINE;
+    attr.schedRuntime = (uint64_t)grant->policy.budgetUs * 1000;
+    attr.schedDeadline = (uint64_t)grant->periodUs * 1000;
+    attr.schedPeriod = attr.schedDeadline;
+    return (int)syscall(SYS_sched_setattr, 0, &attr, 0);
+#else
+    (void)grant;
+    return -1;
+#endif
+}
+
+int effectd_sched_apply(const EffectdSchedGrant* grant) {
+    if (!grant) {
+        return -1;
+    }
+    
+    const EffectdSchedPolicy* policy = &grant->policy;
+    
+    if (policy->cpuMask != 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < 64; cpu++) {
+            if (policy->cpuMask & (1ull << cpu)) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    
+    if (policy->schedClass == EFFECTD_SCHED_OTHER) {
+        return 0;
+    }
+    
+    if (policy->schedClass == EFFECTD_SCHED_DEADLINE && grant->periodUs > 0 &&
+        apply_deadline(grant) == 0) {
+        return 0;
+    }
+    
+    // SCHED_FIFO, or the fallback for a refused SCHED_DEADLINE
+    struct sched_param param;
+    param.sched_priority = policy->priority > 0 ? policy->priority : EFFECTD_SCHED_DEFAULT_PRIORITY;
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    return policy->schedClass == EFFECTD_SCHED_FIFO ? 0 : -1;
+}
+
+bool effectd_sched_fits_shared(const EffectdSchedGrant* grant) {
+    const EffectdSchedPolicy* policy = &grant->policy;
+    return policy->schedClass == EFFECTD_SCHED_FIFO &&
+           policy->priority == EFFECTD_SCHED_DEFAULT_PRIORITY &&
+           policy->cpuMask == 0;
+}
+
+void effectd_sched_abandon_thread(pthread_t thread) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    pthread_setschedparam(thread, SCHED_IDLE, &param);
+    pthread_detach(thread);
+}
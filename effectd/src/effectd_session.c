@@ -1,15 +1,25 @@
 #include "effectd_session.h"
+#include "effectd_worker_pool.h"
+#include "effectd_poller.h"
+#include "effectd_watchdog.h"
+#include "effectd_plugin.h"
+#include "effectd_blob_cache.h"
+#include "effect_arena.h"
 #include "effect_fmq.h"
 #include "effect_shared_memory.h"
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dlfcn.h>
 #include <time.h>
 #include <unistd.h>
 #include <sched.h>
+#include <pthread.h>
+#include <syslog.h>
 
 #define MAX_BUFFER_SIZE (1024 * 1024)
 
+static void release_session(EffectSession* session);
+
 static uint32_t calculate_bytes_per_frame(const AudioConfig* config) {
     uint32_t bytes_per_sample = (config->format == 16) ? 2 : 4;
     return config->channels * bytes_per_sample;
@@ -21,198 +31,1069 @@ static int64_t get_time_us() {
     return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000LL;
 }
 
-static void mock_process_audio(void* context __attribute__((unused)), 
-                               const void* input, void* output, 
-                               uint32_t frames, uint32_t bytesPerFrame) {
-    // Simple passthrough for now
-    // Real implementation would call the loaded library's process function
-    memcpy(output, input, frames * bytesPerFrame);
+/**
+ * Remember a parameter value for a replacement context in one of the
+ * session's tables (the caller holds what guards it)
+ */
+static void record_param(EffectSession* session, EffectdParam* params, uint32_t* numParams,
+                         uint32_t key, const void* value, uint32_t valueSize) {
+    uint32_t index = 0;
+    while (index < *numParams && params[index].key != key) {
+        index++;
+    }
+    if (index == EFFECTD_SESSION_MAX_PARAMS) {
+        return;
+    }
     
-    // Simulate some processing time (1-2ms)
-    usleep(1000 + (rand() % 1000));
+    // Too large to keep: still recorded, so an older value is not replayed
+    EffectdParam* param = &params[index];
+    param->serial = atomic_fetch_add(&session->paramSerial, 1) + 1;
+    param->key = key;
+    param->kept = valueSize <= EFFECTD_SESSION_MAX_PARAM_SIZE;
+    param->valueSize = param->kept ? valueSize : 0;
+    memcpy(param->value, value, param->valueSize);
+    if (index == *numParams) {
+        (*numParams)++;
+    }
 }
 
-static void* processing_thread_func(void* arg) {
-    EffectSession* session = (EffectSession*)arg;
-    uint32_t bytesPerFrame = calculate_bytes_per_frame(&session->config);
-    uint32_t bufferSize = session->config.framesPerBuffer * bytesPerFrame;
-    
-    // Allocate processing buffers
-    void* inputBuffer = malloc(bufferSize);
-    void* outputBuffer = malloc(bufferSize);
-    
-    if (!inputBuffer || !outputBuffer) {
-        free(inputBuffer);
-        free(outputBuffer);
-        return NULL;
+/**
+ * Hand a context the session lets go of to a control-side call that was
+ * given up on while in it, if any; the call destroys it when it returns
+ * 
+ * @return true if handed over, false if the caller must destroy it
+ */
+static bool retire_to_stuck_call(EffectSession* session, void* context) {
+    pthread_mutex_lock(&session->callLock);
+    bool stuck = context == session->stuckContext;
+    if (stuck) {
+        session->retireStuck = true;
     }
-    
-    // Try to set real-time priority
-    struct sched_param param;
-    param.sched_priority = 10; // Medium priority
-    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
-    
-    while (session->threadRunning) {
-        // Wait for input data notification
-        int wait_result = effect_eventfd_wait(session->eventFdIn, 100); // 100ms timeout
-        
-        if (wait_result < 0) {
-            // Timeout or error - continue waiting
-            continue;
+    pthread_mutex_unlock(&session->callLock);
+    return stuck;
+}
+
+/**
+ * What the library calls of a period use, kept by a thread stuck in them
+ */
+typedef struct {
+    void* context;
+    EffectdCallBuffers* buffers;
+    uint64_t startUs;                 // Watched window, 0 if unwatched
+} PeriodCall;
+
+static void free_call_buffers(EffectdCallBuffers* buffers) {
+    if (buffers && buffers->ownArena) {
+        effect_arena_destroy(&buffers->arena);
+    }
+}
+
+/**
+ * Leave library calls the watchdog abandoned
+ * 
+ * The session has moved on to a new context, buffers and dispatcher
+ * thread, so the calling thread frees the old ones and exits without
+ * touching the session again.
+ */
+static void leave_abandoned_call(EffectSession* session, const PeriodCall* call) {
+    if (call->context && !retire_to_stuck_call(session, call->context)) {
+        session->plugin.destroy(call->context);
+    }
+    free_call_buffers(call->buffers);
+    release_session(session);
+    pthread_exit(NULL);
+}
+
+/**
+ * Make sure the watchdog has not abandoned the call's window (if watched);
+ * does not return if it has
+ */
+static void check_call(EffectSession* session, const PeriodCall* call) {
+    if (call->startUs != 0 && atomic_load(&session->callStartUs) != call->startUs) {
+        leave_abandoned_call(session, call);
+    }
+}
+
+/**
+ * Close the call's watched window; does not return if the watchdog
+ * abandoned it
+ */
+static void end_call(EffectSession* session, const PeriodCall* call) {
+    uint64_t expected = call->startUs;
+    if (!atomic_compare_exchange_strong(&session->callStartUs, &expected, 0)) {
+        leave_abandoned_call(session, call);
+    }
+}
+
+static void deinterleave(const uint8_t* src, uint8_t* dst, uint32_t channels,
+                         uint32_t frames, uint32_t bytesPerSample) {
+    if (bytesPerSample == 2) {
+        const int16_t* in = (const int16_t*)src;
+        int16_t* out = (int16_t*)dst;
+        for (uint32_t c = 0; c < channels; c++) {
+            for (uint32_t f = 0; f < frames; f++) {
+                out[c * frames + f] = in[f * channels + c];
+            }
         }
-        
-        int64_t start_time = get_time_us();
-        
-#if USE_FMQ
-        // Read input from FMQ
-        size_t available = effect_fmq_available_to_read(session->inputFmq);
-        if (available < bufferSize) {
-            // Not enough data
-            continue;
+    } else {
+        const uint32_t* in = (const uint32_t*)src;
+        uint32_t* out = (uint32_t*)dst;
+        for (uint32_t c = 0; c < channels; c++) {
+            for (uint32_t f = 0; f < frames; f++) {
+                out[c * frames + f] = in[f * channels + c];
+            }
         }
-        
-        size_t read = effect_fmq_read(session->inputFmq, inputBuffer, bufferSize);
-        if (read < bufferSize) {
-            pthread_mutex_lock(&session->statsMutex);
-            session->stats.xrunCount++;
-            pthread_mutex_unlock(&session->statsMutex);
-            continue;
+    }
+}
+
+static void interleave(const uint8_t* src, uint8_t* dst, uint32_t channels,
+                       uint32_t frames, uint32_t bytesPerSample) {
+    if (bytesPerSample == 2) {
+        const int16_t* in = (const int16_t*)src;
+        int16_t* out = (int16_t*)dst;
+        for (uint32_t f = 0; f < frames; f++) {
+            for (uint32_t c = 0; c < channels; c++) {
+                out[f * channels + c] = in[c * frames + f];
+            }
         }
-        
-        // Process audio with third-party library
-        mock_process_audio(session->libContext, inputBuffer, outputBuffer, 
-                          session->config.framesPerBuffer, bytesPerFrame);
-        
-        // Write output to FMQ
-        size_t written = effect_fmq_write(session->outputFmq, outputBuffer, bufferSize);
-        if (written < bufferSize) {
-            pthread_mutex_lock(&session->statsMutex);
-            session->stats.droppedFrames += session->config.framesPerBuffer;
-            pthread_mutex_unlock(&session->statsMutex);
-            continue;
+    } else {
+        const uint32_t* in = (const uint32_t*)src;
+        uint32_t* out = (uint32_t*)dst;
+        for (uint32_t f = 0; f < frames; f++) {
+            for (uint32_t c = 0; c < channels; c++) {
+                out[f * channels + c] = in[c * frames + f];
+            }
         }
-#else
-        // Legacy: Read input from ring buffer
-        uint32_t available = effect_ringbuffer_get_read_available(&session->inputRb);
-        if (available < bufferSize) {
-            // Not enough data
-            continue;
+    }
+}
+
+/**
+ * Run the plugin on one contiguous interleaved period
+ * 
+ * Planar plugins go through the call's planar buffers.
+ * 
+ * @return 0 on success, -1 if the plugin failed or there is no context
+ *         (output is then a copy of input)
+ */
+static int run_plugin(EffectSession* session, const PeriodCall* call, const uint8_t* src,
+                      uint8_t* dst) {
+    void* context = call->context;
+    EffectdCallBuffers* buffers = call->buffers;
+    
+    if (session->bypassed) {
+        memcpy(dst, src, session->bufferSize);
+        return 0;
+    }
+    if (!context) {
+        memcpy(dst, src, session->bufferSize);
+        return -1;
+    }
+    
+    uint32_t frames = session->config.framesPerBuffer;
+    uint32_t channels = session->config.channels;
+    uint32_t bytesPerSample = session->bytesPerFrame / channels;
+    EffectPluginBuffer in;
+    EffectPluginBuffer out;
+    int ret;
+    
+    in.frames = frames;
+    out.frames = frames;
+    
+    if (session->pluginLayout == EFFECT_PLUGIN_LAYOUT_INTERLEAVED) {
+        void* inPlane = (void*)src;
+        void* outPlane = dst;
+        in.planes = &inPlane;
+        out.planes = &outPlane;
+        ret = session->plugin.process(context, &in, &out);
+        check_call(session, call);
+    } else {
+        deinterleave(src, buffers->planarIn, channels, frames, bytesPerSample);
+        in.planes = buffers->inPlanes;
+        out.planes = buffers->outPlanes;
+        ret = session->plugin.process(context, &in, &out);
+        check_call(session, call);
+        if (ret == 0) {
+            interleave(buffers->planarOut, dst, channels, frames, bytesPerSample);
         }
-        
-        uint32_t read = effect_ringbuffer_read(&session->inputRb, inputBuffer, bufferSize);
-        if (read < bufferSize) {
-            pthread_mutex_lock(&session->statsMutex);
-            session->stats.xrunCount++;
-            pthread_mutex_unlock(&session->statsMutex);
-            continue;
+    }
+    
+    if (ret != 0) {
+        memcpy(dst, src, session->bufferSize);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * One period of queue memory, as up to two spans
+ */
+typedef struct {
+    uint8_t* first;
+    uint32_t firstSize;
+    uint8_t* second;
+} PeriodSpan;
+
+/**
+ * Run the library on one period whose input lives in queue memory
+ * 
+ * The library reads the input queue directly; only a period that wraps
+ * around the end of the queue is linearized through scratch memory. The
+ * output is left in the call's scratchOut, for commit_output.
+ */
+static int process_period(EffectSession* session, const PeriodCall* call, const PeriodSpan* in) {
+    uint8_t* scratchIn = call->buffers->scratchIn;
+    uint32_t bufferSize = session->bufferSize;
+    const uint8_t* src = in->first;
+    
+    if (in->second) {
+        memcpy(scratchIn, in->first, in->firstSize);
+        memcpy(scratchIn + in->firstSize, in->second, bufferSize - in->firstSize);
+        src = scratchIn;
+    }
+    
+    // Process audio with third-party library
+    return run_plugin(session, call, src, call->buffers->scratchOut);
+}
+
+/**
+ * Copy a period's output into the output queue, once its library calls
+ * returned in time
+ */
+static void commit_output(EffectSession* session, const PeriodCall* call, const PeriodSpan* out) {
+    const uint8_t* scratchOut = call->buffers->scratchOut;
+    uint32_t bufferSize = session->bufferSize;
+    
+    if (out->second) {
+        memcpy(out->first, scratchOut, out->firstSize);
+        memcpy(out->second, scratchOut + out->firstSize, bufferSize - out->firstSize);
+    } else {
+        memcpy(out->first, scratchOut, bufferSize);
+    }
+}
+
+#if !USE_FMQ
+/**
+ * Apply the queued in-band commands that are due at input position
+ * 
+ * The processing context calls this before each period, within the
+ * period's watched window; start and stop flush the ring with UINT64_MAX
+ * while no processing context runs.
+ */
+static void apply_commands(EffectSession* session, uint64_t position, const PeriodCall* call) {
+    void* context = call->context;
+    
+    if (!session->hasCommandRing) {
+        return;
+    }
+    
+    effect_ringbuffer_region_t region;
+    while (effect_ringbuffer_acquire_read(&session->commandRb, EFFECT_COMMAND_SIZE, &region) != 0) {
+        // The ring holds whole records, so one never wraps. Copy it out of
+        // shared memory before trusting its fields.
+        EffectCommand command;
+        memcpy(&command, region.first, sizeof(command));
+        if (command.position > position) {
+            break;
         }
         
-        // Process audio with third-party library
-        mock_process_audio(session->libContext, inputBuffer, outputBuffer, 
-                          session->config.framesPerBuffer, bytesPerFrame);
-        
-        // Write output to ring buffer
-        uint32_t written = effect_ringbuffer_write(&session->outputRb, outputBuffer, bufferSize);
-        if (written < bufferSize) {
-            pthread_mutex_lock(&session->statsMutex);
-            session->stats.droppedFrames += session->config.framesPerBuffer;
-            pthread_mutex_unlock(&session->statsMutex);
-            continue;
+        switch (command.type) {
+            case EFFECT_COMMAND_SET_PARAM:
+                if (command.valueSize <= EFFECT_COMMAND_MAX_VALUE_SIZE && context) {
+                    int ret = session->plugin.setParam(context, command.key, command.value,
+                                                       command.valueSize);
+                    check_call(session, call);
+                    if (ret == 0) {
+                        effect_seqlock_write_begin(&session->streamParamsLock);
+                        record_param(session, session->streamParams, &session->numStreamParams,
+                                     command.key, command.value, command.valueSize);
+                        effect_seqlock_write_end(&session->streamParamsLock);
+                    }
+                }
+                break;
+            case EFFECT_COMMAND_RESET:
+                if (context) {
+                    session->plugin.reset(context);
+                    check_call(session, call);
+                }
+                break;
+            case EFFECT_COMMAND_BYPASS:
+                session->bypassed = command.key != 0;
+                break;
+            default:
+                break;
         }
+        effect_ringbuffer_release_read(&session->commandRb, EFFECT_COMMAND_SIZE);
+    }
+}
 #endif
+
+/**
+ * Process one queued period, if a whole one is available
+ * 
+ * @return true if a period was consumed, false if the input queue is empty
+ *         or the output queue has no room for the result
+ */
+static bool process_one_period(EffectSession* session) {
+    uint32_t bufferSize = session->bufferSize;
+    int64_t start_time = get_time_us();
+    PeriodCall call;
+    PeriodSpan in;
+    PeriodSpan out;
+    int ret;
+    
+#if USE_FMQ
+    // Access input in place
+    EffectFmqRegion inRegion;
+    if (effect_fmq_acquire_read(session->inputFmq, bufferSize, &inRegion) < 0) {
+        // Not enough data
+        session->deadlineUs = 0;
+        return false;
+    }
+    
+    EffectFmqRegion outRegion;
+    if (effect_fmq_acquire_write(session->outputFmq, bufferSize, &outRegion) < 0) {
+        // Client has not drained its output yet; leave the input queued so
+        // every input period still yields exactly one output period
+        return false;
+    }
+    
+    in.first = (uint8_t*)inRegion.first;
+    in.firstSize = (uint32_t)inRegion.firstSize;
+    in.second = (uint8_t*)inRegion.second;
+    out.first = (uint8_t*)outRegion.first;
+    out.firstSize = (uint32_t)outRegion.firstSize;
+    out.second = (uint8_t*)outRegion.second;
+    
+    // The watchdog times the library calls from here on; while it builds a
+    // replacement context, audio passes through
+    call.context = atomic_load(&session->contextReady) ? session->libContext : NULL;
+    call.buffers = session->buffers;
+    call.startUs = (uint64_t)start_time;
+    atomic_store(&session->callStartUs, call.startUs);
+    ret = process_period(session, &call, &in);
+    end_call(session, &call);
+    
+    commit_output(session, &call, &out);
+    effect_fmq_commit_write(session->outputFmq, bufferSize);
+    effect_fmq_release_read(session->inputFmq, bufferSize);
+#else
+    // Legacy: Access one whole period in place in the ring buffer
+    effect_ringbuffer_region_t inRegion;
+    if (effect_ringbuffer_acquire_read(&session->inputRb, bufferSize, &inRegion) == 0) {
+        // Not enough data
+        session->deadlineUs = 0;
+        return false;
+    }
+    
+    effect_ringbuffer_region_t outRegion;
+    if (effect_ringbuffer_acquire_write(&session->outputRb, bufferSize, &outRegion) == 0) {
+        // Client has not drained its output yet; leave the input queued so
+        // every input period still yields exactly one output period
+        return false;
+    }
+    
+    in.first = inRegion.first;
+    in.firstSize = inRegion.firstSize;
+    in.second = inRegion.second;
+    out.first = outRegion.first;
+    out.firstSize = outRegion.firstSize;
+    out.second = outRegion.second;
+    
+    // The watchdog times the library calls from here on; while it builds a
+    // replacement context, audio passes through and commands wait for it
+    bool ready = atomic_load(&session->contextReady) != 0;
+    call.context = ready ? session->libContext : NULL;
+    call.buffers = session->buffers;
+    call.startUs = (uint64_t)start_time;
+    atomic_store(&session->callStartUs, call.startUs);
+    
+    // Commands queued before the HAL submitted this period apply from it on
+    if (ready) {
+        apply_commands(session, effect_ringbuffer_get_read_position(&session->inputRb), &call);
+    }
+    
+    ret = process_period(session, &call, &in);
+    end_call(session, &call);
+    
+    commit_output(session, &call, &out);
+    effect_ringbuffer_commit_write(&session->outputRb, bufferSize);
+    effect_ringbuffer_release_read(&session->inputRb, bufferSize);
+#endif
+    
+    // Signal output data available
+    effect_wakeup_signal(&session->outputWakeup);
+    
+    // Update statistics
+    int64_t end_time = get_time_us();
+    uint32_t latency = (uint32_t)(end_time - start_time);
+    bool missed = session->deadlineUs != 0 && end_time > session->deadlineUs;
+    
+    // The next queued period, if any, arrived about one period later
+    if (session->deadlineUs != 0) {
+        session->deadlineUs = effectd_session_has_pending(session) ?
+                              session->deadlineUs + session->periodUs : 0;
+    }
+    
+    effect_seqlock_write_begin(&session->statsLock);
+    session->stats.processedFrames += session->config.framesPerBuffer;
+    if (ret != 0) {
+        // Passed through unprocessed
+        session->stats.droppedFrames += session->config.framesPerBuffer;
+    }
+    if (missed) {
+        session->stats.deadlineMissCount++;
+    }
+    effect_histogram_record(&session->latencyHist, latency);
+    effect_seqlock_write_end(&session->statsLock);
+    
+    return true;
+}
+
+int effectd_session_process_periods(EffectSession* session, uint32_t maxPeriods) {
+    uint32_t processed = 0;
+    
+    while (processed < maxPeriods && session->threadRunning &&
+           process_one_period(session)) {
+        processed++;
+    }
+    
+    return (int)processed;
+}
+
+int effectd_session_process_pending(EffectSession* session) {
+    // Signals coalesce, so drain every queued period
+    return effectd_session_process_periods(session, UINT32_MAX);
+}
+
+int64_t effectd_session_mark_ready(EffectSession* session, int64_t nowUs) {
+    if (session->deadlineUs == 0 && session->periodUs != 0) {
+        session->deadlineUs = nowUs + session->periodUs;
+    }
+    return session->deadlineUs;
+}
+
+bool effectd_session_has_pending(EffectSession* session) {
+#if USE_FMQ
+    return effect_fmq_available_to_read(session->inputFmq) >= session->bufferSize;
+#else
+    return effect_ringbuffer_get_read_periods(&session->inputRb) > 0;
+#endif
+}
+
+static void* processing_thread_func(void* arg) {
+    EffectSession* session = (EffectSession*)arg;
+    
+    // Affinity and scheduling class of the effect type, as admitted
+    effectd_sched_apply(&session->schedGrant);
+    
+    while (session->threadRunning) {
+        // Wait for input data notification
+        int wait_result = effect_wakeup_wait(&session->inputWakeup, 100000); // 100ms timeout
         
-        // Signal output data available
-        effect_eventfd_signal(session->eventFdOut);
-        
-        // Update statistics
-        int64_t end_time = get_time_us();
-        uint32_t latency = (uint32_t)(end_time - start_time);
-        
-        pthread_mutex_lock(&session->statsMutex);
-        session->stats.processedFrames += session->config.framesPerBuffer;
-        
-        if (session->stats.avgLatencyUs == 0) {
-            session->stats.avgLatencyUs = latency;
-        } else {
-            session->stats.avgLatencyUs = (session->stats.avgLatencyUs * 9 + latency) / 10;
-        }
-        
-        if (latency > session->stats.maxLatencyUs) {
-            session->stats.maxLatencyUs = latency;
-        }
-        
-        if (latency > session->stats.p95LatencyUs) {
-            session->stats.p95LatencyUs = latency;
+        if (wait_result < 0) {
+            // Timeout or error - continue waiting
+            continue;
         }
         
-        pthread_mutex_unlock(&session->statsMutex);
+        effectd_session_mark_ready(session, get_time_us());
+        effectd_session_process_pending(session);
     }
     
-    free(inputBuffer);
-    free(outputBuffer);
-    
+    atomic_store(&session->threadActive, 0);
     return NULL;
 }
 
+static int spawn_processing_thread(EffectSession* session) {
+    atomic_store(&session->threadActive, 1);
+    if (pthread_create(&session->processingThread, NULL, processing_thread_func, session) != 0) {
+        atomic_store(&session->threadActive, 0);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Bytes a set of call buffers occupies in an arena (for sizing)
+ */
+static size_t call_buffers_footprint(uint32_t bufferSize, uint32_t channels) {
+    return effect_arena_footprint(sizeof(EffectdCallBuffers)) +
+           4 * effect_arena_footprint(bufferSize) +
+           2 * effect_arena_footprint(channels * sizeof(void*));
+}
+
+/**
+ * Carve a set of call buffers for the given period geometry out of arena
+ */
+static EffectdCallBuffers* alloc_call_buffers(effect_arena_t* arena, uint32_t bufferSize,
+                                              uint32_t channels) {
+    EffectdCallBuffers* buffers =
+        (EffectdCallBuffers*)effect_arena_alloc(arena, sizeof(EffectdCallBuffers));
+    if (!buffers) {
+        return NULL;
+    }
+    
+    buffers->scratchIn = (uint8_t*)effect_arena_alloc(arena, bufferSize);
+    buffers->scratchOut = (uint8_t*)effect_arena_alloc(arena, bufferSize);
+    buffers->planarIn = (uint8_t*)effect_arena_alloc(arena, bufferSize);
+    buffers->planarOut = (uint8_t*)effect_arena_alloc(arena, bufferSize);
+    buffers->inPlanes = (void**)effect_arena_alloc(arena, channels * sizeof(void*));
+    buffers->outPlanes = (void**)effect_arena_alloc(arena, channels * sizeof(void*));
+    
+    uint32_t planeSize = bufferSize / channels;
+    for (uint32_t c = 0; c < channels; c++) {
+        buffers->inPlanes[c] = buffers->planarIn + c * planeSize;
+        buffers->outPlanes[c] = buffers->planarOut + c * planeSize;
+    }
+    return buffers;
+}
+
+/**
+ * Map a set of call buffers of its own, to replace the set a stuck thread
+ * keeps
+ */
+static EffectdCallBuffers* create_call_buffers(EffectSession* session) {
+    uint32_t channels = session->config.channels;
+    effect_arena_t arena;
+    
+    if (effect_arena_create(&arena, call_buffers_footprint(session->bufferSize, channels)) < 0) {
+        return NULL;
+    }
+    
+    EffectdCallBuffers* buffers = alloc_call_buffers(&arena, session->bufferSize, channels);
+    buffers->arena = arena;
+    buffers->ownArena = true;
+    return buffers;
+}
+
 EffectSession* effectd_session_create(uint32_t sessionId, EffectLibType effectType, 
                                       const AudioConfig* config) {
-    EffectSession* session = (EffectSession*)calloc(1, sizeof(EffectSession));
-    if (!session) {
+    if (!config || config->channels == 0 || config->framesPerBuffer == 0) {
+        return NULL;
+    }
+    
+    uint32_t bytesPerFrame = calculate_bytes_per_frame(config);
+    uint64_t bufferSize = (uint64_t)config->framesPerBuffer * bytesPerFrame;
+    if (bufferSize > MAX_BUFFER_SIZE) {
         return NULL;
     }
     
+    // Everything the processing path touches lives in one locked arena sized
+    // for this config: the session (with its stats) and the first call
+    // buffers. Ring storage is the client's shared memory, locked on attach.
+    size_t arenaSize = effect_arena_footprint(sizeof(EffectSession)) +
+                       call_buffers_footprint((uint32_t)bufferSize, config->channels);
+    
+    effect_arena_t arena;
+    if (effect_arena_create(&arena, arenaSize) < 0) {
+        return NULL;
+    }
+    
+    EffectSession* session = (EffectSession*)effect_arena_alloc(&arena, sizeof(EffectSession));
+    session->bytesPerFrame = bytesPerFrame;
+    session->bufferSize = (uint32_t)bufferSize;
+    session->periodUs = config->sampleRate ?
+                        (uint32_t)((uint64_t)config->framesPerBuffer * 1000000 / config->sampleRate) : 0;
+    session->buffers = alloc_call_buffers(&arena, session->bufferSize, config->channels);
+    session->arena = arena;
+    
     session->sessionId = sessionId;
     session->effectType = effectType;
     session->config = *config;
     session->state = SESSION_STATE_IDLE;
     session->eventFdIn = -1;
     session->eventFdOut = -1;
+#if !USE_FMQ
+    session->shmFd = -1;
+#endif
+    
+    atomic_store(&session->refs, 1);
+    
+    effect_seqlock_init(&session->statsLock);
+    pthread_mutex_init(&session->intervalMutex, NULL);
+    pthread_mutex_init(&session->contextLock, NULL);
+    pthread_mutex_init(&session->callLock, NULL);
+    effect_seqlock_init(&session->streamParamsLock);
     
-    pthread_mutex_init(&session->statsMutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&session->callCond, &attr);
+    pthread_condattr_destroy(&attr);
     
     return session;
 }
 
+static void fill_plugin_config(const EffectSession* session, uint32_t layout,
+                               EffectPluginConfig* pluginConfig) {
+    pluginConfig->sampleRate = session->config.sampleRate;
+    pluginConfig->channels = session->config.channels;
+    pluginConfig->format = session->config.format;
+    pluginConfig->framesPerBuffer = session->config.framesPerBuffer;
+    pluginConfig->layout = layout;
+}
+
+/**
+ * Set the parameters of one table that the other has no later value for
+ */
+static void replay_params(EffectSession* session, void* context, const EffectdParam* params,
+                          uint32_t numParams, const EffectdParam* other, uint32_t numOther) {
+    for (uint32_t i = 0; i < numParams; i++) {
+        bool latest = params[i].kept;
+        for (uint32_t j = 0; latest && j < numOther; j++) {
+            latest = other[j].key != params[i].key || other[j].serial < params[i].serial;
+        }
+        if (latest) {
+            session->plugin.setParam(context, params[i].key, params[i].value, params[i].valueSize);
+        }
+    }
+}
+
+/**
+ * Control-side library calls
+ */
+typedef enum {
+    CONTROL_CALL_CREATE,              // Create the context, interleaved layout if accepted
+    CONTROL_CALL_SET_PARAM,
+    CONTROL_CALL_SET_PARAM_BLOB,
+    CONTROL_CALL_GET_LATENCY,
+    CONTROL_CALL_RESET,               // Reset, then apply the queued commands (start)
+    CONTROL_CALL_FLUSH,               // Apply the queued commands (stop)
+    CONTROL_CALL_DESTROY,
+    CONTROL_CALL_RECREATE,            // Replace an abandoned context (watchdog)
+} ControlCallOp;
+
+/**
+ * A control-side library call, run on a thread of its own so that the
+ * control thread can give up on it
+ * 
+ * Freed by the control thread once done, or by the call's thread if it was
+ * given up on. Everything the library sees belongs to the call.
+ */
+typedef struct {
+    EffectSession* session;           // Referenced by the call's thread
+    ControlCallOp op;
+    void* context;                    // Context called into, or created
+    uint32_t layout;                  // EffectPluginLayout created with
+    uint32_t key;
+    struct EffectdBlob* blob;         // Referenced by the call's thread
+    int result;
+    uint32_t latency;
+    bool done;                        // Guarded by session->callLock
+    bool abandoned;                   // Likewise
+    uint32_t valueSize;
+    uint8_t value[];
+} ControlCall;
+
+static ControlCall* new_control_call(ControlCallOp op, void* context, uint32_t valueSize) {
+    ControlCall* call = (ControlCall*)calloc(1, sizeof(ControlCall) + valueSize);
+    if (call) {
+        call->op = op;
+        call->context = context;
+        call->valueSize = valueSize;
+    }
+    return call;
+}
+
+/**
+ * Create a context like the abandoned one, with the parameters it was given
+ * 
+ * Control calls fail while the session has no context, so they leave its
+ * parameter table and blobs alone until the session has one again.
+ * 
+ * @return 0, or the library's error from create
+ */
+static int recreate_context(EffectSession* session, ControlCall* call) {
+    EffectPluginConfig pluginConfig;
+    
+    fill_plugin_config(session, call->layout, &pluginConfig);
+    int ret = session->plugin.create(&pluginConfig, &call->context);
+    if (ret != 0) {
+        return ret;
+    }
+    
+    // The processing context may record a command meanwhile; work on a
+    // snapshot of its table
+    EffectdParam stream[EFFECTD_SESSION_MAX_PARAMS];
+    uint32_t numStream;
+    unsigned int seq;
+    do {
+        seq = effect_seqlock_read_begin(&session->streamParamsLock);
+        numStream = session->numStreamParams;
+        if (numStream > EFFECTD_SESSION_MAX_PARAMS) {
+            numStream = EFFECTD_SESSION_MAX_PARAMS;
+        }
+        memcpy(stream, session->streamParams, numStream * sizeof(EffectdParam));
+    } while (effect_seqlock_read_retry(&session->streamParamsLock, seq));
+    
+    replay_params(session, call->context, session->params, session->numParams,
+                  stream, numStream);
+    replay_params(session, call->context, stream, numStream,
+                  session->params, session->numParams);
+    
+    for (uint32_t i = 0; i < session->numBlobs; i++) {
+        session->plugin.setParamBlob(call->context, session->blobKeys[i],
+                                     effectd_blob_get_data(session->blobs[i]),
+                                     effectd_blob_get_size(session->blobs[i]));
+    }
+    return 0;
+}
+
+static void* control_call_thread(void* arg) {
+    ControlCall* call = (ControlCall*)arg;
+    EffectSession* session = call->session;
+    struct EffectdBlob* blob = call->blob;
+    EffectPluginConfig pluginConfig;
+    
+    switch (call->op) {
+        case CONTROL_CALL_CREATE:
+            // Rings carry interleaved audio, so offer that first
+            fill_plugin_config(session, EFFECT_PLUGIN_LAYOUT_INTERLEAVED, &pluginConfig);
+            call->result = session->plugin.create(&pluginConfig, &call->context);
+            if (call->result != 0) {
+                pluginConfig.layout = EFFECT_PLUGIN_LAYOUT_PLANAR;
+                call->result = session->plugin.create(&pluginConfig, &call->context);
+            }
+            call->layout = pluginConfig.layout;
+            break;
+        case CONTROL_CALL_SET_PARAM:
+            call->result = session->plugin.setParam(call->context, call->key, call->value,
+                                                    call->valueSize);
+            break;
+        case CONTROL_CALL_SET_PARAM_BLOB:
+            if (session->plugin.setParamBlob) {
+                call->result = session->plugin.setParamBlob(call->context, call->key,
+                                                            effectd_blob_get_data(blob),
+                                                            effectd_blob_get_size(blob));
+            } else {
+                // Older plugins copy the value themselves
+                call->result = effectd_blob_get_size(blob) > UINT32_MAX ? -1 :
+                               session->plugin.setParam(call->context, call->key,
+                                                        effectd_blob_get_data(blob),
+                                                        (uint32_t)effectd_blob_get_size(blob));
+            }
+            break;
+        case CONTROL_CALL_GET_LATENCY:
+            call->latency = session->plugin.getLatency(call->context);
+            break;
+        case CONTROL_CALL_RESET:
+        case CONTROL_CALL_FLUSH:
+            if (call->op == CONTROL_CALL_RESET && call->context) {
+                session->plugin.reset(call->context);
+            }
+#if !USE_FMQ
+            {
+                PeriodCall unwatched = { call->context, NULL, 0 };
+                apply_commands(session, UINT64_MAX, &unwatched);
+            }
+#endif
+            break;
+        case CONTROL_CALL_DESTROY:
+            session->plugin.destroy(call->context);
+            break;
+        case CONTROL_CALL_RECREATE:
+            call->result = recreate_context(session, call);
+            break;
+    }
+    
+    pthread_mutex_lock(&session->callLock);
+    call->done = true;
+    bool abandoned = call->abandoned;
+    void* retired = NULL;
+    if (abandoned && (call->op == CONTROL_CALL_CREATE || call->op == CONTROL_CALL_RECREATE)) {
+        // Nobody took the context
+        retired = call->result == 0 ? call->context : NULL;
+    } else if (abandoned && call->context && call->context == session->stuckContext) {
+        retired = session->retireStuck ? call->context : NULL;
+        session->stuckContext = NULL;
+        session->retireStuck = false;
+    }
+    pthread_cond_broadcast(&session->callCond);
+    pthread_mutex_unlock(&session->callLock);
+    
+    // Once done, the call is the control thread's
+    if (abandoned) {
+        if (retired) {
+            session->plugin.destroy(retired);
+        }
+        free(call);
+    }
+    effectd_blob_release(blob);
+    release_session(session);
+    return NULL;
+}
+
+/**
+ * Run a library call on a thread of its own and wait for it at most
+ * EFFECTD_SESSION_CALL_TIMEOUT_MS
+ * 
+ * A call given up on keeps its context (stuckContext) until it returns, and
+ * until then every other call but DESTROY fails at once rather than pile
+ * up behind the library.
+ * 
+ * @return 0 if the call returned in time (the caller frees it), -1 if it
+ *         could not run or was given up on (the caller must not touch it)
+ */
+static int run_control_call(EffectSession* session, ControlCall* call) {
+    if (!call) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&session->callLock);
+    bool busy = call->op != CONTROL_CALL_DESTROY && session->stuckContext != NULL;
+    pthread_mutex_unlock(&session->callLock);
+    if (busy) {
+        free(call);
+        return -1;
+    }
+    
+    call->session = session;
+    atomic_fetch_add(&session->refs, 1);
+    if (call->blob) {
+        effectd_blob_acquire(call->blob);
+    }
+    
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&thread, &attr, control_call_thread, call);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        effectd_blob_release(call->blob);
+        atomic_fetch_sub(&session->refs, 1);
+        free(call);
+        return -1;
+    }
+    
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += EFFECTD_SESSION_CALL_TIMEOUT_MS / 1000;
+    deadline.tv_nsec += (long)(EFFECTD_SESSION_CALL_TIMEOUT_MS % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    
+    pthread_mutex_lock(&session->callLock);
+    while (!call->done &&
+           pthread_cond_timedwait(&session->callCond, &session->callLock, &deadline) != ETIMEDOUT) {
+    }
+    bool done = call->done;
+    if (!done) {
+        call->abandoned = true;
+        if (call->op != CONTROL_CALL_CREATE && call->op != CONTROL_CALL_RECREATE &&
+            call->op != CONTROL_CALL_DESTROY) {
+            session->stuckContext = call->context;
+        }
+    }
+    pthread_mutex_unlock(&session->callLock);
+    
+    if (!done) {
+        syslog(LOG_ERR, "Session %u: library call %d stuck for %d ms, given up",
+               session->sessionId, (int)call->op, EFFECTD_SESSION_CALL_TIMEOUT_MS);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Run a call that takes nothing but the session's context
+ * 
+ * @return 0 if it returned in time, -1 otherwise
+ */
+static int run_context_call(EffectSession* session, ControlCallOp op) {
+    ControlCall* call = new_control_call(op, session->libContext, 0);
+    if (run_control_call(session, call) < 0) {
+        return -1;
+    }
+    free(call);
+    return 0;
+}
+
 int effectd_session_open(EffectSession* session) {
     if (!session || session->state != SESSION_STATE_IDLE) {
         return -1;
     }
     
-    // Load third-party library
-    // In real implementation, would load library with dlopen
-    // const char* libPath = NULL;
-    // switch (session->effectType) {
-    //     case EFFECT_LIB_KARAOKE_NO_MIC:
-    //         libPath = "libwt_ksong_signalprocessing.so";
-    //         break;
-    //     case EFFECT_LIB_NOISE_REDUCTION:
-    //         libPath = "libwt_signalprocessing.so";
-    //         break;
-    //     default:
-    //         return -1;
-    // }
+    // Reserve the effect type's declared CPU budget first, so overload is
+    // refused here rather than showing up later as timeouts
+    if (effectd_sched_admit((uint32_t)session->effectType, session->config.sampleRate,
+                            session->config.framesPerBuffer, &session->schedGrant) < 0) {
+        return -1;
+    }
     
-    // session->libHandle = dlopen(libPath, RTLD_NOW);
-    // if (!session->libHandle) {
-    //     return -1;
-    // }
+    // Load third-party library through its plugin and resolve every entry point
+    const char* libPath = effectd_plugin_get_library(session->effectType);
+    if (libPath) {
+        session->libHandle = effectd_plugin_load(libPath, &session->plugin);
+    }
+    if (!session->libHandle) {
+        effectd_sched_release(&session->schedGrant);
+        return -1;
+    }
     
-    // Initialize library context
-    // session->libContext = ...;
+    // A create given up on is still in the library, which stays loaded
+    // until the session's last reference goes
+    ControlCall* call = new_control_call(CONTROL_CALL_CREATE, NULL, 0);
+    if (run_control_call(session, call) < 0) {
+        effectd_sched_release(&session->schedGrant);
+        return -1;
+    }
+    int ret = call->result;
+    session->libContext = ret == 0 ? call->context : NULL;
+    atomic_store(&session->contextReady, 1);
+    session->pluginLayout = call->layout;
+    free(call);
+    if (ret != 0) {
+        effectd_plugin_unload(session->libHandle);
+        session->libHandle = NULL;
+        effectd_sched_release(&session->schedGrant);
+        return -1;
+    }
     
     session->state = SESSION_STATE_OPENED;
     return 0;
 }
 
+#if !USE_FMQ
+/**
+ * Bind the session's rings to a mapping laid out as described by layout
+ */
+static int attach_rings(EffectSession* session, uint8_t* addr,
+                        const EffectSharedMemoryLayout* layout) {
+    if ((uint64_t)layout->inputRingBufferOffset + layout->inputRingBufferSize > layout->size ||
+        (uint64_t)layout->outputRingBufferOffset + layout->outputRingBufferSize > layout->size) {
+        return -1;
+    }
+    
+    if (effect_ringbuffer_attach(&session->inputRb, addr + layout->inputRingBufferOffset,
+                                 layout->inputRingBufferSize) < 0 ||
+        effect_ringbuffer_attach(&session->outputRb, addr + layout->outputRingBufferOffset,
+                                 layout->outputRingBufferSize) < 0) {
+        return -1;
+    }
+    
+    // Both rings must move exactly one processing period at a time
+    if (session->inputRb.quantum != session->bufferSize ||
+        session->outputRb.quantum != session->bufferSize) {
+        return -1;
+    }
+    
+    // The command ring is optional, but must hold whole commands
+    session->hasCommandRing = false;
+    if (layout->commandRingBufferSize != 0) {
+        if ((uint64_t)layout->commandRingBufferOffset + layout->commandRingBufferSize > layout->size ||
+            effect_ringbuffer_attach(&session->commandRb, addr + layout->commandRingBufferOffset,
+                                     layout->commandRingBufferSize) < 0 ||
+            session->commandRb.quantum != EFFECT_COMMAND_SIZE) {
+            return -1;
+        }
+        session->hasCommandRing = true;
+    }
+    return 0;
+}
+
+int effectd_session_attach_shared_memory(EffectSession* session, int shmFd,
+                                         const EffectSharedMemoryLayout* layout,
+                                         int eventFdIn, int eventFdOut) {
+    if (!session || !layout || shmFd < 0 || session->state != SESSION_STATE_OPENED) {
+        return -1;
+    }
+    
+    void* addr = effect_shared_memory_map(shmFd, (size_t)layout->size, 0);
+    if (!addr) {
+        return -1;
+    }
+    
+    if (attach_rings(session, (uint8_t*)addr, layout) < 0) {
+        effect_shared_memory_unmap(addr, (size_t)layout->size);
+        return -1;
+    }
+    
+    session->shmFd = shmFd;
+    session->shmAddr = addr;
+    session->shmSize = (size_t)layout->size;
+    session->eventFdIn = eventFdIn;
+    session->eventFdOut = eventFdOut;
+    return 0;
+}
+
+int effectd_session_attach_pool(EffectSession* session, EffectShmPool* pool,
+                                const EffectSharedMemoryLayout* layout,
+                                int eventFdIn, int eventFdOut) {
+    if (!session || !pool || !layout || session->state != SESSION_STATE_OPENED ||
+        layout->size != effect_shm_pool_get_size(pool)) {
+        return -1;
+    }
+    
+    if (attach_rings(session, (uint8_t*)effect_shm_pool_get_base(pool), layout) < 0) {
+        return -1;
+    }
+    
+    effect_shm_pool_acquire(pool);
+    session->shmPool = pool;
+    session->shmAddr = effect_shm_pool_get_base(pool);
+    session->shmSize = (size_t)layout->size;
+    session->eventFdIn = eventFdIn;
+    session->eventFdOut = eventFdOut;
+    return 0;
+}
+#endif
+
 int effectd_session_start(EffectSession* session) {
-    if (!session || session->state != SESSION_STATE_OPENED) {
+    if (!session || (session->state != SESSION_STATE_OPENED &&
+                     session->state != SESSION_STATE_STOPPED)) {
         return -1;
     }
     
+#if USE_FMQ
+    // FMQ has no doorbell in our ring header, so always use eventfds
+    EffectWakeupType wakeupType = EFFECT_WAKEUP_EVENTFD;
+    effect_ringbuffer_t* inputRb = NULL;
+    effect_ringbuffer_t* outputRb = NULL;
+#else
+    EffectWakeupType wakeupType = (EffectWakeupType)session->config.wakeupType;
+    effect_ringbuffer_t* inputRb = session->shmAddr ? &session->inputRb : NULL;
+    effect_ringbuffer_t* outputRb = session->shmAddr ? &session->outputRb : NULL;
+#endif
+    
+    if (effect_wakeup_init(&session->inputWakeup, wakeupType, session->eventFdIn, inputRb, 0) < 0 ||
+        effect_wakeup_init(&session->outputWakeup, wakeupType, session->eventFdOut, outputRb, 0) < 0) {
+        return -1;
+    }
+    
+    // A restarted stream must not hear the tail of the previous one
+    if (run_context_call(session, CONTROL_CALL_RESET) < 0) {
+        return -1;
+    }
+    session->deadlineUs = 0;
+    
     session->threadRunning = true;
     
-    if (pthread_create(&session->processingThread, NULL, processing_thread_func, session) != 0) {
+    // Watched from the first period on
+    if (session->watchdog && effectd_watchdog_add_session(session->watchdog, session) < 0) {
+        syslog(LOG_WARNING, "Session %u: watchdog full, library calls run unwatched",
+               session->sessionId);
+    }
+    
+    // A busy-poll dispatcher serves any session without waiting on it.
+    // Otherwise prefer the shared worker pool; it only serves eventfd
+    // sessions, so fall back to a dedicated thread for the others. Both
+    // run at one fixed policy: a session admitted with another one (class,
+    // priority, CPUs, or downgraded) needs a thread of its own.
+    bool shared = effectd_sched_fits_shared(&session->schedGrant);
+    session->polled = shared && session->poller &&
+                      effectd_poller_add_session(session->poller, session) == 0;
+    session->pooled = shared && !session->polled && session->workerPool &&
+                      effectd_worker_pool_add_session(session->workerPool, session) == 0;
+    if (!shared && (session->poller || session->workerPool)) {
+        syslog(LOG_INFO, "Session %u: scheduling policy of its type needs a dedicated thread",
+               session->sessionId);
+    }
+    
+    if (!session->polled && !session->pooled && spawn_processing_thread(session) < 0) {
         session->threadRunning = false;
+        effectd_watchdog_remove_session(session->watchdog, session);
         return -1;
     }
     
@@ -225,9 +1106,31 @@ int effectd_session_stop(EffectSession* session) {
         return -1;
     }
     
+    // A dispatcher stuck in the library lets go once the watchdog has
+    // replaced its thread, so the session is watched until then
     session->threadRunning = false;
-    pthread_join(session->processingThread, NULL);
+    if (session->polled) {
+        effectd_poller_remove_session(session->poller, session);
+    } else if (session->pooled) {
+        effectd_worker_pool_remove_session(session->workerPool, session);
+    } else {
+        // Wake the thread rather than wait out its poll timeout; the thread
+        // may be replaced meanwhile, so wait for whichever one is current
+        effect_wakeup_signal(&session->inputWakeup);
+        while (atomic_load(&session->threadActive)) {
+            sched_yield();
+        }
+    }
+    effectd_watchdog_remove_session(session->watchdog, session);
+    
+    if (!session->polled && !session->pooled) {
+        pthread_join(session->processingThread, NULL);
+    }
+    session->polled = false;
+    session->pooled = false;
     
+    // Nothing drains the ring while stopped; settle what is queued now
+    run_context_call(session, CONTROL_CALL_FLUSH);
     session->state = SESSION_STATE_STOPPED;
     return 0;
 }
@@ -241,29 +1144,239 @@ void effectd_session_destroy(EffectSession* session) {
         effectd_session_stop(session);
     }
     
-    // Unload library
-    if (session->libHandle) {
-        dlclose(session->libHandle);
+    // Contexts abandoned by the watchdog, or stuck in a control-side call,
+    // are destroyed by their threads
+    if (session->libContext && !retire_to_stuck_call(session, session->libContext)) {
+        run_context_call(session, CONTROL_CALL_DESTROY);
     }
+    session->libContext = NULL;
+    effectd_sched_release(&session->schedGrant);
     
-    // Clean up event FDs (if owned by session)
-    // Note: In real implementation, FDs are passed from client
+    release_session(session);
+}
+
+/**
+ * Drop a reference; the last one unloads the library and frees the
+ * session, once no context uses its memory any more
+ */
+static void release_session(EffectSession* session) {
+    if (atomic_fetch_sub(&session->refs, 1) != 1) {
+        return;
+    }
+    
+    effectd_plugin_unload(session->libHandle);
     
-    pthread_mutex_destroy(&session->statsMutex);
+    // Only now that the plugin is gone can the mappings it used go
+    for (uint32_t i = 0; i < session->numBlobs; i++) {
+        effectd_blob_release(session->blobs[i]);
+    }
+    
+    // Clean up shared memory and event FDs passed from client
+#if !USE_FMQ
+    if (session->shmPool) {
+        effect_shm_pool_release(session->shmPool);
+    } else if (session->shmAddr) {
+        effect_shared_memory_unmap(session->shmAddr, session->shmSize);
+    }
+    if (session->shmFd >= 0) close(session->shmFd);
+#endif
+    if (session->eventFdIn >= 0) close(session->eventFdIn);
+    if (session->eventFdOut >= 0) close(session->eventFdOut);
+    
+    pthread_mutex_destroy(&session->intervalMutex);
+    pthread_mutex_destroy(&session->contextLock);
+    pthread_cond_destroy(&session->callCond);
+    pthread_mutex_destroy(&session->callLock);
+    
+    free_call_buffers(session->buffers);
+    effect_arena_destroy(&session->arena);
+}
+
+int effectd_session_set_param(EffectSession* session, uint32_t key,
+                              const void* value, uint32_t valueSize) {
+    if (!session) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&session->contextLock);
+    int ret = -1;
+    ControlCall* call = session->libContext ?
+                        new_control_call(CONTROL_CALL_SET_PARAM, session->libContext, valueSize) :
+                        NULL;
+    if (call) {
+        call->key = key;
+        memcpy(call->value, value, valueSize);
+    }
+    if (run_control_call(session, call) == 0) {
+        ret = call->result == 0 ? 0 : -1;
+        free(call);
+    }
+    if (ret == 0) {
+        record_param(session, session->params, &session->numParams, key, value, valueSize);
+    }
+    pthread_mutex_unlock(&session->contextLock);
+    return ret;
+}
+
+static int set_param_blob_locked(EffectSession* session, uint32_t key, struct EffectdBlob* blob) {
+    uint32_t index = 0;
+    while (index < session->numBlobs && session->blobKeys[index] != key) {
+        index++;
+    }
+    if (session->plugin.setParamBlob && index == EFFECTD_SESSION_MAX_BLOBS) {
+        return -1;
+    }
+    
+    ControlCall* call = new_control_call(CONTROL_CALL_SET_PARAM_BLOB, session->libContext, 0);
+    if (call) {
+        call->key = key;
+        call->blob = blob;
+    }
+    if (run_control_call(session, call) < 0) {
+        return -1;
+    }
+    int ret = call->result;
+    free(call);
+    if (ret != 0) {
+        return -1;
+    }
+    
+    if (!session->plugin.setParamBlob) {
+        // Older plugins took a copy
+        record_param(session, session->params, &session->numParams, key,
+                     effectd_blob_get_data(blob), (uint32_t)effectd_blob_get_size(blob));
+        effectd_blob_release(blob);
+        return 0;
+    }
+    
+    // The plugin has let go of the previous value for this key
+    if (index < session->numBlobs) {
+        effectd_blob_release(session->blobs[index]);
+    } else {
+        session->blobKeys[index] = key;
+        session->numBlobs++;
+    }
+    session->blobs[index] = blob;
+    return 0;
+}
+
+int effectd_session_set_param_blob(EffectSession* session, uint32_t key,
+                                   struct EffectdBlob* blob) {
+    if (!session || !blob) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&session->contextLock);
+    int ret = session->libContext ? set_param_blob_locked(session, key, blob) : -1;
+    pthread_mutex_unlock(&session->contextLock);
+    return ret;
+}
+
+uint32_t effectd_session_get_latency(EffectSession* session) {
+    if (!session) {
+        return 0;
+    }
     
-    free(session);
+    pthread_mutex_lock(&session->contextLock);
+    uint32_t latency = 0;
+    ControlCall* call = session->libContext ?
+                        new_control_call(CONTROL_CALL_GET_LATENCY, session->libContext, 0) : NULL;
+    if (run_control_call(session, call) == 0) {
+        latency = call->latency;
+        free(call);
+    }
+    pthread_mutex_unlock(&session->contextLock);
+    return latency;
 }
 
-int effectd_session_set_param(EffectSession* session, 
-                              uint32_t key __attribute__((unused)), 
-                              const void* value __attribute__((unused)), 
-                              uint32_t valueSize __attribute__((unused))) {
+void effectd_session_set_worker_pool(EffectSession* session, struct EffectdWorkerPool* pool) {
+    if (!session) {
+        return;
+    }
+    session->workerPool = pool;
+}
+
+void effectd_session_set_poller(EffectSession* session, struct EffectdPoller* poller) {
+    if (!session) {
+        return;
+    }
+    session->poller = poller;
+}
+
+void effectd_session_set_watchdog(EffectSession* session, struct EffectdWatchdog* watchdog) {
+    if (!session) {
+        return;
+    }
+    session->watchdog = watchdog;
+}
+
+int effectd_session_abandon_call(EffectSession* session, uint64_t startUs) {
     if (!session) {
         return -1;
     }
     
-    // TODO: Call third-party library's setParam function
+    // A control call may be the one stuck; never wait for it
+    if (pthread_mutex_trylock(&session->contextLock) != 0) {
+        return -1;
+    }
+    
+    EffectdCallBuffers* buffers = create_call_buffers(session);
+    if (!buffers) {
+        pthread_mutex_unlock(&session->contextLock);
+        return -1;
+    }
     
+    uint64_t expected = startUs;
+    if (!atomic_compare_exchange_strong(&session->callStartUs, &expected,
+                                        EFFECTD_SESSION_CALL_ABANDONED)) {
+        // Returned in the meantime
+        pthread_mutex_unlock(&session->contextLock);
+        free_call_buffers(buffers);
+        return -1;
+    }
+    
+    // The stuck thread owns the old context and buffers now, and a
+    // reference for when (if ever) it returns. Pass audio through until
+    // there is a new context.
+    atomic_fetch_add(&session->refs, 1);
+    atomic_store(&session->contextReady, 0);
+    session->libContext = NULL;
+    session->buffers = buffers;
+    pthread_mutex_unlock(&session->contextLock);
+    
+    // The processing context is stuck, so nothing else writes the stats
+    effect_seqlock_write_begin(&session->statsLock);
+    session->stats.hungCallCount++;
+    effect_seqlock_write_end(&session->statsLock);
+    
+    atomic_store(&session->callStartUs, 0);
+    
+    if (session->polled) {
+        effectd_poller_replace_thread(session->poller);
+    } else if (session->pooled) {
+        effectd_worker_pool_replace_worker(session->workerPool, session);
+    } else {
+        effectd_sched_abandon_thread(session->processingThread);
+        spawn_processing_thread(session);
+    }
+    
+    // The library may hang again, so build the new context like any other
+    // control call. One given up on destroys what it created when it returns.
+    ControlCall* call = new_control_call(CONTROL_CALL_RECREATE, NULL, 0);
+    if (call) {
+        call->layout = session->pluginLayout;
+    }
+    bool done = run_control_call(session, call) == 0;
+    
+    pthread_mutex_lock(&session->contextLock);
+    if (done && call->result == 0) {
+        session->libContext = call->context;
+    }
+    atomic_store(&session->contextReady, 1);
+    pthread_mutex_unlock(&session->contextLock);
+    if (done) {
+        free(call);
+    }
     return 0;
 }
 
@@ -274,12 +1387,58 @@ SessionState effectd_session_get_state(EffectSession* session) {
     return session->state;
 }
 
+static void snapshot_stats(EffectSession* session, SessionStats* stats, effect_histogram_t* hist) {
+    // Never blocks the processing context; retries if it published mid-copy
+    unsigned int seq;
+    do {
+        seq = effect_seqlock_read_begin(&session->statsLock);
+        *stats = session->stats;
+        *hist = session->latencyHist;
+    } while (effect_seqlock_read_retry(&session->statsLock, seq));
+}
+
+static void fill_latency(SessionStats* stats, const effect_histogram_t* hist) {
+    stats->avgLatencyUs = effect_histogram_mean(hist);
+    stats->p50LatencyUs = effect_histogram_percentile(hist, 50.0);
+    stats->p95LatencyUs = effect_histogram_percentile(hist, 95.0);
+    stats->p99LatencyUs = effect_histogram_percentile(hist, 99.0);
+    stats->p999LatencyUs = effect_histogram_percentile(hist, 99.9);
+    stats->maxLatencyUs = hist->max;
+}
+
 void effectd_session_get_stats(EffectSession* session, SessionStats* stats) {
     if (!session || !stats) {
         return;
     }
     
-    pthread_mutex_lock(&session->statsMutex);
-    *stats = session->stats;
-    pthread_mutex_unlock(&session->statsMutex);
+    effect_histogram_t hist;
+    snapshot_stats(session, stats, &hist);
+    fill_latency(stats, &hist);
+}
+
+void effectd_session_get_interval_stats(EffectSession* session, SessionStats* stats) {
+    if (!session || !stats) {
+        return;
+    }
+    
+    SessionStats now;
+    effect_histogram_t nowHist;
+    effect_histogram_t delta;
+    
+    snapshot_stats(session, &now, &nowHist);
+    
+    pthread_mutex_lock(&session->intervalMutex);
+    effect_histogram_subtract(&delta, &nowHist, &session->intervalHist);
+    *stats = now;
+    stats->processedFrames -= session->intervalStats.processedFrames;
+    stats->droppedFrames -= session->intervalStats.droppedFrames;
+    stats->timeoutCount -= session->intervalStats.timeoutCount;
+    stats->xrunCount -= session->intervalStats.xrunCount;
+    stats->deadlineMissCount -= session->intervalStats.deadlineMissCount;
+    stats->hungCallCount -= session->intervalStats.hungCallCount;
+    session->intervalStats = now;
+    session->intervalHist = nowHist;
+    pthread_mutex_unlock(&session->intervalMutex);
+    
+    fill_latency(stats, &delta);
 }
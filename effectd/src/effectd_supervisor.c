@@ -0,0 +1,201 @@
+#include "effectd_supervisor.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#define RESPAWN_INTERVAL_US 500000    // Least time between forks, against crash loops
+
+typedef struct {
+    pid_t pid;                        // 0 if none
+    int promoteFd;                    // Write end of the child's promotion pipe
+} Child;
+
+// In a child: read end of its promotion pipe
+static int g_promotion_fd = -1;
+
+static int64_t get_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000LL;
+}
+
+static void forget(Child* child) {
+    if (child->promoteFd >= 0) {
+        close(child->promoteFd);
+    }
+    child->pid = 0;
+    child->promoteFd = -1;
+}
+
+/**
+ * Fork a new standby
+ *
+ * @return 0 in the child, 1 in the supervisor, -1 on failure
+ */
+static int fork_standby(Child* standby, Child* active, const sigset_t* childMask) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+        return -1;
+    }
+    
+    pid_t supervisor = getpid();
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    
+    if (pid == 0) {
+        // Nothing may outlive the supervisor, which owns the socket
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if (getppid() != supervisor) {
+            _exit(1);
+        }
+        
+        if (active->promoteFd >= 0) {
+            close(active->promoteFd);
+        }
+        close(fds[1]);
+        g_promotion_fd = fds[0];
+        sigprocmask(SIG_SETMASK, childMask, NULL);
+        return 0;
+    }
+    
+    close(fds[0]);
+    standby->pid = pid;
+    standby->promoteFd = fds[1];
+    syslog(LOG_INFO, "Standby effectd %d forked", (int)pid);
+    return 1;
+}
+
+static int promote(Child* standby) {
+    char go = 1;
+    ssize_t ret;
+    do {
+        ret = write(standby->promoteFd, &go, 1);
+    } while (ret < 0 && errno == EINTR);
+    return ret == 1 ? 0 : -1;
+}
+
+static void reap(Child* active, Child* standby) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        if (pid == active->pid) {
+            syslog(LOG_ERR, "Active effectd %d exited (status 0x%x)", (int)pid, status);
+            forget(active);
+        } else if (pid == standby->pid) {
+            syslog(LOG_WARNING, "Standby effectd %d exited (status 0x%x)", (int)pid, status);
+            forget(standby);
+        }
+    }
+}
+
+static void stop_child(Child* child) {
+    if (child->pid == 0) {
+        return;
+    }
+    
+    // A standby waiting for promotion sees the pipe close; the active one
+    // shuts down on SIGTERM
+    pid_t pid = child->pid;
+    forget(child);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+int effectd_supervisor_run(void) {
+    sigset_t mask;
+    sigset_t childMask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    
+    // Signals are taken synchronously below; children get the old mask back
+    if (sigprocmask(SIG_BLOCK, &mask, &childMask) < 0) {
+        return -1;
+    }
+    
+    Child active = { 0, -1 };
+    Child standby = { 0, -1 };
+    int64_t nextForkUs = 0;
+    
+    syslog(LOG_INFO, "Supervising effectd with a hot standby");
+    
+    while (true) {
+        // A dead active is replaced by the standby straight away
+        if (active.pid == 0 && standby.pid != 0) {
+            if (promote(&standby) == 0) {
+                syslog(LOG_INFO, "Effectd %d promoted to active", (int)standby.pid);
+                active = standby;
+                standby.pid = 0;
+                standby.promoteFd = -1;
+            } else {
+                // Dying already; reaped below
+                kill(standby.pid, SIGKILL);
+            }
+        }
+        
+        int64_t now = get_time_us();
+        if (standby.pid == 0 && now >= nextForkUs) {
+            nextForkUs = now + RESPAWN_INTERVAL_US;
+            int forked = fork_standby(&standby, &active, &childMask);
+            if (forked == 0) {
+                return 0;
+            }
+            if (forked < 0) {
+                syslog(LOG_ERR, "Failed to fork standby effectd: %d", errno);
+            }
+            continue;
+        }
+        
+        int sig;
+        if (standby.pid == 0) {
+            int64_t waitUs = nextForkUs - now;
+            struct timespec timeout;
+            timeout.tv_sec = waitUs / 1000000;
+            timeout.tv_nsec = (waitUs % 1000000) * 1000;
+            sig = sigtimedwait(&mask, NULL, &timeout);
+        } else {
+            sig = sigwaitinfo(&mask, NULL);
+        }
+        
+        if (sig == SIGTERM || sig == SIGINT) {
+            break;
+        }
+        if (sig == SIGCHLD) {
+            reap(&active, &standby);
+        }
+    }
+    
+    syslog(LOG_INFO, "Stopping supervised effectd processes");
+    stop_child(&standby);
+    stop_child(&active);
+    sigprocmask(SIG_SETMASK, &childMask, NULL);
+    return 1;
+}
+
+int effectd_supervisor_wait_promotion(void) {
+    if (g_promotion_fd < 0) {
+        return 0;
+    }
+    
+    char go;
+    ssize_t ret;
+    do {
+        ret = read(g_promotion_fd, &go, 1);
+    } while (ret < 0 && errno == EINTR);
+    
+    close(g_promotion_fd);
+    g_promotion_fd = -1;
+    return ret == 1 ? 0 : -1;
+}
@@ -0,0 +1,184 @@
+#include "effectd_watchdog.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <syslog.h>
+
+#define CHECK_INTERVAL_US 2000    // Between sweeps while sessions are watched
+
+struct EffectdWatchdog {
+    uint32_t budgetPeriods;
+    int rtPriority;
+    pthread_t thread;
+    bool running;                         // Guarded by lock
+    
+    pthread_mutex_t lock;                 // Held by sweeps and membership changes
+    pthread_cond_t cond;                  // Sessions added, or destroy
+    EffectSession* abandoning;            // Abandoned with the lock released
+    pthread_cond_t abandonDone;           // abandoning let go of
+    EffectSession* sessions[EFFECTD_WATCHDOG_MAX_SESSIONS];
+    uint32_t numSessions;
+};
+
+static int64_t get_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t budget_us(const EffectdWatchdog* watchdog, const EffectSession* session) {
+    int64_t budget = (int64_t)session->periodUs * watchdog->budgetPeriods;
+    return budget > EFFECTD_WATCHDOG_MIN_BUDGET_US ? budget : EFFECTD_WATCHDOG_MIN_BUDGET_US;
+}
+
+/**
+ * Abandon every overrunning call (lock held)
+ * 
+ * The lock is released while a session is abandoned, which waits for the
+ * library to create its new context; removing that session waits instead.
+ */
+static void sweep(EffectdWatchdog* watchdog) {
+    int64_t now = get_time_us();
+    
+    for (uint32_t i = 0; i < watchdog->numSessions; i++) {
+        EffectSession* session = watchdog->sessions[i];
+        uint64_t start = atomic_load(&session->callStartUs);
+        if (start == 0 || start == EFFECTD_SESSION_CALL_ABANDONED ||
+            now - (int64_t)start <= budget_us(watchdog, session)) {
+            continue;
+        }
+        
+        watchdog->abandoning = session;
+        pthread_mutex_unlock(&watchdog->lock);
+        if (effectd_session_abandon_call(session, start) == 0) {
+            syslog(LOG_ERR, "Session %u: library call stuck for %lld us, abandoned",
+                   session->sessionId, (long long)(now - (int64_t)start));
+            if (!session->libContext) {
+                syslog(LOG_ERR, "Session %u: no new context, passing audio through",
+                       session->sessionId);
+            }
+        }
+        pthread_mutex_lock(&watchdog->lock);
+        watchdog->abandoning = NULL;
+        pthread_cond_broadcast(&watchdog->abandonDone);
+        now = get_time_us();
+    }
+}
+
+static void* watchdog_thread_func(void* arg) {
+    EffectdWatchdog* watchdog = (EffectdWatchdog*)arg;
+    
+    if (watchdog->rtPriority > 0) {
+        struct sched_param param;
+        param.sched_priority = watchdog->rtPriority;
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }
+    
+    pthread_mutex_lock(&watchdog->lock);
+    while (watchdog->running) {
+        if (watchdog->numSessions == 0) {
+            pthread_cond_wait(&watchdog->cond, &watchdog->lock);
+            continue;
+        }
+        
+        sweep(watchdog);
+        
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_nsec += CHECK_INTERVAL_US * 1000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&watchdog->cond, &watchdog->lock, &deadline);
+    }
+    pthread_mutex_unlock(&watchdog->lock);
+    
+    return NULL;
+}
+
+EffectdWatchdog* effectd_watchdog_create(uint32_t budgetPeriods, int rtPriority) {
+    EffectdWatchdog* watchdog = (EffectdWatchdog*)calloc(1, sizeof(EffectdWatchdog));
+    if (!watchdog) {
+        return NULL;
+    }
+    
+    watchdog->budgetPeriods = budgetPeriods;
+    watchdog->rtPriority = rtPriority;
+    watchdog->running = true;
+    pthread_mutex_init(&watchdog->lock, NULL);
+    
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&watchdog->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&watchdog->abandonDone, NULL);
+    
+    if (pthread_create(&watchdog->thread, NULL, watchdog_thread_func, watchdog) != 0) {
+        pthread_cond_destroy(&watchdog->abandonDone);
+        pthread_cond_destroy(&watchdog->cond);
+        pthread_mutex_destroy(&watchdog->lock);
+        free(watchdog);
+        return NULL;
+    }
+    
+    return watchdog;
+}
+
+void effectd_watchdog_destroy(EffectdWatchdog* watchdog) {
+    if (!watchdog) {
+        return;
+    }
+    
+    pthread_mutex_lock(&watchdog->lock);
+    watchdog->running = false;
+    pthread_cond_signal(&watchdog->cond);
+    pthread_mutex_unlock(&watchdog->lock);
+    pthread_join(watchdog->thread, NULL);
+    
+    pthread_cond_destroy(&watchdog->abandonDone);
+    pthread_cond_destroy(&watchdog->cond);
+    pthread_mutex_destroy(&watchdog->lock);
+    free(watchdog);
+}
+
+int effectd_watchdog_add_session(EffectdWatchdog* watchdog, EffectSession* session) {
+    if (!watchdog || !session) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&watchdog->lock);
+    if (watchdog->numSessions >= EFFECTD_WATCHDOG_MAX_SESSIONS) {
+        pthread_mutex_unlock(&watchdog->lock);
+        return -1;
+    }
+    
+    watchdog->sessions[watchdog->numSessions++] = session;
+    pthread_cond_signal(&watchdog->cond);
+    pthread_mutex_unlock(&watchdog->lock);
+    return 0;
+}
+
+void effectd_watchdog_remove_session(EffectdWatchdog* watchdog, EffectSession* session) {
+    if (!watchdog || !session) {
+        return;
+    }
+    
+    // Sweeps run under the lock but for the session they abandon, so none
+    // references the session after this
+    pthread_mutex_lock(&watchdog->lock);
+    for (uint32_t i = 0; i < watchdog->numSessions; i++) {
+        if (watchdog->sessions[i] == session) {
+            watchdog->sessions[i] = watchdog->sessions[--watchdog->numSessions];
+            break;
+        }
+    }
+    while (watchdog->abandoning == session) {
+        pthread_cond_wait(&watchdog->abandonDone, &watchdog->lock);
+    }
+    pthread_mutex_unlock(&watchdog->lock);
+}
@@ -0,0 +1,512 @@
+#include "effectd_worker_pool.h"
+#include "effect_shared_memory.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/epoll.h>
+
+#define RUN_QUEUE_SIZE EFFECTD_WORKER_POOL_MAX_SESSIONS
+#define MAX_EVENTS 32
+
+/**
+ * Sessions with pending periods, earliest deadline first
+ *
+ * A binary min-heap on each session's deadlineUs, which only the runner
+ * changes and never while the session is queued. Every queued session has
+ * scheduled == 1, so a queue never holds more than the pool's session
+ * count. The critical sections are a few loads and stores, so a spinlock
+ * keeps the owner and thieves off the futex path.
+ */
+typedef struct {
+    pthread_spinlock_t lock;
+    EffectSession* items[RUN_QUEUE_SIZE];
+    uint32_t count;
+} RunQueue;
+
+typedef struct {
+    EffectdWorkerPool* pool;
+    uint32_t index;
+    pthread_t thread;
+    bool joinable;                        // thread was started; guarded by pool->lock
+    int epollFd;
+    int wakeFd;                           // Pokes the worker out of epoll_wait
+    RunQueue queue;
+    atomic_uint idle;                     // Blocked (or about to block) in epoll_wait
+    atomic_uint epoch;                    // Bumped after every batch of events
+    _Atomic(EffectSession*) current;      // Session being run, NULL if none
+    uint32_t homedSessions;               // Guarded by pool->lock
+} Worker;
+
+struct EffectdWorkerPool {
+    Worker* workers;
+    uint32_t numWorkers;
+    uint32_t numSessions;                 // Guarded by lock
+    int rtPriority;
+    atomic_bool running;
+    pthread_mutex_t lock;                 // Membership changes only
+    EffectSession* homes[EFFECTD_WORKER_POOL_MAX_SESSIONS];
+    uint32_t homeWorker[EFFECTD_WORKER_POOL_MAX_SESSIONS];
+};
+
+static int64_t get_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Heap key: the deadline; sessions without a known period go after all
+ * others
+ */
+static uint64_t deadline_key(const EffectSession* session) {
+    return session->deadlineUs != 0 ? (uint64_t)session->deadlineUs : UINT64_MAX;
+}
+
+static bool runs_before(const EffectSession* a, const EffectSession* b) {
+    return deadline_key(a) < deadline_key(b);
+}
+
+static bool run_queue_push(RunQueue* queue, EffectSession* session) {
+    bool ok = false;
+    pthread_spin_lock(&queue->lock);
+    if (queue->count < RUN_QUEUE_SIZE) {
+        uint32_t i = queue->count++;
+        while (i > 0 && runs_before(session, queue->items[(i - 1) / 2])) {
+            queue->items[i] = queue->items[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        queue->items[i] = session;
+        ok = true;
+    }
+    pthread_spin_unlock(&queue->lock);
+    return ok;
+}
+
+static EffectSession* run_queue_pop(RunQueue* queue) {
+    EffectSession* session = NULL;
+    pthread_spin_lock(&queue->lock);
+    if (queue->count > 0) {
+        session = queue->items[0];
+        EffectSession* last = queue->items[--queue->count];
+        uint32_t i = 0;
+        for (;;) {
+            uint32_t child = 2 * i + 1;
+            if (child >= queue->count) {
+                break;
+            }
+            if (child + 1 < queue->count && runs_before(queue->items[child + 1], queue->items[child])) {
+                child++;
+            }
+            if (!runs_before(queue->items[child], last)) {
+                break;
+            }
+            queue->items[i] = queue->items[child];
+            i = child;
+        }
+        queue->items[i] = last;
+    }
+    pthread_spin_unlock(&queue->lock);
+    return session;
+}
+
+static uint32_t run_queue_length(RunQueue* queue) {
+    pthread_spin_lock(&queue->lock);
+    uint32_t length = queue->count;
+    pthread_spin_unlock(&queue->lock);
+    return length;
+}
+
+/**
+ * Key of the most urgent queued session
+ *
+ * @return false if the queue is empty
+ */
+static bool run_queue_peek_key(RunQueue* queue, uint64_t* key) {
+    pthread_spin_lock(&queue->lock);
+    bool found = queue->count > 0;
+    if (found) {
+        *key = deadline_key(queue->items[0]);
+    }
+    pthread_spin_unlock(&queue->lock);
+    return found;
+}
+
+/**
+ * Wake one idle peer if this worker has more queued than it can start now
+ */
+static void wake_idle_peer(Worker* worker) {
+    EffectdWorkerPool* pool = worker->pool;
+    if (run_queue_length(&worker->queue) <= 1) {
+        return;
+    }
+    
+    for (uint32_t i = 1; i < pool->numWorkers; i++) {
+        Worker* peer = &pool->workers[(worker->index + i) % pool->numWorkers];
+        if (atomic_load(&peer->idle)) {
+            effect_eventfd_signal(peer->wakeFd);
+            return;
+        }
+    }
+}
+
+/**
+ * Queue a session on this worker unless it is already queued or running
+ */
+static void schedule_session(Worker* worker, EffectSession* session) {
+    unsigned int expected = 0;
+    if (!atomic_compare_exchange_strong(&session->scheduled, &expected, 1)) {
+        // Already queued or running; the runner re-checks after it finishes
+        return;
+    }
+    
+    // We own the session now: stamp the arrival before it becomes visible
+    effectd_session_mark_ready(session, get_time_us());
+    run_queue_push(&worker->queue, session);
+    wake_idle_peer(worker);
+}
+
+/**
+ * Take the next session: the most urgent of our own queue, else the most
+ * urgent head among the peers' queues
+ */
+static EffectSession* next_session(Worker* worker) {
+    EffectSession* session = run_queue_pop(&worker->queue);
+    if (session) {
+        return session;
+    }
+    
+    EffectdWorkerPool* pool = worker->pool;
+    Worker* victim = NULL;
+    uint64_t earliest = UINT64_MAX;
+    for (uint32_t i = 1; i < pool->numWorkers; i++) {
+        Worker* peer = &pool->workers[(worker->index + i) % pool->numWorkers];
+        uint64_t key;
+        if (run_queue_peek_key(&peer->queue, &key) && (!victim || key < earliest)) {
+            earliest = key;
+            victim = peer;
+        }
+    }
+    
+    return victim ? run_queue_pop(&victim->queue) : NULL;
+}
+
+static void run_session(Worker* worker, EffectSession* session) {
+    atomic_store(&worker->current, session);
+    
+    // One period at a time, so a backlog competes with the other sessions
+    // by the deadline of its next period
+    effectd_session_process_periods(session, 1);
+    
+    // Input that arrived while we ran was swallowed by the scheduled check,
+    // so look again before letting go
+    if (session->threadRunning && effectd_session_has_pending(session)) {
+        effectd_session_mark_ready(session, get_time_us());
+        run_queue_push(&worker->queue, session);
+    } else {
+        atomic_store(&session->scheduled, 0);
+        if (session->threadRunning && effectd_session_has_pending(session)) {
+            schedule_session(worker, session);
+        }
+    }
+    
+    atomic_store(&worker->current, NULL);
+}
+
+static void handle_events(Worker* worker, struct epoll_event* events, int count) {
+    for (int i = 0; i < count; i++) {
+        EffectSession* session = (EffectSession*)events[i].data.ptr;
+        uint64_t val;
+        
+        if (!session) {
+            // Wake request from a peer or from remove/destroy
+            if (read(worker->wakeFd, &val, sizeof(val)) < 0) {
+                // Nothing to clear
+            }
+            continue;
+        }
+        
+        // Clear the eventfd; the ring itself says how much work there is
+        if (read(session->eventFdIn, &val, sizeof(val)) < 0) {
+            // Coalesced with an earlier read
+        }
+        if (session->threadRunning) {
+            schedule_session(worker, session);
+        }
+    }
+    
+    atomic_fetch_add(&worker->epoch, 1);
+}
+
+static void setup_worker_thread(Worker* worker) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(worker->index % (uint32_t)cpus, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    
+    if (worker->pool->rtPriority > 0) {
+        struct sched_param param;
+        param.sched_priority = worker->pool->rtPriority;
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }
+}
+
+static void* worker_thread_func(void* arg) {
+    Worker* worker = (Worker*)arg;
+    EffectdWorkerPool* pool = worker->pool;
+    struct epoll_event events[MAX_EVENTS];
+    
+    setup_worker_thread(worker);
+    
+    while (atomic_load(&pool->running)) {
+        // Pick up new signals without blocking while there is work queued
+        int count = epoll_wait(worker->epollFd, events, MAX_EVENTS, 0);
+        if (count > 0) {
+            handle_events(worker, events, count);
+        }
+        
+        EffectSession* session = next_session(worker);
+        if (session) {
+            run_session(worker, session);
+            continue;
+        }
+        
+        // Announce idleness before the last look so a peer that queues work
+        // after our look is guaranteed to see the flag and wake us
+        atomic_store(&worker->idle, 1);
+        session = next_session(worker);
+        if (session) {
+            atomic_store(&worker->idle, 0);
+            run_session(worker, session);
+            continue;
+        }
+        
+        count = epoll_wait(worker->epollFd, events, MAX_EVENTS, -1);
+        atomic_store(&worker->idle, 0);
+        if (count > 0) {
+            handle_events(worker, events, count);
+        } else {
+            atomic_fetch_add(&worker->epoch, 1);
+        }
+    }
+    
+    return NULL;
+}
+
+static void worker_cleanup(Worker* worker) {
+    if (worker->epollFd >= 0) {
+        close(worker->epollFd);
+    }
+    if (worker->wakeFd >= 0) {
+        close(worker->wakeFd);
+    }
+    pthread_spin_destroy(&worker->queue.lock);
+}
+
+EffectdWorkerPool* effectd_worker_pool_create(uint32_t numWorkers, int rtPriority) {
+    if (numWorkers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numWorkers = (cpus > 0) ? (uint32_t)cpus : 1;
+    }
+    
+    EffectdWorkerPool* pool = (EffectdWorkerPool*)calloc(1, sizeof(EffectdWorkerPool));
+    if (!pool) {
+        return NULL;
+    }
+    
+    pool->workers = (Worker*)calloc(numWorkers, sizeof(Worker));
+    if (!pool->workers) {
+        free(pool);
+        return NULL;
+    }
+    
+    pool->rtPriority = rtPriority;
+    pthread_mutex_init(&pool->lock, NULL);
+    atomic_store(&pool->running, true);
+    
+    for (uint32_t i = 0; i < numWorkers; i++) {
+        Worker* worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        pthread_spin_init(&worker->queue.lock, PTHREAD_PROCESS_PRIVATE);
+        worker->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        worker->wakeFd = effect_eventfd_create(0);
+        
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        
+        if (worker->epollFd < 0 || worker->wakeFd < 0 ||
+            epoll_ctl(worker->epollFd, EPOLL_CTL_ADD, worker->wakeFd, &ev) < 0 ||
+            pthread_create(&worker->thread, NULL, worker_thread_func, worker) != 0) {
+            worker_cleanup(worker);
+            pool->numWorkers = i;
+            effectd_worker_pool_destroy(pool);
+            return NULL;
+        }
+        worker->joinable = true;
+        pool->numWorkers = i + 1;
+    }
+    
+    return pool;
+}
+
+void effectd_worker_pool_destroy(EffectdWorkerPool* pool) {
+    if (!pool) {
+        return;
+    }
+    
+    atomic_store(&pool->running, false);
+    for (uint32_t i = 0; i < pool->numWorkers; i++) {
+        effect_eventfd_signal(pool->workers[i].wakeFd);
+    }
+    for (uint32_t i = 0; i < pool->numWorkers; i++) {
+        if (pool->workers[i].joinable) {
+            pthread_join(pool->workers[i].thread, NULL);
+        }
+        worker_cleanup(&pool->workers[i]);
+    }
+    
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+int effectd_worker_pool_add_session(EffectdWorkerPool* pool, EffectSession* session) {
+    if (!pool || !session || session->eventFdIn < 0 ||
+        session->inputWakeup.type != EFFECT_WAKEUP_EVENTFD) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    
+    if (pool->numSessions >= EFFECTD_WORKER_POOL_MAX_SESSIONS) {
+        pthread_mutex_unlock(&pool->lock);
+        return -1;
+    }
+    
+    // Home the session on the worker with the fewest sessions
+    uint32_t home = 0;
+    for (uint32_t i = 1; i < pool->numWorkers; i++) {
+        if (pool->workers[i].homedSessions < pool->workers[home].homedSessions) {
+            home = i;
+        }
+    }
+    
+    atomic_store(&session->scheduled, 0);
+    
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = session;
+    if (epoll_ctl(pool->workers[home].epollFd, EPOLL_CTL_ADD, session->eventFdIn, &ev) < 0) {
+        pthread_mutex_unlock(&pool->lock);
+        return -1;
+    }
+    
+    pool->homes[pool->numSessions] = session;
+    pool->homeWorker[pool->numSessions] = home;
+    pool->numSessions++;
+    pool->workers[home].homedSessions++;
+    
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void effectd_worker_pool_remove_session(EffectdWorkerPool* pool, EffectSession* session) {
+    if (!pool || !session) {
+        return;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    
+    uint32_t slot = pool->numSessions;
+    for (uint32_t i = 0; i < pool->numSessions; i++) {
+        if (pool->homes[i] == session) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == pool->numSessions) {
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+    
+    Worker* home = &pool->workers[pool->homeWorker[slot]];
+    epoll_ctl(home->epollFd, EPOLL_CTL_DEL, session->eventFdIn, NULL);
+    
+    pool->numSessions--;
+    pool->homes[slot] = pool->homes[pool->numSessions];
+    pool->homeWorker[slot] = pool->homeWorker[pool->numSessions];
+    home->homedSessions--;
+    
+    pthread_mutex_unlock(&pool->lock);
+    
+    // The home worker may still hold this session in a batch of events it
+    // fetched before the EPOLL_CTL_DEL; one more batch means it is done
+    atomic_thread_fence(memory_order_seq_cst);
+    unsigned int epoch = atomic_load(&home->epoch);
+    effect_eventfd_signal(home->wakeFd);
+    while (atomic_load(&home->epoch) == epoch) {
+        sched_yield();
+    }
+    
+    // With threadRunning clear nothing requeues it; wait for the last run
+    for (;;) {
+        bool busy = atomic_load(&session->scheduled) != 0;
+        for (uint32_t i = 0; i < pool->numWorkers && !busy; i++) {
+            busy = atomic_load(&pool->workers[i].current) == session;
+        }
+        if (!busy) {
+            break;
+        }
+        sched_yield();
+    }
+}
+
+int effectd_worker_pool_replace_worker(EffectdWorkerPool* pool, EffectSession* session) {
+    if (!pool || !session) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    
+    Worker* worker = NULL;
+    for (uint32_t i = 0; i < pool->numWorkers && !worker; i++) {
+        if (atomic_load(&pool->workers[i].current) == session) {
+            worker = &pool->workers[i];
+        }
+    }
+    if (!worker || !worker->joinable) {
+        pthread_mutex_unlock(&pool->lock);
+        return -1;
+    }
+    
+    // The stuck run never finishes, so finish it on its behalf
+    effectd_sched_abandon_thread(worker->thread);
+    atomic_store(&worker->idle, 0);
+    atomic_store(&worker->current, NULL);
+    atomic_store(&session->scheduled, 0);
+    worker->joinable = pthread_create(&worker->thread, NULL, worker_thread_func, worker) == 0;
+    int ret = worker->joinable ? 0 : -1;
+    
+    pthread_mutex_unlock(&pool->lock);
+    
+    // Its wakeups went to the stuck run; peers steal the queue if the new
+    // thread did not start
+    if (session->threadRunning && effectd_session_has_pending(session)) {
+        schedule_session(worker, session);
+    }
+    return ret;
+}
+
+uint32_t effectd_worker_pool_get_size(const EffectdWorkerPool* pool) {
+    return pool ? pool->numWorkers : 0;
+}
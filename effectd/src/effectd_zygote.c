@@ -0,0 +1,274 @@
+#include "effectd_zygote.h"
+#include "effectd_sched.h"
+#include "effect_control.h"
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define NUM_HOSTS (EFFECT_LIB_NOISE_REDUCTION + 1)
+#define SPAWN_TIMEOUT_MS 2000     // For the zygote to fork a host
+// For a host to take a connection; it is hung past that. Its control thread
+// may be waiting out a stuck library call first.
+#define ADOPT_TIMEOUT_MS (2 * EFFECTD_SESSION_CALL_TIMEOUT_MS)
+
+typedef struct {
+    EffectControlChannel* channel;    // effectd's connection to the host, NULL if none
+    pid_t pid;
+} Host;
+
+struct EffectdZygote {
+    pid_t pid;
+    EffectControlChannel* channel;    // Spawn requests
+    
+    pthread_mutex_t lock;
+    Host hosts[NUM_HOSTS];
+};
+
+// Zygote process only
+static EffectControlMessage g_requests[EFFECT_CONTROL_MAX_BATCH];
+static EffectControlMessage g_replies[EFFECT_CONTROL_MAX_BATCH];
+
+static void init_adopt(EffectControlMessage* msg, uint32_t id, int fd) {
+    memset(&msg->header, 0, sizeof(msg->header));
+    msg->header.op = EFFECT_CONTROL_OP_ADOPT;
+    msg->header.id = id;
+    msg->header.fdMask = EFFECT_CONTROL_FD_CONNECTION;
+    msg->fds[0] = fd;
+    msg->fds[1] = -1;
+    msg->fds[2] = -1;
+}
+
+/**
+ * Fork a host serving the connection in req->fds[0]
+ *
+ * @return Host pid in the zygote; does not return in the host
+ */
+static pid_t fork_host(int sock, EffectdHostMain hostMain, int count, int index) {
+    pid_t zygote = getpid();
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+    
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != zygote) {
+        _exit(1);
+    }
+    signal(SIGCHLD, SIG_DFL);
+    close(sock);
+    
+    // Only the host's own connection comes along
+    for (int i = 0; i < count; i++) {
+        if (i != index) {
+            effect_control_close_fds(&g_requests[i]);
+        }
+    }
+    _exit(hostMain((EffectLibType)g_requests[index].header.id, g_requests[index].fds[0]));
+}
+
+/**
+ * Fork a host for every ADOPT request until effectd closes the socket
+ */
+static int zygote_main(int sock, EffectdHostMain hostMain) {
+    // Hosts are reaped by the kernel; effectd's handlers do not apply here
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    
+    while (true) {
+        int count = effect_control_recv_packet(sock, g_requests);
+        if (count <= 0) {
+            return 0;
+        }
+        
+        for (int i = 0; i < count; i++) {
+            EffectControlMessage* req = &g_requests[i];
+            EffectControlMessage* reply = &g_replies[i];
+            memset(&reply->header, 0, sizeof(reply->header));
+            reply->header.requestId = req->header.requestId;
+            reply->header.op = req->header.op;
+            
+            if (req->header.op != EFFECT_CONTROL_OP_ADOPT || req->header.id >= NUM_HOSTS ||
+                req->fds[0] < 0) {
+                reply->header.result = EFFECT_CONTROL_ERROR_INVALID_ARGUMENTS;
+            } else {
+                pid_t pid = fork_host(sock, hostMain, count, i);
+                reply->header.result = pid > 0 ? EFFECT_CONTROL_OK : EFFECT_CONTROL_ERROR_NO_MEMORY;
+                reply->header.id = pid > 0 ? (uint32_t)pid : 0;
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            effect_control_close_fds(&g_requests[i]);
+        }
+        
+        if (effect_control_send_packet(sock, g_replies, (uint32_t)count) < 0) {
+            return 1;
+        }
+    }
+}
+
+/**
+ * Replace the host of type with a new one (lock held)
+ */
+static int spawn_host(EffectdZygote* zygote, EffectLibType type) {
+    Host* host = &zygote->hosts[type];
+    effect_control_release(host->channel);
+    host->channel = NULL;
+    // Whatever the old host had admitted died with it
+    effectd_sched_forget(host->pid);
+    host->pid = 0;
+    
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        return -1;
+    }
+    
+    EffectControlMessage msg;
+    init_adopt(&msg, (uint32_t)type, sv[1]);
+    int32_t result = effect_control_call(zygote->channel, &msg, SPAWN_TIMEOUT_MS);
+    close(sv[1]);
+    if (result != EFFECT_CONTROL_OK) {
+        syslog(LOG_ERR, "Zygote failed to spawn host for effect type %d: %d", (int)type, result);
+        close(sv[0]);
+        return -1;
+    }
+    
+    host->channel = effect_control_adopt(sv[0]);
+    if (!host->channel) {
+        close(sv[0]);
+        return -1;
+    }
+    host->pid = (pid_t)msg.header.id;
+    syslog(LOG_INFO, "Host %d serving effect type %d", (int)host->pid, (int)type);
+    return 0;
+}
+
+EffectdZygote* effectd_zygote_create(EffectdHostMain hostMain) {
+    if (!hostMain) {
+        return NULL;
+    }
+    
+    EffectdZygote* zygote = (EffectdZygote*)calloc(1, sizeof(EffectdZygote));
+    if (!zygote) {
+        return NULL;
+    }
+    
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        free(zygote);
+        return NULL;
+    }
+    
+    pid_t parent = getpid();
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(sv[0]);
+        close(sv[1]);
+        free(zygote);
+        return NULL;
+    }
+    
+    if (pid == 0) {
+        // Hosts outliving effectd would serve clients nobody can reach
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != parent) {
+            _exit(1);
+        }
+        close(sv[0]);
+        _exit(zygote_main(sv[1], hostMain));
+    }
+    
+    close(sv[1]);
+    zygote->pid = pid;
+    zygote->channel = effect_control_adopt(sv[0]);
+    if (!zygote->channel) {
+        close(sv[0]);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        free(zygote);
+        return NULL;
+    }
+    pthread_mutex_init(&zygote->lock, NULL);
+    syslog(LOG_INFO, "Zygote %d forked", (int)pid);
+    
+    // Hosts are cheap to keep around, and ready before the first client
+    for (int type = 0; type < NUM_HOSTS; type++) {
+        spawn_host(zygote, (EffectLibType)type);
+    }
+    
+    return zygote;
+}
+
+void effectd_zygote_destroy(EffectdZygote* zygote) {
+    if (!zygote) {
+        return;
+    }
+    
+    for (int type = 0; type < NUM_HOSTS; type++) {
+        effect_control_release(zygote->hosts[type].channel);
+    }
+    
+    // The zygote exits once its socket closes, taking the hosts with it
+    effect_control_release(zygote->channel);
+    waitpid(zygote->pid, NULL, 0);
+    
+    pthread_mutex_destroy(&zygote->lock);
+    free(zygote);
+}
+
+int effectd_zygote_connect(EffectdZygote* zygote, EffectLibType type) {
+    if (!zygote || (unsigned)type >= NUM_HOSTS) {
+        return -1;
+    }
+    
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&zygote->lock);
+    Host* host = &zygote->hosts[type];
+    int32_t result = EFFECT_CONTROL_ERROR_DEAD_OBJECT;
+    
+    // A host found dead, dying under the call or hung (its control thread
+    // stuck, so that it does not answer) is replaced once; the wait is
+    // bounded, as the lock holds up connections to every host
+    for (int attempt = 0; attempt < 2 && (result == EFFECT_CONTROL_ERROR_DEAD_OBJECT ||
+                                          result == EFFECT_CONTROL_ERROR_TIMEOUT); attempt++) {
+        bool replace = false;
+        if (result == EFFECT_CONTROL_ERROR_TIMEOUT) {
+            syslog(LOG_ERR, "Host %d of effect type %d hung, killing it",
+                   (int)host->pid, (int)type);
+            kill(host->pid, SIGKILL);
+            replace = true;
+        } else if (effect_control_is_broken(host->channel) ||
+                   effect_control_wait_broken(&host->channel, 1, 0) >= 0) {
+            if (host->pid != 0) {
+                syslog(LOG_ERR, "Host %d of effect type %d died, respawning",
+                       (int)host->pid, (int)type);
+            }
+            replace = true;
+        }
+        if (replace && spawn_host(zygote, type) < 0) {
+            break;
+        }
+        
+        EffectControlMessage msg;
+        init_adopt(&msg, (uint32_t)type, sv[1]);
+        result = effect_control_call(host->channel, &msg, ADOPT_TIMEOUT_MS);
+    }
+    pthread_mutex_unlock(&zygote->lock);
+    
+    close(sv[1]);
+    if (result != EFFECT_CONTROL_OK) {
+        close(sv[0]);
+        return -1;
+    }
+    return sv[0];
+}
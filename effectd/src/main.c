@@ -1,12 +1,54 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 #include <unistd.h>
 #include <syslog.h>
 #include "effectd_session.h"
+#include "effectd_worker_pool.h"
+#include "effectd_poller.h"
+#include "effectd_watchdog.h"
+#include "effectd_plugin.h"
+#include "effectd_sched.h"
+#include "effectd_registry.h"
+#include "effectd_blob_cache.h"
+#include "effectd_control.h"
+#include "effectd_supervisor.h"
+#include "effectd_zygote.h"
+#include "effect_control.h"
+
+#define WORKER_RT_PRIORITY EFFECTD_SCHED_DEFAULT_PRIORITY  // Policy effectd_sched_fits_shared expects
+#define WATCHDOG_RT_PRIORITY (WORKER_RT_PRIORITY + 1)
+#define WATCHDOG_BUDGET_PERIODS 4
 
 static volatile int keep_running = 1;
 
+// Shared by every session; NULL runs each session on its own thread
+static EffectdWorkerPool* g_worker_pool = NULL;
+
+// Busy-poll dispatcher on a dedicated core; takes precedence over the pool
+static EffectdPoller* g_poller = NULL;
+
+// Abandons library calls that overrun; NULL leaves them be
+static EffectdWatchdog* g_watchdog = NULL;
+
+// Open sessions by ID, looked up by every control call
+static EffectdRegistry* g_registry = NULL;
+
+// setParamBlob values, shared by every session with the same content
+static EffectdBlobCache* g_blob_cache = NULL;
+
+#if !USE_FMQ
+// IEffectService over a Unix domain socket, standing in for HIDL
+static EffectdControl* g_control = NULL;
+
+// Forks a process per plugin library (-i); NULL runs them all in effectd
+static EffectdZygote* g_zygote = NULL;
+#endif
+
+// Processing workers per process (-w)
+static int g_workers = 0;
+
 static void signal_handler(int signum) {
     syslog(LOG_INFO, "Received signal %d, shutting down...", signum);
     keep_running = 0;
@@ -18,31 +60,318 @@ static void setup_signal_handlers() {
     signal(SIGPIPE, SIG_IGN);
 }
 
-int main(int argc __attribute__((unused)), 
-         char* argv[] __attribute__((unused))) {
+/**
+ * Parse type:class[,priority[,budgetUs[,cpumask[,downgrade]]]] for -s
+ */
+static int parse_sched_policy(const char* arg) {
+    char className[16];
+    char action[16] = "";
+    unsigned int type;
+    int priority = EFFECTD_SCHED_DEFAULT_PRIORITY;
+    unsigned int budgetUs = 0;
+    unsigned long long cpuMask = 0;
+    
+    if (sscanf(arg, "%u:%15[a-z],%d,%u,%llx,%15s", &type, className, &priority, &budgetUs,
+               &cpuMask, action) < 2) {
+        return -1;
+    }
+    
+    EffectdSchedPolicy policy;
+    memset(&policy, 0, sizeof(policy));
+    if (strcmp(className, "other") == 0) {
+        policy.schedClass = EFFECTD_SCHED_OTHER;
+    } else if (strcmp(className, "fifo") == 0) {
+        policy.schedClass = EFFECTD_SCHED_FIFO;
+    } else if (strcmp(className, "deadline") == 0) {
+        policy.schedClass = EFFECTD_SCHED_DEADLINE;
+    } else {
+        return -1;
+    }
+    policy.priority = priority;
+    policy.budgetUs = budgetUs;
+    policy.cpuMask = cpuMask;
+    policy.downgrade = strcmp(action, "downgrade") == 0;
+    
+    return effectd_sched_set_policy(type, &policy);
+}
+
+static EffectdWorkerPool* create_worker_pool(void) {
+    if (g_workers < 0) {
+        return NULL;
+    }
+    
+    EffectdWorkerPool* pool = effectd_worker_pool_create((uint32_t)g_workers, WORKER_RT_PRIORITY);
+    if (pool) {
+        syslog(LOG_INFO, "Processing on %u pooled workers", effectd_worker_pool_get_size(pool));
+    } else {
+        syslog(LOG_WARNING, "Failed to create worker pool, using a thread per session");
+    }
+    return pool;
+}
+
+static EffectdWatchdog* create_watchdog(void) {
+    EffectdWatchdog* watchdog = effectd_watchdog_create(WATCHDOG_BUDGET_PERIODS,
+                                                        WATCHDOG_RT_PRIORITY);
+    if (!watchdog) {
+        syslog(LOG_WARNING, "Failed to start hung-call watchdog");
+    }
+    return watchdog;
+}
+
+#if !USE_FMQ
+/**
+ * Library host forked by the zygote: serves the sessions of one effect type
+ * on the connections effectd hands over, until the zygote goes away
+ */
+static int run_library_host(EffectLibType type, int brokerFd) {
+    setup_signal_handlers();
+    syslog(LOG_INFO, "Hosting effect type %d", (int)type);
+    
+    // The registry and blob cache came along from effectd empty; the
+    // dispatchers are this process's own
+    g_worker_pool = create_worker_pool();
+    g_watchdog = create_watchdog();
+    g_control = effectd_control_create_host(brokerFd, g_registry, g_blob_cache, g_worker_pool,
+                                            g_watchdog);
+    if (!g_control) {
+        effectd_watchdog_destroy(g_watchdog);
+        effectd_worker_pool_destroy(g_worker_pool);
+        return 1;
+    }
+    
+    while (keep_running) {
+        sleep(1);
+    }
+    
+    effectd_control_destroy(g_control);
+    effectd_watchdog_destroy(g_watchdog);
+    effectd_registry_destroy(g_registry);
+    effectd_blob_cache_destroy(g_blob_cache);
+    effectd_worker_pool_destroy(g_worker_pool);
+    return 0;
+}
+#endif
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-w workers] [-p cpu[:spinUs[:sleepUs]]] [-u percent]\n"
+                    "          [-l type:path]... [-s type:policy]... [-c socket] [-S] [-i]\n", prog);
+    fprintf(stderr, "  -w workers    Processing workers (default: one per CPU, -1: thread per session)\n");
+    fprintf(stderr, "  -p cpu[:spinUs[:sleepUs]]\n");
+    fprintf(stderr, "                Busy-poll all sessions on an isolated CPU; once idle for spinUs\n");
+    fprintf(stderr, "                (default: never) nap sleepUs between sweeps\n");
+    fprintf(stderr, "  -u percent    CPU budget admission may hand out, in percent of one CPU\n");
+    fprintf(stderr, "                (default: 90 per online CPU)\n");
+    fprintf(stderr, "  -l type:path  Plugin library for an effect type (0: karaoke, 1: noise reduction)\n");
+    fprintf(stderr, "  -s type:class[,priority[,budgetUs[,cpumask[,downgrade]]]]\n");
+    fprintf(stderr, "                Scheduling of an effect type: class other, fifo or deadline;\n");
+    fprintf(stderr, "                budgetUs is CPU time per audio period, admitted against -u;\n");
+    fprintf(stderr, "                over budget sessions are rejected unless downgrade is given;\n");
+    fprintf(stderr, "                sessions of a type whose policy is not fifo at the default\n");
+    fprintf(stderr, "                priority on any CPU (or that were downgraded) are not pooled\n");
+    fprintf(stderr, "                or busy-polled but get a thread of their own\n");
+    fprintf(stderr, "  -c socket     Control socket path (default: $%s or %s)\n",
+            EFFECT_CONTROL_PATH_ENV, EFFECT_CONTROL_DEFAULT_PATH);
+    fprintf(stderr, "  -S            Supervise: serve from a child process and keep a pre-initialized\n");
+    fprintf(stderr, "                standby that takes over if it dies\n");
+    fprintf(stderr, "  -i            Isolate each plugin library in its own process, forked from a\n");
+    fprintf(stderr, "                zygote that has the libraries loaded\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* socketPath = getenv(EFFECT_CONTROL_PATH_ENV);
+    bool poll = false;
+    bool supervise = false;
+    bool isolate = false;
+    int exitCode = 0;
+    EffectdPollerConfig pollerConfig;
+    int opt;
+    
+    memset(&pollerConfig, 0, sizeof(pollerConfig));
+    pollerConfig.rtPriority = WORKER_RT_PRIORITY;
+    
+    while ((opt = getopt(argc, argv, "w:p:u:l:s:c:Si")) != -1) {
+        char* sep;
+        switch (opt) {
+            case 'w':
+                g_workers = atoi(optarg);
+                break;
+            case 'p':
+                if (sscanf(optarg, "%d:%u:%u", &pollerConfig.cpu, &pollerConfig.idleSpinUs,
+                           &pollerConfig.idleSleepUs) < 1 || pollerConfig.cpu < 0) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                poll = true;
+                break;
+            case 'u':
+                effectd_sched_set_capacity((uint32_t)atoi(optarg));
+                break;
+            case 'l':
+                sep = strchr(optarg, ':');
+                if (!sep || effectd_plugin_set_library((EffectLibType)atoi(optarg), sep + 1) < 0) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 's':
+                if (parse_sched_policy(optarg) < 0) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'c':
+                socketPath = optarg;
+                break;
+            case 'S':
+                supervise = true;
+                break;
+            case 'i':
+                isolate = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    
     openlog("effectd", LOG_PID | LOG_CONS, LOG_DAEMON);
     syslog(LOG_INFO, "effectd starting...");
     
     setup_signal_handlers();
     
+#if USE_FMQ
+    // Standbys and library hosts are only reachable over the socket control
+    // plane, and only its clients reattach after a failover
+    if (supervise || isolate) {
+        syslog(LOG_WARNING, "-S and -i need the socket control plane, ignoring them");
+        supervise = false;
+        isolate = false;
+    }
+#endif
+    
+#if !USE_FMQ
+    // Created before forking, so that a promoted standby serves the same socket
+    const char* path = socketPath ? socketPath : EFFECT_CONTROL_DEFAULT_PATH;
+    int listenFd = effectd_control_listen(path);
+    if (listenFd < 0) {
+        syslog(LOG_ERR, "Failed to create control socket");
+        closelog();
+        return 1;
+    }
+#endif
+    
+    if (supervise) {
+        int supervised = effectd_supervisor_run();
+        if (supervised != 0) {
+            // The supervisor; its children have been stopped
+#if !USE_FMQ
+            close(listenFd);
+            unlink(path);
+#endif
+            closelog();
+            return supervised < 0 ? 1 : 0;
+        }
+    }
+    
+    g_registry = effectd_registry_create();
+    g_blob_cache = effectd_blob_cache_create();
+    if (!g_registry || !g_blob_cache) {
+        syslog(LOG_ERR, "Failed to create session registry or blob cache");
+        effectd_registry_destroy(g_registry);
+        effectd_blob_cache_destroy(g_blob_cache);
+        closelog();
+        return 1;
+    }
+    
+    // Load the plugin libraries now rather than at the first open
+    effectd_plugin_preload();
+    
+#if !USE_FMQ
+    // The zygote must be forked before this process starts any thread
+    if (isolate) {
+        // The hosts admit their sessions against one budget, not one each
+        if (effectd_sched_share_ledger() < 0) {
+            syslog(LOG_WARNING, "Failed to share admission ledger, each host admits alone");
+        }
+        g_zygote = effectd_zygote_create(run_library_host);
+        if (!g_zygote) {
+            syslog(LOG_ERR, "Failed to fork zygote, running libraries in effectd");
+        }
+    }
+#endif
+    
+    g_worker_pool = create_worker_pool();
+    g_watchdog = create_watchdog();
+    
+    // A standby waits here, ready to serve, until the active effectd dies
+    if (effectd_supervisor_wait_promotion() < 0) {
+        keep_running = 0;
+    }
+    
+    // The dispatcher occupies its core, so only an active effectd starts one,
+    // and only for libraries it runs itself
+#if !USE_FMQ
+    if (poll && g_zygote) {
+        syslog(LOG_WARNING, "Busy polling is not supported with isolated libraries");
+        poll = false;
+    }
+#endif
+    if (poll && keep_running) {
+        g_poller = effectd_poller_create(&pollerConfig);
+        if (g_poller) {
+            syslog(LOG_INFO, "Busy-polling sessions on CPU %d", pollerConfig.cpu);
+        } else {
+            syslog(LOG_WARNING, "Failed to create busy-poll dispatcher");
+        }
+    }
+    
+#if USE_FMQ
     // TODO: Initialize HIDL service
     // In real implementation:
     // 1. Register IEffectService with hwservicemanager
-    // 2. Set up session manager
-    // 3. Configure CPU affinity if needed
-    // 4. Set process priority
+    // 2. Serve the calls as effectd_control.c does for the socket transport
+    // 3. Set process priority
+    (void)socketPath;
+#else
+    if (keep_running) {
+        g_control = effectd_control_create(listenFd, g_zygote, g_registry, g_blob_cache,
+                                           g_worker_pool, g_poller, g_watchdog);
+        if (!g_control) {
+            syslog(LOG_ERR, "Failed to serve control socket");
+            keep_running = 0;
+            exitCode = 1;
+        }
+    }
+    if (!g_control) {
+        close(listenFd);
+    }
+#endif
     
-    syslog(LOG_INFO, "effectd ready and waiting for connections");
+    if (keep_running) {
+        syslog(LOG_INFO, "effectd ready and waiting for connections");
+    }
     
     // Main service loop
     while (keep_running) {
-        // In real implementation, HIDL would handle incoming calls
-        // For now, just sleep
+        // Calls are served on the control thread
         sleep(1);
     }
     
     syslog(LOG_INFO, "effectd shutting down");
+#if !USE_FMQ
+    // Closes every client's sessions before their dispatchers go away
+    effectd_control_destroy(g_control);
+    effectd_zygote_destroy(g_zygote);
+    if (!supervise) {
+        unlink(path);
+    }
+#endif
+    effectd_watchdog_destroy(g_watchdog);
+    effectd_poller_destroy(g_poller);
+    effectd_registry_destroy(g_registry);
+    effectd_blob_cache_destroy(g_blob_cache);
+    effectd_worker_pool_destroy(g_worker_pool);
     closelog();
     
-    return 0;
+    return exitCode;
 }
@@ -70,7 +70,7 @@ int hal_effect_init(AudioHalContext* ctx, uint32_t sampleRate,
  * Process audio in real-time thread (SAFE to call from RT context)
  * 
  * This function can be called from the HAL's real-time audio callback.
- * It will never block more than 20ms and will automatically fall back
+ * It will never block more than half a period and will automatically fall back
  * to passthrough on timeout.
  */
 void hal_effect_process(AudioHalContext* ctx, const int16_t* input, 
@@ -89,21 +89,11 @@ void hal_effect_process(AudioHalContext* ctx, const int16_t* input,
     );
     
     if (result == EFFECT_ERROR_TIMEOUT) {
-        // Timeout occurred - output already contains passthrough
+        // Timeout occurred - output already contains passthrough. After
+        // repeated timeouts the session bypasses effectd by itself and
+        // goes back to it once it keeps up again.
         ctx->timeoutCount++;
-        
-        // If too many timeouts, disable effect
-        if (ctx->timeoutCount > 100) {
-            fprintf(stderr, "Too many timeouts (%u), disabling effect\n", 
-                   ctx->timeoutCount);
-            ctx->passthroughMode = true;
-        }
-    } else if (result == EFFECT_OK) {
-        // Success - reset timeout counter
-        if (ctx->timeoutCount > 0) {
-            ctx->timeoutCount--;
-        }
-    } else {
+    } else if (result != EFFECT_OK) {
         // Other error - use passthrough
         memcpy(output, input, frames * 2 * sizeof(int16_t));
     }
@@ -149,6 +139,8 @@ void hal_effect_print_stats(AudioHalContext* ctx) {
         printf("  Max latency:      %u us\n", stats.maxLatencyUs);
         printf("  Timeout count:    %u\n", stats.timeoutCount);
         printf("  Xrun count:       %u\n", stats.xrunCount);
+        printf("  Bypass trips:     %u (recovered %u)\n", stats.breakerTripCount,
+               stats.breakerRecoveryCount);
         
         if (stats.maxLatencyUs > 10000) {
             printf("  WARNING: Max latency exceeds 10ms target!\n");
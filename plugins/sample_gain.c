@@ -0,0 +1,98 @@
+/**
+ * Sample plugin: planar gain with parameter smoothing
+ *
+ * Only accepts the planar layout, so it exercises the host's
+ * deinterleave/interleave path as well as setParam and reset.
+ */
+#include "effect_plugin.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define SAMPLE_GAIN_PARAM_GAIN 0    // float, linear gain
+
+// Per-sample step of the one-pole smoother towards the target gain
+#define SMOOTHING_COEFF 0.01f
+
+typedef struct {
+    uint32_t channels;
+    uint32_t format;
+    _Atomic float targetGain;       // Written by setParam, read by process
+    float gain;                     // Smoothed gain, processing context only
+} GainContext;
+
+EFFECT_PLUGIN_EXPORT uint32_t effect_plugin_get_abi_version(void) {
+    return EFFECT_PLUGIN_ABI_VERSION;
+}
+
+EFFECT_PLUGIN_EXPORT int effect_plugin_create(const EffectPluginConfig* config, void** context) {
+    if (!config || !context || config->layout != EFFECT_PLUGIN_LAYOUT_PLANAR) {
+        return -1;
+    }
+    
+    GainContext* ctx = (GainContext*)calloc(1, sizeof(GainContext));
+    if (!ctx) {
+        return -1;
+    }
+    
+    ctx->channels = config->channels;
+    ctx->format = config->format;
+    atomic_init(&ctx->targetGain, 1.0f);
+    ctx->gain = 1.0f;
+    *context = ctx;
+    return 0;
+}
+
+EFFECT_PLUGIN_EXPORT int effect_plugin_process(void* context, const EffectPluginBuffer* input,
+                                               EffectPluginBuffer* output) {
+    GainContext* ctx = (GainContext*)context;
+    float target = atomic_load_explicit(&ctx->targetGain, memory_order_relaxed);
+    float gain = ctx->gain;
+    
+    for (uint32_t c = 0; c < ctx->channels; c++) {
+        gain = ctx->gain;
+        if (ctx->format == 16) {
+            const int16_t* in = (const int16_t*)input->planes[c];
+            int16_t* out = (int16_t*)output->planes[c];
+            for (uint32_t f = 0; f < input->frames; f++) {
+                gain += (target - gain) * SMOOTHING_COEFF;
+                float v = in[f] * gain;
+                out[f] = (int16_t)(v > 32767.0f ? 32767.0f : (v < -32768.0f ? -32768.0f : v));
+            }
+        } else {
+            const float* in = (const float*)input->planes[c];
+            float* out = (float*)output->planes[c];
+            for (uint32_t f = 0; f < input->frames; f++) {
+                gain += (target - gain) * SMOOTHING_COEFF;
+                out[f] = in[f] * gain;
+            }
+        }
+    }
+    
+    // Every channel follows the same ramp
+    ctx->gain = gain;
+    return 0;
+}
+
+EFFECT_PLUGIN_EXPORT int effect_plugin_set_param(void* context, uint32_t key,
+                                                 const void* value, uint32_t valueSize) {
+    GainContext* ctx = (GainContext*)context;
+    if (key != SAMPLE_GAIN_PARAM_GAIN || !value || valueSize != sizeof(float)) {
+        return -1;
+    }
+    
+    atomic_store_explicit(&ctx->targetGain, *(const float*)value, memory_order_relaxed);
+    return 0;
+}
+
+EFFECT_PLUGIN_EXPORT void effect_plugin_reset(void* context) {
+    GainContext* ctx = (GainContext*)context;
+    ctx->gain = atomic_load_explicit(&ctx->targetGain, memory_order_relaxed);
+}
+
+EFFECT_PLUGIN_EXPORT uint32_t effect_plugin_get_latency(void* context __attribute__((unused))) {
+    return 0;
+}
+
+EFFECT_PLUGIN_EXPORT void effect_plugin_destroy(void* context) {
+    free(context);
+}
@@ -0,0 +1,60 @@
+/**
+ * Sample plugin: interleaved passthrough
+ *
+ * Measures the cost of the plugin call path itself (dispatch, queue access,
+ * wrap handling) without any DSP.
+ */
+#include "effect_plugin.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    size_t periodBytes;
+} PassthroughContext;
+
+EFFECT_PLUGIN_EXPORT uint32_t effect_plugin_get_abi_version(void) {
+    return EFFECT_PLUGIN_ABI_VERSION;
+}
+
+EFFECT_PLUGIN_EXPORT int effect_plugin_create(const EffectPluginConfig* config, void** context) {
+    if (!config || !context || config->layout != EFFECT_PLUGIN_LAYOUT_INTERLEAVED) {
+        return -1;
+    }
+    
+    PassthroughContext* ctx = (PassthroughContext*)calloc(1, sizeof(PassthroughContext));
+    if (!ctx) {
+        return -1;
+    }
+    
+    size_t bytesPerSample = (config->format == 16) ? 2 : 4;
+    ctx->periodBytes = (size_t)config->framesPerBuffer * config->channels * bytesPerSample;
+    *context = ctx;
+    return 0;
+}
+
+EFFECT_PLUGIN_EXPORT int effect_plugin_process(void* context, const EffectPluginBuffer* input,
+                                               EffectPluginBuffer* output) {
+    PassthroughContext* ctx = (PassthroughContext*)context;
+    memcpy(output->planes[0], input->planes[0], ctx->periodBytes);
+    return 0;
+}
+
+EFFECT_PLUGIN_EXPORT int effect_plugin_set_param(void* context __attribute__((unused)),
+                                                 uint32_t key __attribute__((unused)),
+                                                 const void* value __attribute__((unused)),
+                                                 uint32_t valueSize __attribute__((unused))) {
+    // No parameters
+    return -1;
+}
+
+EFFECT_PLUGIN_EXPORT void effect_plugin_reset(void* context __attribute__((unused))) {
+    // Stateless
+}
+
+EFFECT_PLUGIN_EXPORT uint32_t effect_plugin_get_latency(void* context __attribute__((unused))) {
+    return 0;
+}
+
+EFFECT_PLUGIN_EXPORT void effect_plugin_destroy(void* context) {
+    free(context);
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "effectd_blob_cache.h"
+#include "effect_shared_memory.h"
+
+#define BLOB_SIZE (1024 * 1024 + 3)   // Not a whole number of words or pages
+
+static uint8_t* make_content(uint8_t seed) {
+    uint8_t* content = (uint8_t*)malloc(BLOB_SIZE);
+    assert(content != NULL);
+    for (size_t i = 0; i < BLOB_SIZE; i++) {
+        content[i] = (uint8_t)(i * 31 + seed);
+    }
+    return content;
+}
+
+void test_blob_cache_sealed_fd() {
+    printf("Running test_blob_cache_sealed_fd...\n");
+    
+    EffectdBlobCache* cache = effectd_blob_cache_create();
+    assert(cache != NULL);
+    uint8_t* content = make_content(1);
+    
+    // Two clients hand over the same model in separate memfds
+    int fd1 = effect_shared_memory_create_sealed("blob1", content, BLOB_SIZE);
+    int fd2 = effect_shared_memory_create_sealed("blob2", content, BLOB_SIZE);
+    assert(fd1 >= 0 && fd2 >= 0);
+    
+    EffectdBlob* blob1 = effectd_blob_cache_get_fd(cache, fd1);
+    EffectdBlob* blob2 = effectd_blob_cache_get_fd(cache, fd2);
+    assert(blob1 != NULL);
+    assert(blob2 == blob1);
+    assert(effectd_blob_cache_get_count(cache) == 1);
+    assert(effectd_blob_get_size(blob1) == BLOB_SIZE);
+    assert(memcmp(effectd_blob_get_data(blob1), content, BLOB_SIZE) == 0);
+    
+    // The mapping outlives the client's fds
+    close(fd1);
+    close(fd2);
+    assert(memcmp(effectd_blob_get_data(blob1), content, BLOB_SIZE) == 0);
+    
+    // Different content, different blob
+    content[BLOB_SIZE - 1] ^= 0xFF;
+    int fd3 = effect_shared_memory_create_sealed("blob3", content, BLOB_SIZE);
+    EffectdBlob* blob3 = effectd_blob_cache_get_fd(cache, fd3);
+    assert(blob3 != NULL && blob3 != blob1);
+    assert(effectd_blob_cache_get_count(cache) == 2);
+    close(fd3);
+    
+    // Released with the last reference
+    effectd_blob_release(blob1);
+    assert(effectd_blob_cache_get_count(cache) == 2);
+    effectd_blob_release(blob2);
+    assert(effectd_blob_cache_get_count(cache) == 1);
+    effectd_blob_release(blob3);
+    assert(effectd_blob_cache_get_count(cache) == 0);
+    
+    free(content);
+    effectd_blob_cache_destroy(cache);
+    
+    printf("✓ test_blob_cache_sealed_fd passed\n");
+}
+
+void test_blob_cache_rejects_unsealed() {
+    printf("Running test_blob_cache_rejects_unsealed...\n");
+    
+    EffectdBlobCache* cache = effectd_blob_cache_create();
+    assert(cache != NULL);
+    
+    // Still writable, so its content could change under the mapping
+    int fd = effect_shared_memory_create("unsealed", 4096, 0);
+    assert(fd >= 0);
+    assert(effectd_blob_cache_get_fd(cache, fd) == NULL);
+    close(fd);
+    
+    assert(effectd_blob_cache_get_fd(cache, -1) == NULL);
+    assert(effect_shared_memory_create_sealed("empty", "", 0) < 0);
+    assert(effectd_blob_cache_get_count(cache) == 0);
+    
+    effectd_blob_cache_destroy(cache);
+    
+    printf("✓ test_blob_cache_rejects_unsealed passed\n");
+}
+
+static void write_file(const char* path, const uint8_t* content) {
+    FILE* file = fopen(path, "wb");
+    assert(file != NULL);
+    assert(fwrite(content, 1, BLOB_SIZE, file) == BLOB_SIZE);
+    fclose(file);
+}
+
+void test_blob_cache_file() {
+    printf("Running test_blob_cache_file...\n");
+    
+    EffectdBlobCache* cache = effectd_blob_cache_create();
+    assert(cache != NULL);
+    uint8_t* content = make_content(7);
+    
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_blob_cache_%d.bin", (int)getpid());
+    write_file(path, content);
+    
+    // A file and a memfd with the same content share a mapping
+    int fileFd = open(path, O_RDONLY);
+    assert(fileFd >= 0);
+    EffectdBlob* fromFile = effectd_blob_cache_get_file(cache, fileFd);
+    assert(fromFile != NULL);
+    int fd = effect_shared_memory_create_sealed("blob", content, BLOB_SIZE);
+    EffectdBlob* fromFd = effectd_blob_cache_get_fd(cache, fd);
+    close(fd);
+    assert(fromFd == fromFile);
+    assert(effectd_blob_cache_get_count(cache) == 1);
+    
+    // The same version of the file is not copied again
+    EffectdBlob* again = effectd_blob_cache_get_file(cache, fileFd);
+    assert(again == fromFile);
+    close(fileFd);
+    
+    // Rewriting the file leaves the copy alone and yields a new blob
+    uint8_t* changed = make_content(8);
+    struct timespec pause = { 0, 10 * 1000 * 1000 };
+    nanosleep(&pause, NULL);
+    write_file(path, changed);
+    fileFd = open(path, O_RDONLY);
+    assert(fileFd >= 0);
+    EffectdBlob* newer = effectd_blob_cache_get_file(cache, fileFd);
+    close(fileFd);
+    assert(newer != NULL && newer != fromFile);
+    assert(memcmp(effectd_blob_get_data(fromFile), content, BLOB_SIZE) == 0);
+    assert(memcmp(effectd_blob_get_data(newer), changed, BLOB_SIZE) == 0);
+    
+    // Even truncated, the file cannot pull the pages from under a mapping
+    assert(truncate(path, 0) == 0);
+    assert(((const uint8_t*)effectd_blob_get_data(newer))[BLOB_SIZE - 1] == changed[BLOB_SIZE - 1]);
+    
+    // Only regular files
+    int dirFd = open("/tmp", O_RDONLY | O_DIRECTORY);
+    assert(effectd_blob_cache_get_file(cache, dirFd) == NULL);
+    close(dirFd);
+    assert(effectd_blob_cache_get_file(cache, -1) == NULL);
+    
+    effectd_blob_release(fromFile);
+    effectd_blob_release(again);
+    effectd_blob_release(fromFd);
+    effectd_blob_release(newer);
+    assert(effectd_blob_cache_get_count(cache) == 0);
+    
+    unlink(path);
+    free(changed);
+    free(content);
+    effectd_blob_cache_destroy(cache);
+    
+    printf("✓ test_blob_cache_file passed\n");
+}
+
+int main() {
+    printf("Starting blob cache tests...\n\n");
+    
+    test_blob_cache_sealed_fd();
+    test_blob_cache_rejects_unsealed();
+    test_blob_cache_file();
+    
+    printf("\n✓ All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,486 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "effect_client.h"
+#include "effect_control.h"
+#include "effect_ringbuffer.h"
+#include "effect_shared_memory.h"
+
+#define SAMPLE_RATE 48000
+#define FRAMES_PER_PERIOD 480         // 10 ms
+#define TIMEOUT_PERCENT 500           // Generous, so only stalled periods time out
+#define PROCESSED_OFFSET 1000         // Added to every sample effectd processes
+#define MAX_POOLS 3                   // Pool IDs the client uses, plus 0
+
+/**
+ * Stand-in for effectd, in-process: answers the control calls and turns
+ * each input period into one output period with PROCESSED_OFFSET added.
+ * Every sample of a period carries the period's tag; periods tagged
+ * stallFrom or later are held back until the test raises stallFrom.
+ */
+typedef struct {
+    int listenFd;
+    pthread_t controlThread;
+    pthread_t processThread;
+    
+    pthread_mutex_t lock;             // Guards the attached session
+    uint8_t* pools[MAX_POOLS];
+    uint64_t poolSizes[MAX_POOLS];
+    uint8_t* region;                  // Private region, if not in a pool
+    uint64_t regionSize;
+    bool attached;
+    effect_ringbuffer_t inputRb;
+    effect_ringbuffer_t outputRb;
+    int eventOut;
+    uint32_t periodBytes;
+    
+    atomic_int stallFrom;
+    atomic_uint processed;            // Periods of the attached session
+    atomic_bool quit;
+} FakeEffectd;
+
+static FakeEffectd g_effectd;
+
+static void init_reply(EffectControlMessage* reply, const EffectControlMessage* request,
+                       int32_t result) {
+    memset(&reply->header, 0, sizeof(reply->header));
+    reply->header.requestId = request->header.requestId;
+    reply->header.op = request->header.op;
+    reply->header.id = request->header.id;
+    reply->header.result = result;
+    reply->fds[0] = -1;
+    reply->fds[1] = -1;
+    reply->fds[2] = -1;
+}
+
+static int32_t fake_open(FakeEffectd* fake, EffectControlMessage* req) {
+    const EffectControlOpenArgs* args = &req->body.open;
+    uint8_t* base;
+    
+    if (args->poolId != 0) {
+        assert(args->poolId < MAX_POOLS && fake->pools[args->poolId]);
+        base = fake->pools[args->poolId];
+    } else {
+        assert(req->fds[0] >= 0);
+        base = (uint8_t*)effect_shared_memory_map(req->fds[0], args->layout.size, 0);
+        assert(base != NULL);
+        fake->region = base;
+        fake->regionSize = args->layout.size;
+    }
+    assert(req->fds[2] >= 0);
+    
+    pthread_mutex_lock(&fake->lock);
+    assert(effect_ringbuffer_attach(&fake->inputRb, base + args->layout.inputRingBufferOffset,
+                                    args->layout.inputRingBufferSize) == 0);
+    assert(effect_ringbuffer_attach(&fake->outputRb, base + args->layout.outputRingBufferOffset,
+                                    args->layout.outputRingBufferSize) == 0);
+    fake->eventOut = req->fds[2];
+    req->fds[2] = -1;
+    fake->periodBytes = args->framesPerBuffer * args->channels * (args->format == 16 ? 2 : 4);
+    atomic_store(&fake->processed, 0);
+    fake->attached = true;
+    pthread_mutex_unlock(&fake->lock);
+    return EFFECT_CONTROL_OK;
+}
+
+static void fake_close(FakeEffectd* fake) {
+    pthread_mutex_lock(&fake->lock);
+    fake->attached = false;
+    close(fake->eventOut);
+    if (fake->region) {
+        effect_shared_memory_unmap(fake->region, fake->regionSize);
+        fake->region = NULL;
+    }
+    pthread_mutex_unlock(&fake->lock);
+}
+
+static void* fake_control_func(void* arg) {
+    FakeEffectd* fake = (FakeEffectd*)arg;
+    int fd = accept(fake->listenFd, NULL, NULL);
+    assert(fd >= 0);
+    
+    EffectControlMessage requests[EFFECT_CONTROL_MAX_BATCH];
+    EffectControlMessage replies[EFFECT_CONTROL_MAX_BATCH];
+    int count;
+    while ((count = effect_control_recv_packet(fd, requests)) > 0) {
+        for (int i = 0; i < count; i++) {
+            EffectControlMessage* req = &requests[i];
+            int32_t result = EFFECT_CONTROL_OK;
+            
+            switch (req->header.op) {
+                case EFFECT_CONTROL_OP_CONNECT:
+                    // Runs every library itself
+                    result = EFFECT_CONTROL_ERROR_NOT_SUPPORTED;
+                    break;
+                case EFFECT_CONTROL_OP_REGISTER_POOL:
+                    assert(req->header.id < MAX_POOLS && req->fds[0] >= 0);
+                    fake->pools[req->header.id] =
+                        (uint8_t*)effect_shared_memory_map(req->fds[0], req->body.pool.size, 0);
+                    fake->poolSizes[req->header.id] = req->body.pool.size;
+                    assert(fake->pools[req->header.id] != NULL);
+                    break;
+                case EFFECT_CONTROL_OP_OPEN:
+                    result = fake_open(fake, req);
+                    req->header.id = 1;
+                    break;
+                case EFFECT_CONTROL_OP_CLOSE:
+                    fake_close(fake);
+                    break;
+                default:
+                    break;
+            }
+            
+            init_reply(&replies[i], req, result);
+            effect_control_close_fds(req);
+        }
+        assert(effect_control_send_packet(fd, replies, (uint32_t)count) == 0);
+    }
+    
+    close(fd);
+    return NULL;
+}
+
+/**
+ * Process the next input period unless it is stalled
+ *
+ * @return Whether a period was processed
+ */
+static bool fake_process_one(FakeEffectd* fake) {
+    int16_t samples[FRAMES_PER_PERIOD * 2];
+    bool done = false;
+    
+    pthread_mutex_lock(&fake->lock);
+    effect_ringbuffer_region_t region;
+    if (fake->attached && fake->periodBytes <= sizeof(samples) &&
+        effect_ringbuffer_acquire_read(&fake->inputRb, fake->periodBytes, &region) != 0 &&
+        *(const int16_t*)region.first < atomic_load(&fake->stallFrom)) {
+        assert(effect_ringbuffer_read(&fake->inputRb, samples, fake->periodBytes) ==
+               fake->periodBytes);
+        for (uint32_t i = 0; i < fake->periodBytes / sizeof(int16_t); i++) {
+            samples[i] += PROCESSED_OFFSET;
+        }
+        assert(effect_ringbuffer_write(&fake->outputRb, samples, fake->periodBytes) ==
+               fake->periodBytes);
+        effect_eventfd_signal(fake->eventOut);
+        atomic_fetch_add(&fake->processed, 1);
+        done = true;
+    }
+    pthread_mutex_unlock(&fake->lock);
+    return done;
+}
+
+static void* fake_process_func(void* arg) {
+    FakeEffectd* fake = (FakeEffectd*)arg;
+    while (!atomic_load(&fake->quit)) {
+        if (!fake_process_one(fake)) {
+            usleep(100);
+        }
+    }
+    return NULL;
+}
+
+static void fake_start(FakeEffectd* fake) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_client_%d.sock", (int)getpid());
+    unlink(path);
+    
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    
+    memset(fake, 0, sizeof(*fake));
+    pthread_mutex_init(&fake->lock, NULL);
+    atomic_store(&fake->stallFrom, 0x7fff);
+    fake->listenFd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    assert(fake->listenFd >= 0);
+    assert(bind(fake->listenFd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    assert(listen(fake->listenFd, 1) == 0);
+    setenv(EFFECT_CONTROL_PATH_ENV, path, 1);
+    
+    pthread_create(&fake->controlThread, NULL, fake_control_func, fake);
+    pthread_create(&fake->processThread, NULL, fake_process_func, fake);
+}
+
+static void fake_stop(FakeEffectd* fake) {
+    atomic_store(&fake->quit, true);
+    pthread_join(fake->processThread, NULL);
+    
+    // The client keeps its connection; the control thread goes with us
+    close(fake->listenFd);
+    unlink(getenv(EFFECT_CONTROL_PATH_ENV));
+}
+
+/**
+ * Wait until effectd has processed count periods of the session
+ */
+static void wait_processed(FakeEffectd* fake, unsigned count) {
+    for (int i = 0; i < 10000 && atomic_load(&fake->processed) < count; i++) {
+        usleep(100);
+    }
+    assert(atomic_load(&fake->processed) == count);
+}
+
+/**
+ * Input periods queued and not yet processed
+ */
+static uint32_t queued_periods(FakeEffectd* fake) {
+    pthread_mutex_lock(&fake->lock);
+    uint32_t periods = effect_ringbuffer_get_read_available(&fake->inputRb) / fake->periodBytes;
+    pthread_mutex_unlock(&fake->lock);
+    return periods;
+}
+
+static EffectHandle open_session(uint32_t pipelineDepth) {
+    EffectConfig config;
+    memset(&config, 0, sizeof(config));
+    config.sampleRate = SAMPLE_RATE;
+    config.channels = 1;
+    config.format = 16;
+    config.framesPerBuffer = FRAMES_PER_PERIOD;
+    config.pipelineDepth = pipelineDepth;
+    config.timeoutPercent = TIMEOUT_PERCENT;
+    
+    EffectHandle handle;
+    assert(EffectClient_Open(EFFECT_TYPE_KARAOKE_NO_MIC, &config, &handle) == EFFECT_OK);
+    assert(EffectClient_Start(handle) == EFFECT_OK);
+    return handle;
+}
+
+static void close_session(EffectHandle handle) {
+    assert(EffectClient_Stop(handle) == EFFECT_OK);
+    assert(EffectClient_Close(handle) == EFFECT_OK);
+}
+
+/**
+ * Process periods tagged firstTag onwards
+ */
+static EffectResult process(EffectHandle handle, int16_t firstTag, uint32_t periods,
+                            int16_t* output) {
+    int16_t input[FRAMES_PER_PERIOD * 2];
+    assert(periods <= 2);
+    for (uint32_t p = 0; p < periods; p++) {
+        for (uint32_t f = 0; f < FRAMES_PER_PERIOD; f++) {
+            input[p * FRAMES_PER_PERIOD + f] = (int16_t)(firstTag + p);
+        }
+    }
+    return EffectClient_Process(handle, input, output, periods * FRAMES_PER_PERIOD);
+}
+
+static bool period_is(const int16_t* period, int value) {
+    for (uint32_t f = 0; f < FRAMES_PER_PERIOD; f++) {
+        if (period[f] != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_client_late_output_sync() {
+    printf("Running test_client_late_output_sync...\n");
+    
+    EffectHandle handle = open_session(0);
+    int16_t output[FRAMES_PER_PERIOD * 2];
+    
+    assert(process(handle, 0, 1, output) == EFFECT_OK);
+    assert(period_is(output, 0 + PROCESSED_OFFSET));
+    
+    // Period 1 misses its deadline: passed through
+    atomic_store(&g_effectd.stallFrom, 1);
+    assert(process(handle, 1, 1, output) == EFFECT_ERROR_TIMEOUT);
+    assert(period_is(output, 1));
+    
+    // Its output arrives late and is never returned for period 2
+    atomic_store(&g_effectd.stallFrom, 0x7fff);
+    wait_processed(&g_effectd, 2);
+    assert(process(handle, 2, 1, output) == EFFECT_OK);
+    assert(period_is(output, 2 + PROCESSED_OFFSET));
+    assert(process(handle, 3, 1, output) == EFFECT_OK);
+    assert(period_is(output, 3 + PROCESSED_OFFSET));
+    
+    // A two-period call keeps the period finished in time
+    atomic_store(&g_effectd.stallFrom, 5);
+    assert(process(handle, 4, 2, output) == EFFECT_ERROR_TIMEOUT);
+    assert(period_is(output, 4 + PROCESSED_OFFSET));
+    assert(period_is(output + FRAMES_PER_PERIOD, 5));
+    
+    atomic_store(&g_effectd.stallFrom, 0x7fff);
+    wait_processed(&g_effectd, 6);
+    assert(process(handle, 6, 1, output) == EFFECT_OK);
+    assert(period_is(output, 6 + PROCESSED_OFFSET));
+    
+    EffectStats stats;
+    assert(EffectClient_QueryStats(handle, &stats) == EFFECT_OK);
+    assert(stats.timeoutCount == 2);
+    assert(stats.processedFrames == 5 * FRAMES_PER_PERIOD);
+    
+    close_session(handle);
+    
+    printf("✓ test_client_late_output_sync passed\n");
+}
+
+void test_client_late_output_pipelined() {
+    printf("Running test_client_late_output_pipelined...\n");
+    
+    EffectHandle handle = open_session(1);
+    int16_t output[FRAMES_PER_PERIOD];
+    
+    // Filling: silence, then each call returns the previous period
+    assert(process(handle, 0, 1, output) == EFFECT_OK);
+    assert(period_is(output, 0));
+    wait_processed(&g_effectd, 1);
+    assert(process(handle, 1, 1, output) == EFFECT_OK);
+    assert(period_is(output, 0 + PROCESSED_OFFSET));
+    wait_processed(&g_effectd, 2);
+    
+    // Period 2 is held back: the call owed it times out
+    atomic_store(&g_effectd.stallFrom, 2);
+    assert(process(handle, 2, 1, output) == EFFECT_OK);
+    assert(period_is(output, 1 + PROCESSED_OFFSET));
+    assert(process(handle, 3, 1, output) == EFFECT_ERROR_TIMEOUT);
+    assert(period_is(output, 3));
+    
+    // Once it arrives, the next call skips it and returns period 3
+    atomic_store(&g_effectd.stallFrom, 0x7fff);
+    wait_processed(&g_effectd, 4);
+    assert(process(handle, 4, 1, output) == EFFECT_OK);
+    assert(period_is(output, 3 + PROCESSED_OFFSET));
+    wait_processed(&g_effectd, 5);
+    assert(process(handle, 5, 1, output) == EFFECT_OK);
+    assert(period_is(output, 4 + PROCESSED_OFFSET));
+    
+    close_session(handle);
+    
+    printf("✓ test_client_late_output_pipelined passed\n");
+}
+
+void test_client_partial_period() {
+    printf("Running test_client_partial_period...\n");
+    
+    EffectHandle handle = open_session(0);
+    int16_t input[FRAMES_PER_PERIOD];
+    int16_t output[FRAMES_PER_PERIOD];
+    
+    // Not a whole period: effectd never sees it, the HAL gets the input
+    for (uint32_t f = 0; f < FRAMES_PER_PERIOD; f++) {
+        input[f] = 7;
+        output[f] = -1;
+    }
+    assert(EffectClient_Process(handle, input, output, FRAMES_PER_PERIOD / 2) ==
+           EFFECT_ERROR_INVALID_ARGUMENTS);
+    for (uint32_t f = 0; f < FRAMES_PER_PERIOD; f++) {
+        assert(output[f] == (f < FRAMES_PER_PERIOD / 2 ? 7 : -1));
+    }
+    assert(queued_periods(&g_effectd) == 0);
+    
+    // The session carries on with the next whole period
+    assert(process(handle, 0, 1, output) == EFFECT_OK);
+    assert(period_is(output, 0 + PROCESSED_OFFSET));
+    
+    close_session(handle);
+    
+    printf("✓ test_client_partial_period passed\n");
+}
+
+static void expect_breaker(EffectHandle handle, uint32_t trips, uint32_t recoveries) {
+    EffectStats stats;
+    assert(EffectClient_QueryStats(handle, &stats) == EFFECT_OK);
+    assert(stats.breakerTripCount == trips);
+    assert(stats.breakerRecoveryCount == recoveries);
+}
+
+void test_client_breaker() {
+    printf("Running test_client_breaker...\n");
+    
+    EffectHandle handle = open_session(1);
+    int16_t output[FRAMES_PER_PERIOD];
+    
+    assert(process(handle, 0, 1, output) == EFFECT_OK);
+    wait_processed(&g_effectd, 1);
+    assert(process(handle, 1, 1, output) == EFFECT_OK);
+    wait_processed(&g_effectd, 2);
+    
+    // Three timeouts in a row trip it
+    atomic_store(&g_effectd.stallFrom, 2);
+    assert(process(handle, 2, 1, output) == EFFECT_OK);
+    assert(process(handle, 3, 1, output) == EFFECT_ERROR_TIMEOUT);
+    assert(process(handle, 4, 1, output) == EFFECT_ERROR_TIMEOUT);
+    expect_breaker(handle, 0, 0);
+    assert(process(handle, 5, 1, output) == EFFECT_ERROR_TIMEOUT);
+    expect_breaker(handle, 1, 0);
+    assert(queued_periods(&g_effectd) == 4);
+    
+    // Open: passed through without reaching effectd
+    assert(process(handle, 6, 1, output) == EFFECT_ERROR_TIMEOUT);
+    assert(period_is(output, 6));
+    assert(queued_periods(&g_effectd) == 4);
+    
+    // A probe is sent once the interval has passed; as it fails, the next
+    // call is bypassed again
+    usleep(110000);
+    assert(process(handle, 7, 1, output) == EFFECT_ERROR_TIMEOUT);
+    assert(queued_periods(&g_effectd) == 5);
+    assert(process(handle, 8, 1, output) == EFFECT_ERROR_TIMEOUT);
+    assert(queued_periods(&g_effectd) == 5);
+    
+    // Probes wait for their own period; on time, the next call probes too
+    atomic_store(&g_effectd.stallFrom, 0x7fff);
+    wait_processed(&g_effectd, 7);
+    usleep(110000);
+    assert(process(handle, 9, 1, output) == EFFECT_OK);
+    assert(period_is(output, 9 + PROCESSED_OFFSET));
+    assert(process(handle, 10, 1, output) == EFFECT_OK);
+    assert(period_is(output, 10 + PROCESSED_OFFSET));
+    
+    // A late probe ends the streak
+    atomic_store(&g_effectd.stallFrom, 11);
+    assert(process(handle, 11, 1, output) == EFFECT_ERROR_TIMEOUT);
+    assert(process(handle, 12, 1, output) == EFFECT_ERROR_TIMEOUT);
+    assert(queued_periods(&g_effectd) == 1);
+    atomic_store(&g_effectd.stallFrom, 0x7fff);
+    wait_processed(&g_effectd, 10);
+    
+    // It closes after eight probes in a row on time, counted afresh
+    usleep(110000);
+    for (int16_t tag = 13; tag < 20; tag++) {
+        assert(process(handle, tag, 1, output) == EFFECT_OK);
+        assert(period_is(output, tag + PROCESSED_OFFSET));
+    }
+    expect_breaker(handle, 1, 0);
+    assert(process(handle, 20, 1, output) == EFFECT_OK);
+    assert(period_is(output, 20 + PROCESSED_OFFSET));
+    expect_breaker(handle, 1, 1);
+    
+    // The pipeline refills as after Start
+    assert(process(handle, 21, 1, output) == EFFECT_OK);
+    assert(period_is(output, 0));
+    wait_processed(&g_effectd, 19);
+    assert(process(handle, 22, 1, output) == EFFECT_OK);
+    assert(period_is(output, 21 + PROCESSED_OFFSET));
+    
+    close_session(handle);
+    
+    printf("✓ test_client_breaker passed\n");
+}
+
+int main() {
+    printf("Starting client tests...\n\n");
+    
+    fake_start(&g_effectd);
+    
+    test_client_late_output_sync();
+    test_client_late_output_pipelined();
+    test_client_partial_period();
+    test_client_breaker();
+    
+    fake_stop(&g_effectd);
+    
+    printf("\n✓ All tests passed!\n");
+    return 0;
+}
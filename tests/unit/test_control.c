@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "effect_control.h"
+
+#define NUM_PIPELINED 8
+
+static void init_message(EffectControlMessage* msg, uint16_t op, uint32_t id) {
+    memset(msg, 0, sizeof(*msg));
+    msg->header.op = op;
+    msg->header.id = id;
+    msg->fds[0] = -1;
+    msg->fds[1] = -1;
+    msg->fds[2] = -1;
+}
+
+void test_control_batch_with_fds() {
+    printf("Running test_control_batch_with_fds...\n");
+    
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == 0);
+    
+    int eventIn = effect_eventfd_create(0);
+    int eventOut = effect_eventfd_create(0);
+    assert(eventIn >= 0 && eventOut >= 0);
+    
+    EffectControlMessage msgs[3];
+    init_message(&msgs[0], EFFECT_CONTROL_OP_SET_PARAM, 7);
+    msgs[0].body.param.key = 42;
+    msgs[0].body.param.valueSize = 3;
+    memcpy(msgs[0].body.param.value, "abc", 3);
+    msgs[0].header.payloadSize = 8 + 3;
+    
+    // Only the eventfds are attached; fds[0] must not travel
+    init_message(&msgs[1], EFFECT_CONTROL_OP_OPEN, 0);
+    msgs[1].header.fdMask = EFFECT_CONTROL_FD_EVENT_IN | EFFECT_CONTROL_FD_EVENT_OUT;
+    msgs[1].fds[0] = 0;
+    msgs[1].fds[1] = eventIn;
+    msgs[1].fds[2] = eventOut;
+    msgs[1].body.open.framesPerBuffer = 480;
+    msgs[1].body.open.layout.size = 65536;
+    msgs[1].header.payloadSize = sizeof(msgs[1].body.open);
+    
+    init_message(&msgs[2], EFFECT_CONTROL_OP_QUERY_STATE, 9);
+    
+    assert(effect_control_send_packet(sv[0], msgs, 3) == 0);
+    
+    EffectControlMessage received[EFFECT_CONTROL_MAX_BATCH];
+    assert(effect_control_recv_packet(sv[1], received) == 3);
+    
+    assert(received[0].header.op == EFFECT_CONTROL_OP_SET_PARAM);
+    assert(received[0].header.id == 7);
+    assert(received[0].body.param.key == 42);
+    assert(memcmp(received[0].body.param.value, "abc", 3) == 0);
+    assert(received[0].body.param.value[3] == 0);
+    assert(received[0].fds[0] == -1 && received[0].fds[1] == -1);
+    
+    assert(received[1].body.open.framesPerBuffer == 480);
+    assert(received[1].body.open.layout.size == 65536);
+    assert(received[1].fds[0] == -1);
+    assert(received[1].fds[1] >= 0 && received[1].fds[1] != eventIn);
+    assert(received[1].fds[2] >= 0 && received[1].fds[2] != eventOut);
+    
+    // The received fds are the same eventfds
+    assert(effect_eventfd_signal(received[1].fds[1]) == 0);
+    assert(effect_eventfd_wait(eventIn, 0) == 0);
+    assert(effect_eventfd_signal(eventOut) == 0);
+    assert(effect_eventfd_wait(received[1].fds[2], 0) == 0);
+    
+    assert(received[2].header.op == EFFECT_CONTROL_OP_QUERY_STATE);
+    assert(received[2].header.id == 9);
+    
+    effect_control_close_fds(&received[1]);
+    assert(received[1].fds[1] == -1 && received[1].fds[2] == -1);
+    
+    close(eventIn);
+    close(eventOut);
+    close(sv[0]);
+    close(sv[1]);
+    
+    printf("✓ test_control_batch_with_fds passed\n");
+}
+
+void test_control_malformed() {
+    printf("Running test_control_malformed...\n");
+    
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == 0);
+    EffectControlMessage received[EFFECT_CONTROL_MAX_BATCH];
+    
+    // Payload larger than any body
+    EffectControlHeader header;
+    memset(&header, 0, sizeof(header));
+    header.op = EFFECT_CONTROL_OP_START;
+    header.payloadSize = 1u << 20;
+    assert(send(sv[0], &header, sizeof(header), 0) == sizeof(header));
+    assert(effect_control_recv_packet(sv[1], received) == -1);
+    
+    // Claims fds the packet does not carry
+    header.payloadSize = 0;
+    header.fdMask = EFFECT_CONTROL_FD_SHM;
+    assert(send(sv[0], &header, sizeof(header), 0) == sizeof(header));
+    assert(effect_control_recv_packet(sv[1], received) == -1);
+    
+    // Truncated header
+    assert(send(sv[0], &header, 4, 0) == 4);
+    assert(effect_control_recv_packet(sv[1], received) == -1);
+    
+    // Peer gone
+    close(sv[0]);
+    assert(effect_control_recv_packet(sv[1], received) == 0);
+    close(sv[1]);
+    
+    printf("✓ test_control_malformed passed\n");
+}
+
+/**
+ * Answers each packet with its replies in reverse order, result = 2 * id,
+ * then hangs up after stopAfter packets
+ */
+typedef struct {
+    int listenFd;
+    int stopAfter;
+} EchoServer;
+
+static void* echo_server_func(void* arg) {
+    EchoServer* server = (EchoServer*)arg;
+    int fd = accept(server->listenFd, NULL, NULL);
+    assert(fd >= 0);
+    
+    EffectControlMessage requests[EFFECT_CONTROL_MAX_BATCH];
+    EffectControlMessage replies[EFFECT_CONTROL_MAX_BATCH];
+    for (int packet = 0; packet < server->stopAfter; packet++) {
+        int count = effect_control_recv_packet(fd, requests);
+        assert(count > 0);
+        for (int i = 0; i < count; i++) {
+            EffectControlMessage* reply = &replies[count - 1 - i];
+            init_message(reply, requests[i].header.op, requests[i].header.id);
+            reply->header.requestId = requests[i].header.requestId;
+            reply->header.result = (int32_t)requests[i].header.id * 2;
+        }
+        assert(effect_control_send_packet(fd, replies, (uint32_t)count) == 0);
+    }
+    
+    close(fd);
+    return NULL;
+}
+
+typedef struct {
+    EffectControlChannel* channel;
+    EffectControlMessage* msgs;
+    int first;
+    int step;
+} Waiter;
+
+static void* waiter_func(void* arg) {
+    Waiter* waiter = (Waiter*)arg;
+    for (int i = waiter->first; i >= 0; i -= waiter->step) {
+        EffectControlMessage reply;
+        assert(effect_control_wait(waiter->channel, waiter->msgs[i].header.requestId, &reply,
+                                   -1) == 0);
+        assert(reply.header.id == waiter->msgs[i].header.id);
+        assert(reply.header.result == (int32_t)waiter->msgs[i].header.id * 2);
+    }
+    return NULL;
+}
+
+void test_control_channel_pipelined() {
+    printf("Running test_control_channel_pipelined...\n");
+    
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_control_%d.sock", (int)getpid());
+    unlink(path);
+    
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    
+    EchoServer server;
+    server.listenFd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    server.stopAfter = NUM_PIPELINED / 2 + 2;
+    assert(server.listenFd >= 0);
+    assert(bind(server.listenFd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    assert(listen(server.listenFd, 1) == 0);
+    
+    pthread_t serverThread;
+    pthread_create(&serverThread, NULL, echo_server_func, &server);
+    
+    assert(effect_control_connect("/tmp/no_such_effectd.sock") == NULL);
+    EffectControlChannel* channel = effect_control_connect(path);
+    assert(channel != NULL);
+    assert(!effect_control_is_broken(channel));
+    
+    // Half the requests go one per packet without waiting, the rest as one batch
+    EffectControlMessage msgs[NUM_PIPELINED];
+    for (int i = 0; i < NUM_PIPELINED; i++) {
+        init_message(&msgs[i], EFFECT_CONTROL_OP_QUERY_STATE, (uint32_t)(100 + i));
+    }
+    for (int i = 0; i < NUM_PIPELINED / 2; i++) {
+        assert(effect_control_submit(channel, &msgs[i], 1) == 0);
+    }
+    assert(effect_control_submit(channel, &msgs[NUM_PIPELINED / 2], NUM_PIPELINED / 2) == 0);
+    
+    // Collected newest first, from two threads at once
+    Waiter waiters[2];
+    pthread_t threads[2];
+    for (int t = 0; t < 2; t++) {
+        waiters[t].channel = channel;
+        waiters[t].msgs = msgs;
+        waiters[t].first = NUM_PIPELINED - 1 - t;
+        waiters[t].step = 2;
+        pthread_create(&threads[t], NULL, waiter_func, &waiters[t]);
+    }
+    for (int t = 0; t < 2; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    
+    // One more call, then the server hangs up
+    EffectControlMessage msg;
+    init_message(&msg, EFFECT_CONTROL_OP_START, 21);
+    assert(effect_control_call(channel, &msg, -1) == 42);
+    
+    // The hang-up is noticed without making a call
+    pthread_join(serverThread, NULL);
+    assert(effect_control_wait_broken(&channel, 1, -1) == 0);
+    assert(effect_control_is_broken(channel));
+    init_message(&msg, EFFECT_CONTROL_OP_STOP, 21);
+    assert(effect_control_call(channel, &msg, -1) == EFFECT_CONTROL_ERROR_DEAD_OBJECT);
+    assert(effect_control_is_broken(channel));
+    
+    effect_control_release(channel);
+    close(server.listenFd);
+    unlink(path);
+    
+    printf("✓ test_control_channel_pipelined passed\n");
+}
+
+void test_control_adopt_wait_broken() {
+    printf("Running test_control_adopt_wait_broken...\n");
+    
+    // Two connections handed over as sockets, as CONNECT replies carry them
+    int a[2];
+    int b[2];
+    assert(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, a) == 0);
+    assert(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, b) == 0);
+    EffectControlChannel* channels[2];
+    channels[0] = effect_control_adopt(a[0]);
+    channels[1] = effect_control_adopt(b[0]);
+    assert(channels[0] != NULL && channels[1] != NULL);
+    
+    // Both peers alive
+    assert(effect_control_wait_broken(channels, 2, 10) == -1);
+    assert(!effect_control_is_broken(channels[0]));
+    assert(!effect_control_is_broken(channels[1]));
+    
+    // The second peer goes away; only its channel breaks
+    close(b[1]);
+    assert(effect_control_wait_broken(channels, 2, 1000) == 1);
+    assert(!effect_control_is_broken(channels[0]));
+    assert(effect_control_is_broken(channels[1]));
+    
+    // A broken channel is reported without waiting
+    assert(effect_control_wait_broken(channels, 2, -1) == 1);
+    
+    effect_control_release(channels[0]);
+    effect_control_release(channels[1]);
+    close(a[1]);
+    
+    printf("✓ test_control_adopt_wait_broken passed\n");
+}
+
+typedef struct {
+    EffectControlChannel* channel;
+    uint32_t requestId;
+    int result;
+} TimedWaiter;
+
+static void* timed_waiter_func(void* arg) {
+    TimedWaiter* waiter = (TimedWaiter*)arg;
+    EffectControlMessage reply;
+    waiter->result = effect_control_wait(waiter->channel, waiter->requestId, &reply, 50);
+    return NULL;
+}
+
+void test_control_timeout() {
+    printf("Running test_control_timeout...\n");
+    
+    // A peer that takes the requests and never answers
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == 0);
+    EffectControlChannel* channel = effect_control_adopt(sv[0]);
+    assert(channel != NULL);
+    
+    EffectControlMessage msg;
+    init_message(&msg, EFFECT_CONTROL_OP_SET_PARAM, 3);
+    assert(effect_control_call(channel, &msg, 50) == EFFECT_CONTROL_ERROR_TIMEOUT);
+    
+    // The late reply could be taken for another's: the channel is given up
+    assert(effect_control_is_broken(channel));
+    init_message(&msg, EFFECT_CONTROL_OP_STOP, 3);
+    assert(effect_control_call(channel, &msg, 50) == EFFECT_CONTROL_ERROR_DEAD_OBJECT);
+    effect_control_release(channel);
+    close(sv[1]);
+    
+    // Waiters reading the socket and waiting for the reader both time out
+    assert(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == 0);
+    channel = effect_control_adopt(sv[0]);
+    assert(channel != NULL);
+    EffectControlMessage msgs[2];
+    init_message(&msgs[0], EFFECT_CONTROL_OP_START, 4);
+    init_message(&msgs[1], EFFECT_CONTROL_OP_START, 5);
+    assert(effect_control_submit(channel, msgs, 2) == 0);
+    
+    TimedWaiter waiters[2];
+    pthread_t threads[2];
+    for (int t = 0; t < 2; t++) {
+        waiters[t].channel = channel;
+        waiters[t].requestId = msgs[t].header.requestId;
+        waiters[t].result = 0;
+        assert(pthread_create(&threads[t], NULL, timed_waiter_func, &waiters[t]) == 0);
+    }
+    for (int t = 0; t < 2; t++) {
+        pthread_join(threads[t], NULL);
+        assert(waiters[t].result == -1);
+    }
+    assert(effect_control_is_broken(channel));
+    
+    effect_control_release(channel);
+    close(sv[1]);
+    
+    printf("✓ test_control_timeout passed\n");
+}
+
+int main() {
+    printf("Starting control plane tests...\n\n");
+    
+    test_control_batch_with_fds();
+    test_control_malformed();
+    test_control_channel_pipelined();
+    test_control_adopt_wait_broken();
+    test_control_timeout();
+    
+    printf("\n✓ All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "effect_histogram.h"
+
+void test_histogram_exact_small_values() {
+    printf("Running test_histogram_exact_small_values...\n");
+    
+    effect_histogram_t hist;
+    effect_histogram_reset(&hist);
+    
+    // Values below the sub-bucket count have a bucket each
+    for (uint32_t v = 1; v <= 10; v++) {
+        effect_histogram_record(&hist, v);
+    }
+    
+    assert(hist.count == 10);
+    assert(effect_histogram_mean(&hist) == 6);  // 5.5 rounded
+    assert(effect_histogram_percentile(&hist, 50.0) == 5);
+    assert(effect_histogram_percentile(&hist, 100.0) == 10);
+    assert(hist.max == 10);
+    
+    printf("✓ test_histogram_exact_small_values passed\n");
+}
+
+void test_histogram_percentiles() {
+    printf("Running test_histogram_percentiles...\n");
+    
+    effect_histogram_t hist;
+    effect_histogram_reset(&hist);
+    
+    // 1..10000 us, so the true pN is N * 100
+    for (uint32_t v = 1; v <= 10000; v++) {
+        effect_histogram_record(&hist, v);
+    }
+    
+    const double pct[] = { 50.0, 95.0, 99.0, 99.9 };
+    for (size_t i = 0; i < sizeof(pct) / sizeof(pct[0]); i++) {
+        uint32_t exact = (uint32_t)(pct[i] * 100.0 + 0.5);
+        uint32_t value = effect_histogram_percentile(&hist, pct[i]);
+        
+        // Reported as the bucket's upper bound: never low, at most 1/16 high
+        assert(value >= exact);
+        assert(value <= exact + exact / 16);
+    }
+    assert(effect_histogram_percentile(&hist, 100.0) == 10000);
+    
+    // Out of range values are clamped, not lost
+    effect_histogram_record(&hist, 0xFFFFFFFFu);
+    assert(hist.count == 10001);
+    assert(hist.max == 0xFFFFFFFFu);
+    
+    printf("✓ test_histogram_percentiles passed\n");
+}
+
+void test_histogram_interval() {
+    printf("Running test_histogram_interval...\n");
+    
+    effect_histogram_t hist;
+    effect_histogram_t prev;
+    effect_histogram_t delta;
+    effect_histogram_reset(&hist);
+    
+    // First interval: slow
+    for (int i = 0; i < 100; i++) {
+        effect_histogram_record(&hist, 5000);
+    }
+    prev = hist;
+    
+    // Second interval: fast
+    for (int i = 0; i < 100; i++) {
+        effect_histogram_record(&hist, 100);
+    }
+    
+    effect_histogram_subtract(&delta, &hist, &prev);
+    assert(delta.count == 100);
+    assert(effect_histogram_mean(&delta) == 100);
+    assert(effect_histogram_percentile(&delta, 99.9) <= 100 + 100 / 16);
+    assert(delta.max <= 100 + 100 / 16);
+    
+    // Cumulative view still sees the slow interval
+    assert(effect_histogram_percentile(&hist, 99.0) >= 5000);
+    
+    // Empty interval
+    effect_histogram_subtract(&delta, &hist, &hist);
+    assert(delta.count == 0);
+    assert(effect_histogram_percentile(&delta, 50.0) == 0);
+    assert(delta.max == 0);
+    
+    printf("✓ test_histogram_interval passed\n");
+}
+
+int main() {
+    printf("Starting histogram tests...\n\n");
+    
+    test_histogram_exact_small_values();
+    test_histogram_percentiles();
+    test_histogram_interval();
+    
+    printf("\n✓ All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "effectd_registry.h"
+
+#define NUM_READERS 4
+
+static EffectSession* new_session(void) {
+    EffectSession* session = (EffectSession*)calloc(1, sizeof(EffectSession));
+    assert(session != NULL);
+    return session;
+}
+
+void test_registry_lookup() {
+    printf("Running test_registry_lookup...\n");
+    
+    EffectdRegistry* registry = effectd_registry_create();
+    assert(registry != NULL);
+    
+    EffectSession* a = new_session();
+    EffectSession* b = new_session();
+    uint32_t idA = effectd_registry_add(registry, a);
+    uint32_t idB = effectd_registry_add(registry, b);
+    assert(idA != 0 && idB != 0 && idA != idB);
+    assert(a->sessionId == idA);
+    assert(effectd_registry_get_count(registry) == 2);
+    
+    assert(effectd_registry_acquire(registry, idA) == a);
+    assert(effectd_registry_acquire(registry, idB) == b);
+    effectd_registry_release(registry, idA);
+    effectd_registry_release(registry, idB);
+    
+    assert(effectd_registry_acquire(registry, 0) == NULL);
+    assert(effectd_registry_acquire(registry, idA + 1000) == NULL);
+    
+    assert(effectd_registry_remove(registry, idA) == a);
+    assert(effectd_registry_remove(registry, idA) == NULL);
+    assert(effectd_registry_remove(registry, idB) == b);
+    assert(effectd_registry_get_count(registry) == 0);
+    
+    effectd_registry_destroy(registry);
+    free(a);
+    free(b);
+    
+    printf("✓ test_registry_lookup passed\n");
+}
+
+void test_registry_stale_id() {
+    printf("Running test_registry_stale_id...\n");
+    
+    EffectdRegistry* registry = effectd_registry_create();
+    EffectSession* a = new_session();
+    EffectSession* b = new_session();
+    
+    // The slot is reused, but under a new generation
+    uint32_t idA = effectd_registry_add(registry, a);
+    assert(effectd_registry_remove(registry, idA) == a);
+    uint32_t idB = effectd_registry_add(registry, b);
+    assert((idA & (EFFECTD_REGISTRY_MAX_SESSIONS - 1)) == (idB & (EFFECTD_REGISTRY_MAX_SESSIONS - 1)));
+    assert(idA != idB);
+    
+    assert(effectd_registry_acquire(registry, idA) == NULL);
+    assert(effectd_registry_remove(registry, idA) == NULL);
+    assert(effectd_registry_acquire(registry, idB) == b);
+    effectd_registry_release(registry, idB);
+    
+    effectd_registry_remove(registry, idB);
+    effectd_registry_destroy(registry);
+    free(a);
+    free(b);
+    
+    printf("✓ test_registry_stale_id passed\n");
+}
+
+void test_registry_full() {
+    printf("Running test_registry_full...\n");
+    
+    EffectdRegistry* registry = effectd_registry_create();
+    EffectSession* session = new_session();
+    static uint32_t ids[EFFECTD_REGISTRY_MAX_SESSIONS];
+    
+    for (uint32_t i = 0; i < EFFECTD_REGISTRY_MAX_SESSIONS; i++) {
+        ids[i] = effectd_registry_add(registry, session);
+        assert(ids[i] != 0);
+    }
+    assert(effectd_registry_add(registry, session) == 0);
+    
+    for (uint32_t i = 0; i < EFFECTD_REGISTRY_MAX_SESSIONS; i++) {
+        assert(effectd_registry_remove(registry, ids[i]) == session);
+    }
+    assert(effectd_registry_get_count(registry) == 0);
+    
+    effectd_registry_destroy(registry);
+    free(session);
+    
+    printf("✓ test_registry_full passed\n");
+}
+
+typedef struct {
+    EffectdRegistry* registry;
+    _Atomic uint32_t* id;
+    atomic_bool* running;
+    uint64_t hits;
+} ReaderArgs;
+
+static void* reader_thread(void* arg) {
+    ReaderArgs* args = (ReaderArgs*)arg;
+    while (atomic_load(args->running)) {
+        uint32_t id = atomic_load(args->id);
+        EffectSession* session = effectd_registry_acquire(args->registry, id);
+        if (session) {
+            // A pinned session is never the one being torn down
+            assert(session->sessionId == id);
+            assert(session->state == SESSION_STATE_OPENED);
+            effectd_registry_release(args->registry, id);
+            args->hits++;
+        }
+    }
+    return NULL;
+}
+
+void test_registry_concurrent_remove() {
+    printf("Running test_registry_concurrent_remove...\n");
+    
+    EffectdRegistry* registry = effectd_registry_create();
+    _Atomic uint32_t id = 0;
+    atomic_bool running = true;
+    pthread_t readers[NUM_READERS];
+    ReaderArgs args[NUM_READERS];
+    
+    for (int i = 0; i < NUM_READERS; i++) {
+        args[i].registry = registry;
+        args[i].id = &id;
+        args[i].running = &running;
+        args[i].hits = 0;
+        pthread_create(&readers[i], NULL, reader_thread, &args[i]);
+    }
+    
+    // Readers race with removal; a session is only torn down once unpinned
+    for (int round = 0; round < 2000; round++) {
+        EffectSession* session = new_session();
+        session->state = SESSION_STATE_OPENED;
+        atomic_store(&id, effectd_registry_add(registry, session));
+        
+        EffectSession* removed = effectd_registry_remove(registry, atomic_load(&id));
+        assert(removed == session);
+        removed->state = SESSION_STATE_ERROR;
+        free(removed);
+    }
+    
+    atomic_store(&running, false);
+    for (int i = 0; i < NUM_READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    
+    effectd_registry_destroy(registry);
+    
+    printf("✓ test_registry_concurrent_remove passed\n");
+}
+
+int main() {
+    printf("Starting session registry tests...\n\n");
+    
+    test_registry_lookup();
+    test_registry_stale_id();
+    test_registry_full();
+    test_registry_concurrent_remove();
+    
+    printf("\n✓ All tests passed!\n");
+    return 0;
+}
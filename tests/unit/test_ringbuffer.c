@@ -138,6 +138,169 @@ void test_ringbuffer_reset() {
     printf("✓ test_ringbuffer_reset passed\n");
 }
 
+void test_ringbuffer_shared_attach() {
+    printf("Running test_ringbuffer_shared_attach...\n");
+    
+    // Two views onto one region stand in for the HAL and effectd mappings
+    static _Alignas(EFFECT_CACHE_LINE_SIZE) uint8_t region[4096];
+    effect_ringbuffer_t producer;
+    effect_ringbuffer_t consumer;
+    
+    size_t regionSize = effect_ringbuffer_shared_size(1024);
+    assert(regionSize <= sizeof(region));
+    assert(effect_ringbuffer_create_shared(&producer, region, 1024, 0) == 0);
+    assert(effect_ringbuffer_attach(&consumer, region, regionSize) == 0);
+    assert(consumer.capacity == 1024);
+    
+    uint8_t data[300];
+    for (int i = 0; i < 300; i++) {
+        data[i] = (uint8_t)(i * 3);
+    }
+    
+    assert(effect_ringbuffer_write(&producer, data, 300) == 300);
+    assert(effect_ringbuffer_get_read_available(&consumer) == 300);
+    
+    uint8_t read_data[300];
+    assert(effect_ringbuffer_read(&consumer, read_data, 300) == 300);
+    assert(memcmp(data, read_data, 300) == 0);
+    assert(effect_ringbuffer_get_write_available(&producer) == 1024);
+    
+    // The view keeps the geometry it checked, whatever the peer writes later
+    ((effect_ringbuffer_header_t*)region)->capacity = 1u << 20;
+    ((effect_ringbuffer_header_t*)region)->quantum = 7;
+    assert(consumer.capacity == 1024 && consumer.mask == 1023 && consumer.quantum == 0);
+    assert(effect_ringbuffer_attach(&consumer, region, regionSize) < 0);
+    assert(effect_ringbuffer_create_shared(&producer, region, 1024, 0) == 0);
+    
+    // Region too small for the advertised capacity
+    assert(effect_ringbuffer_attach(&consumer, region, regionSize - 64) < 0);
+    
+    // Misaligned region
+    assert(effect_ringbuffer_create_shared(&producer, region + 8, 1024, 0) < 0);
+    
+    // Corrupted header
+    ((effect_ringbuffer_header_t*)region)->magic = 0;
+    assert(effect_ringbuffer_attach(&consumer, region, regionSize) < 0);
+    
+    printf("✓ test_ringbuffer_shared_attach passed\n");
+}
+
+void test_ringbuffer_zero_copy() {
+    printf("Running test_ringbuffer_zero_copy...\n");
+    
+    uint8_t buffer[256];
+    effect_ringbuffer_t rb;
+    effect_ringbuffer_region_t region;
+    
+    effect_ringbuffer_init(&rb, buffer, 256);
+    
+    // Move the indices so the next reservation wraps
+    uint8_t temp[200];
+    memset(temp, 0, sizeof(temp));
+    effect_ringbuffer_write(&rb, temp, 200);
+    effect_ringbuffer_read(&rb, temp, 200);
+    
+    // Reserve 100 bytes: 56 at the tail, 44 at the head
+    assert(effect_ringbuffer_acquire_write(&rb, 100, &region) == 100);
+    assert(region.first == buffer + 200 && region.firstSize == 56);
+    assert(region.second == buffer && region.secondSize == 44);
+    for (uint32_t i = 0; i < region.firstSize; i++) region.first[i] = (uint8_t)i;
+    for (uint32_t i = 0; i < region.secondSize; i++) region.second[i] = (uint8_t)(56 + i);
+    
+    // Nothing is visible before the commit
+    assert(effect_ringbuffer_get_read_available(&rb) == 0);
+    effect_ringbuffer_commit_write(&rb, 100);
+    assert(effect_ringbuffer_get_read_available(&rb) == 100);
+    
+    // Read back in place
+    assert(effect_ringbuffer_acquire_read(&rb, 128, &region) == 100);
+    assert(region.firstSize == 56 && region.secondSize == 44);
+    for (uint32_t i = 0; i < region.firstSize; i++) assert(region.first[i] == (uint8_t)i);
+    for (uint32_t i = 0; i < region.secondSize; i++) assert(region.second[i] == (uint8_t)(56 + i));
+    
+    // Space is only returned on release
+    assert(effect_ringbuffer_get_write_available(&rb) == 156);
+    effect_ringbuffer_release_read(&rb, 100);
+    assert(effect_ringbuffer_get_write_available(&rb) == 256);
+    
+    printf("✓ test_ringbuffer_zero_copy passed\n");
+}
+
+void test_ringbuffer_quantum() {
+    printf("Running test_ringbuffer_quantum...\n");
+    
+    uint8_t buffer[256];
+    effect_ringbuffer_t rb;
+    
+    // Non-power-of-two capacities and oversized periods are rejected
+    assert(effect_ringbuffer_init_quantum(&rb, buffer, 240, 48) < 0);
+    assert(effect_ringbuffer_init_quantum(&rb, buffer, 256, 512) < 0);
+    
+    // 48-byte periods: five fit, leaving 16 bytes of slack
+    assert(effect_ringbuffer_init_quantum(&rb, buffer, 256, 48) == 0);
+    assert(effect_ringbuffer_get_write_periods(&rb) == 5);
+    
+    uint8_t data[96];
+    for (int i = 0; i < 96; i++) {
+        data[i] = (uint8_t)i;
+    }
+    
+    // Partial periods never enter the ring
+    assert(effect_ringbuffer_write(&rb, data, 50) == 0);
+    assert(effect_ringbuffer_get_read_available(&rb) == 0);
+    
+    for (int i = 0; i < 5; i++) {
+        assert(effect_ringbuffer_write(&rb, data, 48) == 48);
+    }
+    assert(effect_ringbuffer_get_read_periods(&rb) == 5);
+    
+    // All-or-nothing when the ring cannot take the whole request
+    assert(effect_ringbuffer_write(&rb, data, 48) == 0);
+    
+    uint8_t read_data[96];
+    assert(effect_ringbuffer_read(&rb, read_data, 96) == 96);
+    assert(memcmp(read_data, data, 48) == 0);
+    assert(effect_ringbuffer_get_read_periods(&rb) == 3);
+    
+    // This write wraps around the end of the buffer
+    assert(effect_ringbuffer_write(&rb, data, 96) == 96);
+    assert(effect_ringbuffer_read(&rb, read_data, 48 * 6) == 0);  // Only five queued
+    assert(effect_ringbuffer_read(&rb, read_data, 96) == 96);
+    assert(effect_ringbuffer_read(&rb, read_data, 48) == 48);
+    assert(effect_ringbuffer_read(&rb, read_data, 96) == 96);
+    assert(memcmp(read_data, data, 96) == 0);
+    assert(effect_ringbuffer_get_read_periods(&rb) == 0);
+    
+    printf("✓ test_ringbuffer_quantum passed\n");
+}
+
+void test_ringbuffer_positions() {
+    printf("Running test_ringbuffer_positions...\n");
+    
+    uint8_t buffer[256];
+    effect_ringbuffer_t rb;
+    assert(effect_ringbuffer_init_quantum(&rb, buffer, 256, 64) == 0);
+    
+    uint8_t data[64];
+    memset(data, 0x5a, sizeof(data));
+    
+    // Positions count every byte ever moved and keep growing across wraps
+    for (int i = 0; i < 10; i++) {
+        assert(effect_ringbuffer_get_write_position(&rb) == (uint64_t)i * 64);
+        assert(effect_ringbuffer_write(&rb, data, 64) == 64);
+        assert(effect_ringbuffer_get_read_position(&rb) == (uint64_t)i * 64);
+        assert(effect_ringbuffer_read(&rb, data, 64) == 64);
+    }
+    assert(effect_ringbuffer_get_write_position(&rb) == 640);
+    assert(effect_ringbuffer_get_read_position(&rb) == 640);
+    
+    // Reset starts over
+    effect_ringbuffer_reset(&rb);
+    assert(effect_ringbuffer_get_write_position(&rb) == 0);
+    
+    printf("✓ test_ringbuffer_positions passed\n");
+}
+
 int main() {
     printf("Starting ring buffer tests...\n\n");
     
@@ -146,6 +309,10 @@ int main() {
     test_ringbuffer_full();
     test_ringbuffer_empty();
     test_ringbuffer_reset();
+    test_ringbuffer_shared_attach();
+    test_ringbuffer_zero_copy();
+    test_ringbuffer_quantum();
+    test_ringbuffer_positions();
     
     printf("\n✓ All tests passed!\n");
     return 0;
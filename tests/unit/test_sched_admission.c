@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "effectd_sched.h"
+
+#define TYPE_KARAOKE 0
+#define TYPE_NOISE_REDUCTION 1
+
+static void set_budget(uint32_t type, uint32_t budgetUs, bool downgrade) {
+    EffectdSchedPolicy policy;
+    memset(&policy, 0, sizeof(policy));
+    policy.schedClass = EFFECTD_SCHED_FIFO;
+    policy.priority = EFFECTD_SCHED_DEFAULT_PRIORITY;
+    policy.budgetUs = budgetUs;
+    policy.downgrade = downgrade;
+    assert(effectd_sched_set_policy(type, &policy) == 0);
+}
+
+void test_admission_undeclared() {
+    printf("Running test_admission_undeclared...\n");
+    
+    effectd_sched_set_capacity(100);
+    set_budget(TYPE_KARAOKE, 0, false);
+    
+    // Nothing declared: always admitted, nothing reserved
+    EffectdSchedGrant grants[8];
+    for (int i = 0; i < 8; i++) {
+        assert(effectd_sched_admit(TYPE_KARAOKE, 48000, 480, &grants[i]) == 0);
+        assert(grants[i].admitted);
+        assert(grants[i].periodUs == 10000);
+    }
+    assert(effectd_sched_get_reserved_ppm() == 0);
+    
+    for (int i = 0; i < 8; i++) {
+        effectd_sched_release(&grants[i]);
+    }
+    
+    printf("✓ test_admission_undeclared passed\n");
+}
+
+void test_admission_reject() {
+    printf("Running test_admission_reject...\n");
+    
+    // 3 ms per 10 ms period is 30% of a CPU; three fit in 100%, a fourth does not
+    effectd_sched_set_capacity(100);
+    set_budget(TYPE_NOISE_REDUCTION, 3000, false);
+    
+    EffectdSchedGrant grants[4];
+    for (int i = 0; i < 3; i++) {
+        assert(effectd_sched_admit(TYPE_NOISE_REDUCTION, 48000, 480, &grants[i]) == 0);
+        assert(grants[i].sharePpm == 300000);
+    }
+    assert(effectd_sched_get_reserved_ppm() == 900000);
+    assert(effectd_sched_admit(TYPE_NOISE_REDUCTION, 48000, 480, &grants[3]) < 0);
+    assert(!grants[3].admitted);
+    
+    // Closing one makes room again
+    effectd_sched_release(&grants[0]);
+    assert(effectd_sched_get_reserved_ppm() == 600000);
+    assert(effectd_sched_admit(TYPE_NOISE_REDUCTION, 48000, 480, &grants[0]) == 0);
+    
+    // A budget longer than the period never fits
+    assert(effectd_sched_admit(TYPE_NOISE_REDUCTION, 48000, 96, &grants[3]) < 0);
+    
+    for (int i = 0; i < 3; i++) {
+        effectd_sched_release(&grants[i]);
+    }
+    assert(effectd_sched_get_reserved_ppm() == 0);
+    
+    printf("✓ test_admission_reject passed\n");
+}
+
+void test_admission_downgrade() {
+    printf("Running test_admission_downgrade...\n");
+    
+    effectd_sched_set_capacity(50);
+    set_budget(TYPE_KARAOKE, 4000, true);
+    
+    EffectdSchedGrant first;
+    EffectdSchedGrant second;
+    assert(effectd_sched_admit(TYPE_KARAOKE, 48000, 480, &first) == 0);
+    assert(first.policy.schedClass == EFFECTD_SCHED_FIFO);
+    
+    // Over budget: admitted best effort, reserving nothing
+    assert(effectd_sched_admit(TYPE_KARAOKE, 48000, 480, &second) == 0);
+    assert(second.admitted);
+    assert(second.policy.schedClass == EFFECTD_SCHED_OTHER);
+    assert(second.sharePpm == 0);
+    assert(effectd_sched_get_reserved_ppm() == 400000);
+    
+    effectd_sched_release(&second);
+    effectd_sched_release(&first);
+    assert(effectd_sched_get_reserved_ppm() == 0);
+    
+    printf("✓ test_admission_downgrade passed\n");
+}
+
+void test_policy_validation() {
+    printf("Running test_policy_validation...\n");
+    
+    EffectdSchedPolicy policy;
+    memset(&policy, 0, sizeof(policy));
+    
+    policy.schedClass = EFFECTD_SCHED_FIFO;
+    policy.priority = 0;
+    assert(effectd_sched_set_policy(TYPE_KARAOKE, &policy) < 0);
+    
+    // SCHED_DEADLINE needs a runtime
+    policy.schedClass = EFFECTD_SCHED_DEADLINE;
+    policy.budgetUs = 0;
+    assert(effectd_sched_set_policy(TYPE_KARAOKE, &policy) < 0);
+    policy.budgetUs = 1000;
+    assert(effectd_sched_set_policy(TYPE_KARAOKE, &policy) == 0);
+    
+    assert(effectd_sched_set_policy(7, &policy) < 0);
+    
+    printf("✓ test_policy_validation passed\n");
+}
+
+void test_fits_shared() {
+    printf("Running test_fits_shared...\n");
+    
+    effectd_sched_set_capacity(50);
+    EffectdSchedGrant grant;
+    EffectdSchedGrant over;
+    
+    // The default policy, with or without a budget, runs on shared workers
+    set_budget(TYPE_KARAOKE, 0, false);
+    assert(effectd_sched_admit(TYPE_KARAOKE, 48000, 480, &grant) == 0);
+    assert(effectd_sched_fits_shared(&grant));
+    set_budget(TYPE_KARAOKE, 4000, true);
+    assert(effectd_sched_admit(TYPE_KARAOKE, 48000, 480, &grant) == 0);
+    assert(effectd_sched_fits_shared(&grant));
+    
+    // Downgraded: SCHED_OTHER, which the workers cannot give
+    assert(effectd_sched_admit(TYPE_KARAOKE, 48000, 480, &over) == 0);
+    assert(over.policy.schedClass == EFFECTD_SCHED_OTHER);
+    assert(!effectd_sched_fits_shared(&over));
+    effectd_sched_release(&over);
+    effectd_sched_release(&grant);
+    
+    // Another priority, CPU set or class
+    EffectdSchedPolicy policy;
+    memset(&policy, 0, sizeof(policy));
+    policy.schedClass = EFFECTD_SCHED_FIFO;
+    policy.priority = EFFECTD_SCHED_DEFAULT_PRIORITY + 5;
+    assert(effectd_sched_set_policy(TYPE_KARAOKE, &policy) == 0);
+    assert(effectd_sched_admit(TYPE_KARAOKE, 48000, 480, &grant) == 0);
+    assert(!effectd_sched_fits_shared(&grant));
+    
+    policy.priority = EFFECTD_SCHED_DEFAULT_PRIORITY;
+    policy.cpuMask = 0x2;
+    assert(effectd_sched_set_policy(TYPE_KARAOKE, &policy) == 0);
+    assert(effectd_sched_admit(TYPE_KARAOKE, 48000, 480, &grant) == 0);
+    assert(!effectd_sched_fits_shared(&grant));
+    
+    policy.cpuMask = 0;
+    policy.schedClass = EFFECTD_SCHED_DEADLINE;
+    policy.budgetUs = 1000;
+    assert(effectd_sched_set_policy(TYPE_KARAOKE, &policy) == 0);
+    assert(effectd_sched_admit(TYPE_KARAOKE, 48000, 480, &grant) == 0);
+    assert(!effectd_sched_fits_shared(&grant));
+    effectd_sched_release(&grant);
+    
+    set_budget(TYPE_KARAOKE, 0, false);
+    
+    printf("✓ test_fits_shared passed\n");
+}
+
+void test_admission_shared() {
+    printf("Running test_admission_shared...\n");
+    
+    effectd_sched_set_capacity(100);
+    set_budget(TYPE_NOISE_REDUCTION, 3000, false);
+    assert(effectd_sched_share_ledger() == 0);
+    
+    EffectdSchedGrant grants[2];
+    assert(effectd_sched_admit(TYPE_NOISE_REDUCTION, 48000, 480, &grants[0]) == 0);
+    
+    // A forked host admits against what effectd already holds, and dies
+    // without releasing
+    int ready[2];
+    assert(pipe(ready) == 0);
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        EffectdSchedGrant hostGrants[3];
+        int admitted = 0;
+        while (admitted < 3 &&
+               effectd_sched_admit(TYPE_NOISE_REDUCTION, 48000, 480, &hostGrants[admitted]) == 0) {
+            admitted++;
+        }
+        char c = (char)admitted;
+        _exit(write(ready[1], &c, 1) == 1 ? 0 : 1);
+    }
+    
+    char admitted = 0;
+    assert(read(ready[0], &admitted, 1) == 1);
+    int status = 0;
+    assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    close(ready[0]);
+    close(ready[1]);
+    assert(admitted == 2);
+    assert(effectd_sched_get_reserved_ppm() == 900000);
+    assert(effectd_sched_admit(TYPE_NOISE_REDUCTION, 48000, 480, &grants[1]) < 0);
+    
+    // Its shares come back once it is known dead
+    effectd_sched_forget(pid);
+    assert(effectd_sched_get_reserved_ppm() == 300000);
+    assert(effectd_sched_admit(TYPE_NOISE_REDUCTION, 48000, 480, &grants[1]) == 0);
+    
+    effectd_sched_release(&grants[0]);
+    effectd_sched_release(&grants[1]);
+    assert(effectd_sched_get_reserved_ppm() == 0);
+    
+    printf("✓ test_admission_shared passed\n");
+}
+
+int main() {
+    printf("Starting admission control tests...\n\n");
+    
+    test_admission_undeclared();
+    test_admission_reject();
+    test_admission_downgrade();
+    test_policy_validation();
+    test_fits_shared();
+    test_admission_shared();
+    
+    printf("\n✓ All tests passed!\n");
+    return 0;
+}
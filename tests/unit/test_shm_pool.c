@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include "effect_shm_pool.h"
+#include "effect_shared_memory.h"
+
+#define GRANULE EFFECT_SHM_POOL_GRANULE
+
+void test_shm_pool_alloc_free() {
+    printf("Running test_shm_pool_alloc_free...\n");
+    
+    EffectShmPool* pool = effect_shm_pool_create("test_pool", 8 * GRANULE, 0);
+    assert(pool != NULL);
+    assert(effect_shm_pool_get_size(pool) == 8 * GRANULE);
+    
+    // Sizes round up to the granule, slabs are packed first fit
+    uint64_t a, b, c;
+    assert(effect_shm_pool_alloc(pool, 1, &a) != NULL);
+    assert(effect_shm_pool_alloc(pool, GRANULE + 1, &b) != NULL);
+    assert(effect_shm_pool_alloc(pool, 4 * GRANULE, &c) != NULL);
+    assert(a == 0);
+    assert(b == GRANULE);
+    assert(c == 3 * GRANULE);
+    
+    // Only one granule left
+    uint64_t d;
+    assert(effect_shm_pool_alloc(pool, 2 * GRANULE, &d) == NULL);
+    assert(effect_shm_pool_alloc(pool, GRANULE, &d) != NULL);
+    assert(d == 7 * GRANULE);
+    
+    // Freed slabs are reused and come back zeroed
+    uint8_t* slab = (uint8_t*)effect_shm_pool_get_base(pool) + b;
+    memset(slab, 0xAB, 2 * GRANULE);
+    effect_shm_pool_free(pool, b, GRANULE + 1);
+    uint64_t e;
+    assert(effect_shm_pool_alloc(pool, 2 * GRANULE, &e) == slab);
+    assert(e == b);
+    assert(slab[0] == 0 && slab[2 * GRANULE - 1] == 0);
+    
+    effect_shm_pool_release(pool);
+    
+    printf("✓ test_shm_pool_alloc_free passed\n");
+}
+
+void test_shm_pool_coalesce() {
+    printf("Running test_shm_pool_coalesce...\n");
+    
+    EffectShmPool* pool = effect_shm_pool_create("test_pool", 4 * GRANULE, 0);
+    assert(pool != NULL);
+    
+    uint64_t off[4];
+    for (int i = 0; i < 4; i++) {
+        assert(effect_shm_pool_alloc(pool, GRANULE, &off[i]) != NULL);
+    }
+    
+    // Free out of order; neighbours must merge back into one extent
+    effect_shm_pool_free(pool, off[0], GRANULE);
+    effect_shm_pool_free(pool, off[2], GRANULE);
+    effect_shm_pool_free(pool, off[3], GRANULE);
+    effect_shm_pool_free(pool, off[1], GRANULE);
+    
+    uint64_t all;
+    assert(effect_shm_pool_alloc(pool, 4 * GRANULE, &all) != NULL);
+    assert(all == 0);
+    
+    effect_shm_pool_release(pool);
+    
+    printf("✓ test_shm_pool_coalesce passed\n");
+}
+
+void test_shm_pool_import() {
+    printf("Running test_shm_pool_import...\n");
+    
+    EffectShmPool* pool = effect_shm_pool_create("test_pool", 2 * GRANULE, 0);
+    assert(pool != NULL);
+    
+    uint64_t off;
+    uint8_t* slab = (uint8_t*)effect_shm_pool_alloc(pool, GRANULE, &off);
+    assert(slab != NULL);
+    
+    // The peer maps the same memory once and finds slabs by offset
+    EffectShmPool* peer = effect_shm_pool_import(dup(effect_shm_pool_get_fd(pool)),
+                                                 (size_t)effect_shm_pool_get_size(pool));
+    assert(peer != NULL);
+    slab[10] = 42;
+    assert(((uint8_t*)effect_shm_pool_get_base(peer))[off + 10] == 42);
+    
+    // Imported pools cannot allocate
+    uint64_t other;
+    assert(effect_shm_pool_alloc(peer, GRANULE, &other) == NULL);
+    
+    // References keep the mapping alive
+    effect_shm_pool_acquire(peer);
+    effect_shm_pool_release(peer);
+    assert(((uint8_t*)effect_shm_pool_get_base(peer))[off + 10] == 42);
+    effect_shm_pool_release(peer);
+    
+    effect_shm_pool_release(pool);
+    
+    printf("✓ test_shm_pool_import passed\n");
+}
+
+void test_shm_pool_huge_pages() {
+    printf("Running test_shm_pool_huge_pages...\n");
+    
+    // Works whether or not the system has huge pages; size is rounded up
+    size_t hugePage = effect_shared_memory_huge_page_size();
+    EffectShmPool* pool = effect_shm_pool_create("test_pool", GRANULE, EFFECT_SHM_FLAG_HUGE_PAGES);
+    assert(pool != NULL);
+    assert(effect_shm_pool_get_size(pool) == hugePage);
+    
+    uint64_t off;
+    uint8_t* slab = (uint8_t*)effect_shm_pool_alloc(pool, hugePage, &off);
+    assert(slab != NULL);
+    assert(off == 0);
+    slab[hugePage - 1] = 1;
+    
+    effect_shm_pool_release(pool);
+    
+    printf("✓ test_shm_pool_huge_pages passed\n");
+}
+
+int main() {
+    printf("Starting shared memory pool tests...\n\n");
+    
+    test_shm_pool_alloc_free();
+    test_shm_pool_coalesce();
+    test_shm_pool_import();
+    test_shm_pool_huge_pages();
+    
+    printf("\n✓ All tests passed!\n");
+    return 0;
+}